@@ -14,6 +14,19 @@
 #define  ID_I_SPIKE_IN2_STATE 7
 #define  ID_I_CURR_MICROSS    8
 
+// Input sources (see InputScheduler.h)
+//
+#define  IN_VM_POT            0
+#define  IN_SYN1_POT          1
+#define  IN_SYN2_POT          2
+#define  IN_NOISE_POT         3
+#define  IN_ANALOG_IN         4
+#define  IN_PHOTODIODE        5
+#define  IN_BUTTON            6
+#define  N_INPUTS             7
+#define  IN_BIT(id)           (1 << (id))
+#define  IN_ALL               ((1 << N_INPUTS) -1)
+
 // Model output structure
 //
 typedef struct {
@@ -21,6 +34,11 @@ typedef struct {
   int Stim_State, SpikeIn1State, SpikeIn2State;
   unsigned long currentMicros;
   int NeuronBehaviour;
+  int TickMissed;  // 1 if model ticks were missed before this sample
+  int Spike;       // 1 if the model was reset (spiked) in this step
+  float SpikeFrac; // if Spike: time of the 30 mV crossing within the step (0..1)
+  unsigned long Seq; // record number, counts every model step from 0
+  unsigned long SpikeIn1Micros, SpikeIn2Micros; // time of the latest synapse input pulse (as currentMicros)
   } output_t;
 
 #endif
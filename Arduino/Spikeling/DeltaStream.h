@@ -0,0 +1,255 @@
+// -----------------------------------------------------------------------------
+// Compressed stream of the continuous model values (SerialMode = 3)
+//
+// The five currents/voltages are rounded to 1/DELTA_SCALE (0.01, the
+// resolution of the ASCII lines) and sent as differences to the previous
+// sample, each as a zigzag varint (1 byte for changes up to +-0.63, 2 bytes
+// up to +-81.91, ...). Several samples are collected into one delta frame
+// (FRAME_TYPE_DELTA); each sample in it is a record of:
+//
+//   header 1 byte    low 4 bits as sample_t.flags (FLAG_xxx), plus
+//                    DELTA_HDR_MODE: a byte with NeuronBehaviour follows
+//                    DELTA_HDR_DT:   a zigzag varint with the change of the
+//                                    time step (in us) follows, otherwise the
+//                                    time step is the same as before
+//                    DELTA_HDR_ZERO: the values did not change (no varints)
+//   [mode]  1 byte
+//   [dt]    varint
+//   values  5 zigzag varints: v, I_total, I_PD, I_AnalogIn, I_Synapse
+//
+// Every `keyEvery` samples, a key frame (FRAME_TYPE_KEY, keysample_t) with the
+// absolute values is sent instead, from which a receiver that lost a frame
+// (see the frame counter) can start over. The time step counts as 0 after a
+// key frame.
+//
+// This header is shared with the host-side decoder ("Host tools" folder) and
+// therefore must not depend on the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  DeltaStream_h
+#define  DeltaStream_h
+
+#include <stdint.h>
+#include <string.h>
+#include "Definitions.h"
+#include "SerialFrame.h"
+
+#define  DELTA_SCALE        100   // values in units of 1/DELTA_SCALE
+#define  DELTA_N_VALUES     5
+#define  DELTA_BLOCK_BYTES  96    // max. payload of a delta frame
+#define  DELTA_RECORD_MAX   (1 +1 +5 +DELTA_N_VALUES*5)
+
+#define  DELTA_FLAGS        0x0F  // FLAG_xxx bits of sample_t.flags
+#define  DELTA_HDR_MODE     0x10
+#define  DELTA_HDR_DT       0x20
+#define  DELTA_HDR_ZERO     0x40
+
+// Key frame payload
+//
+typedef struct __attribute__((packed)) {
+  int32_t  value[DELTA_N_VALUES];  // in units of 1/DELTA_SCALE
+  uint32_t currentMicros;
+  uint8_t  flags;
+  uint8_t  NeuronBehaviour;
+  } keysample_t;
+
+// State of the encoder and the decoder (the previous sample)
+//
+typedef struct {
+  int32_t  value[DELTA_N_VALUES];
+  uint32_t micros, dt;
+  uint8_t  mode;
+  bool     valid;                  // decoder: has seen a key frame
+  uint16_t sinceKey;               // encoder: samples since the last key frame
+  uint8_t  n, len;                 // encoder: samples and bytes in `block`
+  uint8_t  block[DELTA_BLOCK_BYTES];
+  } deltastate_t;
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+static inline int32_t deltaQuantize(float x)
+{
+  return (int32_t)(x *DELTA_SCALE +((x < 0) ? -0.5f : 0.5f));
+}
+
+static inline void deltaValues(int32_t* q, const output_t* o)
+{
+  q[0] = deltaQuantize(o->v);
+  q[1] = deltaQuantize(o->I_total);
+  q[2] = deltaQuantize(o->I_PD);
+  q[3] = deltaQuantize(o->I_AnalogIn);
+  q[4] = deltaQuantize(o->I_Synapse);
+}
+
+static inline uint8_t deltaFlags(const output_t* o)
+{
+  return (o->Stim_State    ? FLAG_STIM_STATE : 0)
+       | (o->SpikeIn1State ? FLAG_SPIKE_IN1  : 0)
+       | (o->SpikeIn2State ? FLAG_SPIKE_IN2  : 0)
+       | (o->TickMissed    ? FLAG_TICK_MISSED : 0);
+}
+
+static inline uint8_t* deltaPutVarint(uint8_t* p, int32_t x)
+{
+  uint32_t z = ((uint32_t)x << 1) ^ (uint32_t)(x >> 31);
+
+  while(z >= 0x80) {
+    *p++ = (uint8_t)(z | 0x80);
+    z >>= 7;
+  }
+  *p++ = (uint8_t)z;
+  return p;
+}
+
+// Returns NULL if the varint does not end before `end`
+//
+static inline const uint8_t* deltaGetVarint(const uint8_t* p, const uint8_t* end, int32_t* x)
+{
+  uint32_t z = 0;
+  uint8_t  shift = 0;
+
+  while(p < end) {
+    uint8_t b = *p++;
+    z |= (uint32_t)(b & 0x7F) << shift;
+    if(!(b & 0x80)) {
+      *x = (int32_t)(z >> 1) ^ -(int32_t)(z & 1);
+      return p;
+    }
+    if((shift += 7) > 28) break;
+  }
+  return NULL;
+}
+
+// -----------------------------------------------------------------------------
+// Encoder
+// -----------------------------------------------------------------------------
+static inline void deltaInit(deltastate_t* s)
+{
+  memset(s, 0, sizeof(*s));
+}
+
+// True if the next sample must be sent as key frame (the pending delta
+// frame has to be sent first)
+//
+static inline bool deltaKeyDue(const deltastate_t* s, uint16_t keyEvery)
+{
+  return (s->sinceKey == 0) || (s->sinceKey >= keyEvery);
+}
+
+static inline void deltaKey(deltastate_t* s, const output_t* o, keysample_t* k)
+{
+  deltaValues(s->value, o);
+  memcpy(k->value, s->value, sizeof(k->value));
+  k->currentMicros   = s->micros = (uint32_t)o->currentMicros;
+  k->flags           = deltaFlags(o);
+  k->NeuronBehaviour = s->mode = (uint8_t)o->NeuronBehaviour;
+  s->dt       = 0;
+  s->sinceKey = 1;
+}
+
+// Add a sample to the pending delta frame; send the frame (s->block, s->len
+// bytes) when s->len > DELTA_BLOCK_BYTES -DELTA_RECORD_MAX, or earlier
+//
+static inline void deltaAppend(deltastate_t* s, const output_t* o)
+{
+  int32_t  q[DELTA_N_VALUES];
+  uint32_t dt  = (uint32_t)o->currentMicros -s->micros;
+  uint8_t* hdr = s->block +s->len;
+  uint8_t* p   = hdr +1;
+  bool     zero = true;
+
+  deltaValues(q, o);
+  *hdr = deltaFlags(o);
+  if((uint8_t)o->NeuronBehaviour != s->mode) {
+    *hdr |= DELTA_HDR_MODE;
+    *p++ = s->mode = (uint8_t)o->NeuronBehaviour;
+  }
+  if(dt != s->dt) {
+    *hdr |= DELTA_HDR_DT;
+    p = deltaPutVarint(p, (int32_t)(dt -s->dt));
+  }
+  for(uint8_t i=0; i<DELTA_N_VALUES; i++) {
+    if(q[i] != s->value[i]) zero = false;
+  }
+  if(zero) {
+    *hdr |= DELTA_HDR_ZERO;
+  }
+  else {
+    for(uint8_t i=0; i<DELTA_N_VALUES; i++) {
+      p = deltaPutVarint(p, q[i] -s->value[i]);
+      s->value[i] = q[i];
+    }
+  }
+  s->micros = (uint32_t)o->currentMicros;
+  s->dt     = dt;
+  s->len    = (uint8_t)(p -s->block);
+  s->n++;
+  s->sinceKey++;
+}
+
+static inline void deltaBlockSent(deltastate_t* s)
+{
+  s->n   = 0;
+  s->len = 0;
+}
+
+// -----------------------------------------------------------------------------
+// Decoder
+// -----------------------------------------------------------------------------
+static inline void deltaOutput(const deltastate_t* s, uint8_t flags, output_t* o)
+{
+  o->v               = (float)s->value[0] /DELTA_SCALE;
+  o->I_total         = (float)s->value[1] /DELTA_SCALE;
+  o->I_PD            = (float)s->value[2] /DELTA_SCALE;
+  o->I_AnalogIn      = (float)s->value[3] /DELTA_SCALE;
+  o->I_Synapse       = (float)s->value[4] /DELTA_SCALE;
+  o->Stim_State      = (flags & FLAG_STIM_STATE) ? 1 : 0;
+  o->SpikeIn1State   = (flags & FLAG_SPIKE_IN1)  ? 1 : 0;
+  o->SpikeIn2State   = (flags & FLAG_SPIKE_IN2)  ? 1 : 0;
+  o->TickMissed      = (flags & FLAG_TICK_MISSED) ? 1 : 0;
+  o->currentMicros   = s->micros;
+  o->NeuronBehaviour = s->mode;
+}
+
+static inline void deltaDecodeKey(deltastate_t* s, const keysample_t* k, output_t* o)
+{
+  memcpy(s->value, k->value, sizeof(s->value));
+  s->micros = k->currentMicros;
+  s->mode   = k->NeuronBehaviour;
+  s->dt     = 0;
+  s->valid  = true;
+  deltaOutput(s, k->flags, o);
+}
+
+// Decode the record at `p`; returns a pointer behind it, or NULL if the
+// record is incomplete
+//
+static inline const uint8_t* deltaDecodeRecord(deltastate_t* s, const uint8_t* p,
+                                               const uint8_t* end, output_t* o)
+{
+  uint8_t hdr;
+  int32_t d;
+
+  if(p >= end) return NULL;
+  hdr = *p++;
+  if(hdr & DELTA_HDR_MODE) {
+    if(p >= end) return NULL;
+    s->mode = *p++;
+  }
+  if(hdr & DELTA_HDR_DT) {
+    if((p = deltaGetVarint(p, end, &d)) == NULL) return NULL;
+    s->dt += (uint32_t)d;
+  }
+  if(!(hdr & DELTA_HDR_ZERO)) {
+    for(uint8_t i=0; i<DELTA_N_VALUES; i++) {
+      if((p = deltaGetVarint(p, end, &d)) == NULL) return NULL;
+      s->value[i] += d;
+    }
+  }
+  s->micros += s->dt;
+  deltaOutput(s, hdr & DELTA_FLAGS, o);
+  return p;
+}
+
+#endif
+// -----------------------------------------------------------------------------
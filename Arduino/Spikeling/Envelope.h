@@ -0,0 +1,60 @@
+// -----------------------------------------------------------------------------
+// Min/max envelope decimation for the on-screen traces
+//
+// Reduces every `factor` samples of a trace to one plot column, given by the
+// smallest and largest value among them. Drawn as a vertical span, the column
+// shows every excursion of the trace, so that spikes are not lost when the
+// screen covers many samples per column. Each column also includes the last
+// sample of the previous column, so that the trace stays connected, like
+// lines drawn from sample to sample.
+//
+// This header is also compiled on the host and therefore must not depend on
+// the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  Envelope_h
+#define  Envelope_h
+
+#include <stdint.h>
+
+typedef struct {
+  uint16_t factor;                 // samples per column
+  uint16_t n;                      // samples in the current column
+  float    lo, hi;                 // range of the current column
+  float    last;                   // last sample
+  bool     started;
+  } envelope_t;
+
+// -----------------------------------------------------------------------------
+static inline void envInit(envelope_t* e, int factor)
+{
+  if(factor < 1) factor = 1;
+  if(factor > 65535) factor = 65535;
+  e->factor  = (uint16_t)factor;
+  e->n       = 0;
+  e->lo      = 0;
+  e->hi      = 0;
+  e->last    = 0;
+  e->started = false;
+}
+
+// Add one sample; returns true when a column is complete, its range is then
+// in e->lo and e->hi
+//
+static inline bool envAdd(envelope_t* e, float x)
+{
+  if(e->n == 0) {
+    e->lo = e->hi = e->started ? e->last : x;
+    e->started = true;
+  }
+  if(x < e->lo) e->lo = x;
+  if(x > e->hi) e->hi = x;
+  e->last = x;
+  if(++e->n < e->factor) {
+    return false;
+  }
+  e->n = 0;
+  return true;
+}
+
+#endif
+// -----------------------------------------------------------------------------
@@ -0,0 +1,245 @@
+// -----------------------------------------------------------------------------
+// Fixed-point (Q-format) version of the model update
+//
+// Used instead of the float model (Model.h) if USES_FIXED_POINT is defined
+// (see SettingsArduino.h). The ATmega328 has no FPU, so every float operation
+// is emulated in software; the integer version only needs the hardware
+// multiplier. The following formats are used:
+//
+//   q16_t  Q15.16  v, u and all currents (range +/-32768, resolution 1.5E-5)
+//   q24_t  Q7.24   small coefficients and PD_gain (range +/-128, res. 6E-8)
+//   Q1.30          a*dt and PD_decay (stored in a q24_t); these are so small
+//                  that Q7.24 would shift the spike times of the slow modes
+//
+// All conversions from the float user parameters happen once in the fxInit*()
+// functions.
+// This header is also compiled on the host (see "Host tools/fixedpoint_check")
+// and therefore must not depend on the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  FixedPoint_h
+#define  FixedPoint_h
+
+#include <stdint.h>
+#include <string.h>
+#include "Model.h"
+
+typedef int32_t q16_t;
+typedef int32_t q24_t;
+
+#define  Q16(x)  ((q16_t)((x) *65536.0    +(((x) >= 0) ? 0.5 : -0.5)))
+#define  Q24(x)  ((q24_t)((x) *16777216.0 +(((x) >= 0) ? 0.5 : -0.5)))
+
+// -----------------------------------------------------------------------------
+// Arithmetic
+// -----------------------------------------------------------------------------
+static inline q16_t q16FromInt(long i)
+{
+  return (q16_t)(i *65536L);
+}
+
+static inline q16_t q16FromFloat(float f)
+{
+  return (q16_t)(f *65536.0f +((f >= 0) ? 0.5f : -0.5f));
+}
+
+static inline q24_t q24FromFloat(float f)
+{
+  return (q24_t)(f *16777216.0f +((f >= 0) ? 0.5f : -0.5f));
+}
+
+static inline float q16ToFloat(q16_t x)
+{
+  return x *(1.0f /65536.0f);
+}
+
+static inline int32_t fxShift16(int64_t p)
+{
+  #if defined(__AVR__)
+    // avr-gcc calls a bit-wise loop for 64-bit shifts; on the little-endian
+    // AVR, bits 16..47 are simply bytes 2..5
+    //
+    int32_t r;
+    memcpy(&r, (uint8_t*)&p +2, 4);
+    return r;
+  #else
+    return (int32_t)(p >> 16);
+  #endif
+}
+
+static inline int32_t fxShift24(int64_t p)
+{
+  #if defined(__AVR__)
+    int32_t r;
+    memcpy(&r, (uint8_t*)&p +3, 4);
+    return r;
+  #else
+    return (int32_t)(p >> 24);
+  #endif
+}
+
+// Rounded products; q16Mul() also yields a q24_t if one factor is a q24_t
+//
+static inline q16_t q16Mul(q16_t a, q16_t b)
+{
+  return fxShift16((int64_t)a *(int64_t)b +0x8000);
+}
+
+static inline q16_t q16MulQ24(q16_t a, q24_t c)
+{
+  return fxShift24((int64_t)a *(int64_t)c +0x800000);
+}
+
+// -----------------------------------------------------------------------------
+// Model
+// -----------------------------------------------------------------------------
+// Global settings (converted from the user parameters)
+//
+typedef struct {
+  q24_t  dt;               // timestep_ms
+  q24_t  Synapse_decay;
+  q24_t  PD_gain_min;
+  q16_t  PD_ScalingInv;    // 1/PD_Scaling
+  int    VmPotiScaling;
+  int    AnalogInScaling;
+  int    SynapseScaling;
+  int    AnalogInActive;
+  } fx_config_t;
+
+// Parameters of one neuron mode (converted from the Array_xxx user parameters)
+//
+typedef struct {
+  q24_t  a_dt;             // Array_a *timestep_ms, Q1.30
+  q24_t  b;
+  q16_t  c;
+  q16_t  d;
+  q24_t  PD_decay;         // Q1.30
+  q24_t  PD_recovery;
+  int8_t PD_polarity;
+  } fx_mode_t;
+
+// Model state
+//
+typedef struct {
+  q16_t  v, u;
+  q16_t  I_total, I_PD, I_Vm, I_AnalogIn, I_Synapse, I_Noise;
+  q24_t  PD_gain;
+  q16_t  v_pre;            // v of the last step before the reset check
+  } fx_state_t;
+
+// -----------------------------------------------------------------------------
+static inline void fxInitConfig(fx_config_t* cfg, float timestep_ms,
+                                float Synapse_decay, float PD_gain_min,
+                                float PD_Scaling, int VmPotiScaling,
+                                int AnalogInScaling, int SynapseScaling,
+                                int AnalogInActive)
+{
+  cfg->dt              = q24FromFloat(timestep_ms);
+  cfg->Synapse_decay   = q24FromFloat(Synapse_decay);
+  cfg->PD_gain_min     = q24FromFloat(PD_gain_min);
+  cfg->PD_ScalingInv   = q16FromFloat(1.0f /PD_Scaling);
+  cfg->VmPotiScaling   = VmPotiScaling;
+  cfg->AnalogInScaling = AnalogInScaling;
+  cfg->SynapseScaling  = SynapseScaling;
+  cfg->AnalogInActive  = AnalogInActive;
+}
+
+static inline void fxInitMode(fx_mode_t* m, float a, float b, int c, float d,
+                              float PD_decay, float PD_recovery,
+                              int PD_polarity, float timestep_ms)
+{
+  m->a_dt        = (q24_t)(a *timestep_ms *1073741824.0f +0.5f);
+  m->b           = q24FromFloat(b);
+  m->c           = q16FromInt(c);
+  m->d           = q16FromFloat(d);
+  m->PD_decay    = (q24_t)(PD_decay *1073741824.0f +0.5f);
+  m->PD_recovery = q24FromFloat(PD_recovery);
+  m->PD_polarity = (int8_t)PD_polarity;
+}
+
+static inline void fxInitState(fx_state_t* s)
+{
+  memset(s, 0, sizeof(fx_state_t));
+  s->PD_gain = Q24(1.0);
+}
+
+// -----------------------------------------------------------------------------
+// Stage 1: Sum up all input currents; mirrors modelCurrents() in Model.h,
+// including its integer divisions
+// -----------------------------------------------------------------------------
+static inline void fxCurrents(fx_state_t* s, const model_input_t* in,
+                              const fx_mode_t* m, const fx_config_t* cfg)
+{
+  q16_t AnalogInAmpl;
+
+  // Vm potentiometer, analog in and noise
+  //
+  s->I_Vm       = q16FromInt(-1 *(in->VmPotVal -512) /cfg->VmPotiScaling);
+  AnalogInAmpl  = (q16_t)((in->AnalogInPotVal -512) *65536L /cfg->AnalogInScaling);
+  s->I_AnalogIn = (cfg->AnalogInActive == 0) ? 0 : -AnalogInAmpl *in->AnalogInVal;
+  s->I_Noise   += (q16_t)(in->Noise *(65536L /NOISE_SCALE));
+  s->I_Noise    = q16MulQ24(s->I_Noise, Q24(0.9));
+
+  // Photodiode current with gain adaptation (PD_gain is a q24_t)
+  //
+  s->I_PD = q16MulQ24(in->PDVal_smoothed *cfg->PD_ScalingInv, s->PD_gain);
+  if (s->PD_gain > cfg->PD_gain_min) {
+    s->PD_gain -= (q16Mul(s->I_PD, m->PD_decay) +32) >> 6;
+    if (s->PD_gain < cfg->PD_gain_min) {
+      s->PD_gain = cfg->PD_gain_min;
+    }
+  }
+  if (s->PD_gain < Q24(1.0)) {
+    s->PD_gain += m->PD_recovery;
+  }
+
+  // Synapses (one increment per input pulse), decaying towards zero
+  //
+  if (in->SpikeIn1State) {
+    s->I_Synapse += (q16_t)(-1L *(in->Syn1PotVal -512) *65536L /cfg->SynapseScaling)
+                   *in->SpikeIn1State;
+  }
+  if (in->SpikeIn2State) {
+    s->I_Synapse += (q16_t)(-1L *(in->Syn2PotVal -512) *65536L /cfg->SynapseScaling)
+                   *in->SpikeIn2State;
+  }
+  s->I_Synapse = q16MulQ24(s->I_Synapse, cfg->Synapse_decay);
+
+  s->I_total = s->I_PD *m->PD_polarity +s->I_Vm +s->I_Synapse +s->I_AnalogIn
+              +s->I_Noise;
+}
+
+// -----------------------------------------------------------------------------
+// Stage 2: Advance the Izhikevich model; returns true if the neuron was reset
+// (v >= 30 mV)
+// -----------------------------------------------------------------------------
+static inline bool fxIntegrate(fx_state_t* s, const fx_mode_t* m,
+                               const fx_config_t* cfg)
+{
+  q16_t dv;
+  bool  reset = false;
+
+  dv    = q16MulQ24(q16Mul(s->v, s->v), Q24(0.04)) +5*s->v +Q16(140) -s->u
+         +s->I_total;
+  s->v += q16MulQ24(dv, cfg->dt);
+  s->u += fxShift16((int64_t)(q16MulQ24(s->v, m->b) -s->u) *m->a_dt +(1L << 29)) >> 14;
+  s->v_pre = s->v;
+  if (s->v >= Q16(30)) {
+    s->v  = m->c;
+    s->u += m->d;
+    reset = true;
+  }
+  if (s->v <= Q16(-90)) {
+    s->v  = Q16(-90);
+  }
+  return reset;
+}
+
+static inline bool fxModelStep(fx_state_t* s, const model_input_t* in,
+                               const fx_mode_t* m, const fx_config_t* cfg)
+{
+  fxCurrents(s, in, m, cfg);
+  return fxIntegrate(s, m, cfg);
+}
+
+#endif
+// -----------------------------------------------------------------------------
@@ -0,0 +1,76 @@
+// -----------------------------------------------------------------------------
+// Per-input update rates
+//
+// Every input source (IN_xxx, see Definitions.h) is only read every n-th
+// model step, with n set by its divisor. schedNext() is called once per step
+// and returns a bit mask (IN_BIT(id)) of the inputs that are due; inputs that
+// are not due keep their last value. Divisors of 1 read every input in every
+// step, as before.
+//
+// The scheduler also counts the model steps to measure the achieved model
+// rate.
+//
+// This header is also compiled on the host and therefore must not depend on
+// the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  InputScheduler_h
+#define  InputScheduler_h
+
+#include <stdint.h>
+#include "Definitions.h"
+
+typedef struct {
+  uint8_t  divisor[N_INPUTS];
+  uint8_t  count[N_INPUTS];
+  uint32_t nSteps;          // steps since start of rate measurement
+  uint32_t startMillis;
+  float    rateHz;          // last measured model rate
+  } inputsched_t;
+
+// -----------------------------------------------------------------------------
+static inline void schedInit(inputsched_t* sc, const int* divisors, uint32_t now_ms)
+{
+  for(uint8_t i=0; i<N_INPUTS; i++) {
+    sc->divisor[i] = (divisors[i] < 1) ? 1 : ((divisors[i] > 255) ? 255 : divisors[i]);
+    sc->count[i]   = 0;
+  }
+  sc->nSteps      = 0;
+  sc->startMillis = now_ms;
+  sc->rateHz      = 0;
+}
+
+// Returns the inputs due in this step
+//
+static inline uint16_t schedNext(inputsched_t* sc)
+{
+  uint16_t due = 0;
+
+  for(uint8_t i=0; i<N_INPUTS; i++) {
+    if(sc->count[i] == 0) {
+      due |= IN_BIT(i);
+      sc->count[i] = sc->divisor[i];
+    }
+    sc->count[i]--;
+  }
+  sc->nSteps++;
+  return due;
+}
+
+// Update the rate measurement; returns true every `interval_ms` with the
+// achieved model rate in sc->rateHz
+//
+static inline bool schedRate(inputsched_t* sc, uint32_t now_ms, uint32_t interval_ms)
+{
+  uint32_t dt = now_ms -sc->startMillis;
+
+  if(dt < interval_ms) {
+    return false;
+  }
+  sc->rateHz      = sc->nSteps *1000.0f /dt;
+  sc->nSteps      = 0;
+  sc->startMillis = now_ms;
+  return true;
+}
+
+#endif
+// -----------------------------------------------------------------------------
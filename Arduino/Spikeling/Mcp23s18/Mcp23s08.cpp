@@ -1,5 +1,6 @@
 // -----------------------------------------------------------------------------     
 #include <stdio.h>
+#include <string.h>
 #include <inttypes.h>
 #include <SPI.h>
 #include <Arduino.h>
@@ -8,6 +9,10 @@
 #else
   #include <avr/interrupt.h>
 #endif  
+#if defined(ESP32)
+  #include "soc/soc.h"
+  #include "soc/gpio_reg.h"
+#endif
 
 #include "Mcp23s08.h"
 
@@ -83,6 +88,7 @@ void MCP23S08::postSetup(const uint8_t csPin,const uint8_t haenAdrs,SPIClass *sp
 	#endif
 	mSpi = spi;
 	_cs = csPin;
+	_inExchange = false;
 	if (haenAdrs >= 0x20 && haenAdrs <= 0x23){//HAEN works between 0x20...0x23
 		_adrs = haenAdrs;
 		_useHaen = 1;
@@ -125,7 +131,10 @@ void MCP23S08::begin(bool protocolInitOverride) {
 	digitalWrite(_cs, HIGH);
 	delay(100);
 	
-	_useHaen == 1 ? writeByte(IOCON,0b00101000) : writeByte(IOCON,0b00100000);
+	// ***TE*** SEQOP (bit 5) cleared, i.e. sequential addressing enabled for
+	// readRegisters() and writeRegisters(); single register accesses are not
+	// affected, because each frame sends its register address
+	_useHaen == 1 ? writeByte(IOCON,0b00001000) : writeByte(IOCON,0b00000000);
 	/*
     if (_useHaen){
 		writeByte(IOCON,0b00101000);//read datasheet for details!
@@ -135,6 +144,7 @@ void MCP23S08::begin(bool protocolInitOverride) {
 	*/
 	_gpioDirection = 0xFF;//all in
 	_gpioState = 0x00;//all low 
+	_olatState = 0x00;//as after reset
 }
 
 
@@ -178,6 +188,7 @@ void MCP23S08::gpioPort(uint8_t value){
 		_gpioState = value;
 	}
 	writeByte(GPIO,_gpioState);
+	_olatState = _gpioState;
 }
 
 
@@ -216,6 +227,7 @@ void MCP23S08::gpioDigitalWrite(uint8_t pin, bool value){
 	if (pin < 8){//0...7
 		value == HIGH ? _gpioState |= (1 << pin) : _gpioState &= ~(1 << pin);
 		writeByte(GPIO,_gpioState);
+		_olatState = _gpioState;
 	}
 }
 
@@ -227,6 +239,70 @@ void MCP23S08::gpioDigitalWriteFast(uint8_t pin, bool value){
 
 void MCP23S08::gpioPortUpdate(){
 	writeByte(GPIO,_gpioState);
+	_olatState = _gpioState;
+}
+
+// ***TE*** Read the pins and write the outputs set with gpioDigitalWriteFast()
+// in one go; the write frame is only sent if an output has changed, so a
+// cycle costs one or two CS frames of 3 bytes each (instead of always two,
+// with readGpioPort() and gpioPortUpdate()). If `intRegs` is given, INTF and
+// INTCAP are read in the same frame and stored there: reading GPIO clears
+// the interrupt, so the captured state would otherwise be lost
+uint8_t MCP23S08::gpioPortExchange(uint8_t *intRegs){
+	uint8_t data;
+	if (intRegs != NULL){
+		uint8_t reg[3];
+		readRegisters(INTF, reg, 3);//INTF, INTCAP, GPIO
+		intRegs[0] = reg[0];
+		intRegs[1] = reg[1];
+		data = reg[2];
+	} else {
+		data = readAddress(GPIO);
+	}
+	if (_gpioState != _olatState){
+		writeByte(OLAT,_gpioState);
+		_olatState = _gpioState;
+	}
+	return data;
+}
+
+// ***TE*** Read/write `count` consecutive registers starting at `reg` in one
+// CS frame (opcode, address, data...), using the chip's address pointer
+// increment (SEQOP = 0, see begin()); after OLAT (0x0A), it wraps to IODIR
+void MCP23S08::readRegisters(byte reg, uint8_t *data, uint8_t count){
+	memset(data, 0, count);
+	startSend(1);
+	mSpi->transfer(reg);
+	mSpi->transfer(data, count);
+	endSend();
+}
+
+void MCP23S08::writeRegisters(byte reg, const uint8_t *data, uint8_t count){
+	uint8_t buf[11];
+	if (count > sizeof(buf)) count = sizeof(buf);
+	memcpy(buf, data, count);
+	startSend(0);
+	mSpi->transfer(reg);
+	mSpi->transfer(buf, count);
+	endSend();
+}
+
+// ***TE*** Begin/end one SPI transaction for several operations; CS is still
+// toggled for each frame, as the chip requires
+void MCP23S08::beginExchange(){
+#if defined (SPI_HAS_TRANSACTION)
+	if (_spiTransactionsSpeed > 0) 
+		mSpi->beginTransaction(SPISettings(_spiTransactionsSpeed, MSBFIRST, SPI_MODE0));
+#endif
+	_inExchange = true;
+}
+
+void MCP23S08::endExchange(){
+	_inExchange = false;
+#if defined (SPI_HAS_TRANSACTION)
+	if (_spiTransactionsSpeed > 0) 
+		mSpi->endTransaction();
+#endif
 }
 
 int MCP23S08::gpioDigitalRead(uint8_t pin){
@@ -249,27 +325,43 @@ void MCP23S08::gpioRegisterWriteByte(byte reg,byte data){
 }
 
 /* ------------------------------ Low Level ----------------*/
-void MCP23S08::startSend(bool mode){
-#if defined (SPI_HAS_TRANSACTION)
-	if (_spiTransactionsSpeed > 0) 
-		mSpi->beginTransaction(SPISettings(_spiTransactionsSpeed, MSBFIRST, SPI_MODE0));
-#endif
+// ***TE*** On the ESP32, CS is set via the GPIO set/clear registers, which
+// is much faster than digitalWrite()
+inline void MCP23S08::csLow(){
 #if defined(__FASTWRITE)
 	digitalWriteFast(_cs, LOW);
+#elif defined(ESP32)
+	if (_cs < 32) REG_WRITE(GPIO_OUT_W1TC_REG, (uint32_t)1 << _cs);
+	else digitalWrite(_cs, LOW);
 #else
 	digitalWrite(_cs, LOW);
 #endif
-	mode == 1 ? mSpi->transfer(_readCmd) : mSpi->transfer(_writeCmd);
 }
 
-void MCP23S08::endSend(){
+inline void MCP23S08::csHigh(){
 #if defined(__FASTWRITE)
 	digitalWriteFast(_cs, HIGH);
+#elif defined(ESP32)
+	if (_cs < 32) REG_WRITE(GPIO_OUT_W1TS_REG, (uint32_t)1 << _cs);
+	else digitalWrite(_cs, HIGH);
 #else
 	digitalWrite(_cs, HIGH);
 #endif
+}
+
+void MCP23S08::startSend(bool mode){
 #if defined (SPI_HAS_TRANSACTION)
-	if (_spiTransactionsSpeed > 0) 
+	if ((_spiTransactionsSpeed > 0) && !_inExchange) 
+		mSpi->beginTransaction(SPISettings(_spiTransactionsSpeed, MSBFIRST, SPI_MODE0));
+#endif
+	csLow();
+	mode == 1 ? mSpi->transfer(_readCmd) : mSpi->transfer(_writeCmd);
+}
+
+void MCP23S08::endSend(){
+	csHigh();
+#if defined (SPI_HAS_TRANSACTION)
+	if ((_spiTransactionsSpeed > 0) && !_inExchange) 
 		mSpi->endTransaction();
 #endif
 }
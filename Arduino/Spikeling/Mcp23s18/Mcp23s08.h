@@ -106,6 +106,15 @@ public:
 	void 			gpioRegisterWriteByte(byte reg,byte data);		//write a chip register
 	void			portPullup(uint8_t data);						// true=pullup, false=pulldown all pins
 	void			gpioPortUpdate();
+	uint8_t			gpioPortExchange(uint8_t *intRegs=NULL);	//read all pins and write changed outputs, see below
+	// register blocks (sequential addressing, one CS frame; max. 11 registers)
+	void			readRegisters(byte reg, uint8_t *data, uint8_t count);
+	void			writeRegisters(byte reg, const uint8_t *data, uint8_t count);
+	// keep the SPI transaction open across several operations, e.g. those of
+	// one housekeeping cycle (other devices on the bus may be used in between,
+	// if they use the same SPI settings)
+	void			beginExchange();
+	void			endExchange();
 	// direct access commands
 	uint8_t 		readAddress(byte addr);
   //int 			getInterruptNumber(byte pin);
@@ -138,6 +147,10 @@ private:
 	void 			endSend();
 	uint8_t			_gpioDirection;
 	uint8_t			_gpioState;
+	uint8_t			_olatState;		//last value written to the output latch
+	bool			_inExchange;	//between beginExchange() and endExchange()
+	inline void		csLow();
+	inline void		csHigh();
     void			writeByte(byte addr, byte data);	
 };
 #endif
\ No newline at end of file
@@ -0,0 +1,199 @@
+// -----------------------------------------------------------------------------
+// Simulation core: input currents and Izhikevich model
+//
+// loop() in Spikeling.ino reads the hardware into a model_input_t and then
+// calls the stages below (or their fixed-point versions in FixedPoint.h, if
+// USES_FIXED_POINT is defined). The statements are the same as they were in
+// loop(), so results do not change.
+//
+// This header is also compiled on the host ("Host tools", e.g. spikeling_sim)
+// and therefore must not depend on the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  Model_h
+#define  Model_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define  NOISE_SCALE      16      // model_input_t.Noise in units of 1/NOISE_SCALE
+
+// Global settings (copied from the user parameters)
+//
+typedef struct {
+  float  timestep_ms;
+  float  Synapse_decay;
+  float  PD_gain_min;
+  float  PD_Scaling;
+  int    VmPotiScaling;
+  int    AnalogInScaling;
+  int    SynapseScaling;
+  int    AnalogInActive;
+  } model_config_t;
+
+// Parameters of one neuron mode (copied from the Array_xxx user parameters)
+//
+typedef struct {
+  float  a, b;
+  int    c;
+  float  d;
+  float  PD_decay;
+  float  PD_recovery;
+  int    PD_polarity;
+  } model_mode_t;
+
+// Inputs of one model step, as read from the hardware
+//
+typedef struct {
+  int    VmPotVal;
+  int    AnalogInPotVal;
+  int    AnalogInVal;
+  int    PDVal_smoothed;
+  int    Syn1PotVal;
+  int    Syn2PotVal;
+  int    SpikeIn1State;    // synapse inputs: 0/1 if polled, number of
+  int    SpikeIn2State;    // pulses in this step with USES_SYNAPSE_EDGES
+  long   Noise;            // noise increment in units of 1/NOISE_SCALE, for
+                           // the range r of modelNoiseRange() (see Noise.h)
+  } model_input_t;
+
+// Model state
+//
+typedef struct {
+  float  v, u;
+  float  I_total, I_PD, I_Vm, I_AnalogIn, I_Synapse, I_Noise;
+  float  PD_gain;
+  float  v_pre;            // v of the last step before the reset check
+  } model_state_t;
+
+// -----------------------------------------------------------------------------
+static inline void modelInitConfig(model_config_t* cfg, float timestep_ms,
+                                   float Synapse_decay, float PD_gain_min,
+                                   float PD_Scaling, int VmPotiScaling,
+                                   int AnalogInScaling, int SynapseScaling,
+                                   int AnalogInActive)
+{
+  cfg->timestep_ms     = timestep_ms;
+  cfg->Synapse_decay   = Synapse_decay;
+  cfg->PD_gain_min     = PD_gain_min;
+  cfg->PD_Scaling      = PD_Scaling;
+  cfg->VmPotiScaling   = VmPotiScaling;
+  cfg->AnalogInScaling = AnalogInScaling;
+  cfg->SynapseScaling  = SynapseScaling;
+  cfg->AnalogInActive  = AnalogInActive;
+}
+
+static inline void modelInitMode(model_mode_t* m, float a, float b, int c,
+                                 float d, float PD_decay, float PD_recovery,
+                                 int PD_polarity)
+{
+  m->a           = a;
+  m->b           = b;
+  m->c           = c;
+  m->d           = d;
+  m->PD_decay    = PD_decay;
+  m->PD_recovery = PD_recovery;
+  m->PD_polarity = PD_polarity;
+}
+
+static inline void modelInitState(model_state_t* s)
+{
+  memset(s, 0, sizeof(model_state_t));
+  s->PD_gain = 1.0;
+}
+
+// Half range of the noise current increment (same as NoiseAmpl/2, truncated,
+// as passed to random() in Spikeling 1.x)
+//
+static inline long modelNoiseRange(int NoisePotVal, int NoiseScaling)
+{
+  long r = -1L *(NoisePotVal -512) /NoiseScaling /2;
+  return (r < 0) ? 0 : r;
+}
+
+// -----------------------------------------------------------------------------
+// Stage 1: Sum up all input currents
+// -----------------------------------------------------------------------------
+static inline void modelCurrents(model_state_t* s, const model_input_t* in,
+                                 const model_mode_t* m, const model_config_t* cfg)
+{
+  float AnalogInAmpl, Synapse1Ampl, Synapse2Ampl;
+
+  // calculate I_Vm
+  s->I_Vm = -1 * (in->VmPotVal-512) / cfg->VmPotiScaling;
+
+  // Analog in and Noise scaling
+  AnalogInAmpl = ((float)in->AnalogInPotVal - 512) / cfg->AnalogInScaling;
+  s->I_Noise+=in->Noise * (1.0f/NOISE_SCALE);
+  s->I_Noise*=0.9;
+
+  // calculate I_AnalogIn
+  s->I_AnalogIn = -1 * ((float)in->AnalogInVal) * AnalogInAmpl;
+  if (cfg->AnalogInActive == 0) {s->I_AnalogIn = 0;}
+
+  // Photodiode current
+  s->I_PD = (((float)in->PDVal_smoothed) / cfg->PD_Scaling) * s->PD_gain; // input current
+
+  if (s->PD_gain>cfg->PD_gain_min){
+    s->PD_gain-=m->PD_decay*s->I_PD; // adapts proportional to I_PD
+    if (s->PD_gain<cfg->PD_gain_min){
+      s->PD_gain=cfg->PD_gain_min;
+    }
+  }
+  if (s->PD_gain<1.0) {
+    s->PD_gain+=m->PD_recovery; // recovers by constant % per iteration
+  }
+
+  // calculate Synapse Ampl parameters
+  Synapse1Ampl = -1 * ((float)in->Syn1PotVal-512) / cfg->SynapseScaling;
+  Synapse2Ampl = -1 * ((float)in->Syn2PotVal-512) / cfg->SynapseScaling;
+  if (in->SpikeIn1State) {s->I_Synapse+=Synapse1Ampl*in->SpikeIn1State;}
+  if (in->SpikeIn2State) {s->I_Synapse+=Synapse2Ampl*in->SpikeIn2State;}
+
+  // Decay all synaptic current towards zero
+  s->I_Synapse*=cfg->Synapse_decay;
+
+  // Add up all current sources
+  s->I_total = s->I_PD*m->PD_polarity + s->I_Vm + s->I_Synapse + s->I_AnalogIn + s->I_Noise;
+}
+
+// -----------------------------------------------------------------------------
+// Stage 2: Advance the Izhikevich model by one timestep; returns true if the
+// neuron was reset (v >= 30 mV)
+// -----------------------------------------------------------------------------
+static inline bool modelIntegrate(model_state_t* s, const model_mode_t* m,
+                                  const model_config_t* cfg)
+{
+  bool reset = false;
+
+  s->v = s->v + cfg->timestep_ms*(0.04 * s->v * s->v + 5*s->v + 140 - s->u + s->I_total);
+  s->u = s->u + cfg->timestep_ms*(m->a * ( m->b*s->v - s->u));
+  s->v_pre = s->v;
+  if (s->v>=30.0){s->v=m->c; s->u+=m->d; reset = true;}
+  if (s->v<=-90) {s->v=-90.0;} // prevent from analog out (below) going into overdrive - but also means that it will flatline at -90
+  return reset;
+}
+
+// Time of the threshold crossing within a step that ended in a reset, as
+// fraction of the step (0: start, 1: end), linearly interpolated between v at
+// the start of the step and the pre-reset v (v_pre)
+//
+static inline float modelSpikeFraction(float v_start, float v_pre)
+{
+  float f;
+
+  if (v_pre <= v_start) {return 1.0;}
+  f = (30.0f - v_start) / (v_pre - v_start);
+  if (f < 0) {f = 0;}
+  if (f > 1) {f = 1;}
+  return f;
+}
+
+static inline bool modelStep(model_state_t* s, const model_input_t* in,
+                             const model_mode_t* m, const model_config_t* cfg)
+{
+  modelCurrents(s, in, m, cfg);
+  return modelIntegrate(s, m, cfg);
+}
+
+#endif
+// -----------------------------------------------------------------------------
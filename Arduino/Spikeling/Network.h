@@ -0,0 +1,143 @@
+// -----------------------------------------------------------------------------
+// Small network of Izhikevich neurons (USES_NETWORK)
+//
+// The state is kept as arrays over the neurons (structure of arrays), so that
+// one step runs through each array in a tight loop. Each neuron has its own
+// mode parameters (a, b, c, d, from the Array_xxx tables via model_mode_t),
+// a synaptic current that decays like the synapses of the single neuron, and
+// a gain for the external drive, i.e. the current that modelCurrents() sums
+// up from photodiode, dials, synapse inputs, analog in and noise.
+//
+// Connections are stored as weights w[post][pre], the current added to the
+// post-synaptic neuron when the pre-synaptic one spikes. Spikes are passed on
+// in the step after they occurred, so the order of the neurons does not
+// matter.
+//
+// This header is also compiled on the host and therefore must not depend on
+// the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  Network_h
+#define  Network_h
+
+#include <stdint.h>
+#include <string.h>
+#include "Model.h"
+
+#ifndef  NET_MAX_NEURONS
+#define  NET_MAX_NEURONS  32       // set per board in the settings file
+#endif
+
+// Connectivity patterns for netConnect()
+//
+#define  NET_CONN_NONE    0        // no connections
+#define  NET_CONN_CHAIN   1        // 0 -> 1 -> 2 -> ... -> n-1
+#define  NET_CONN_RING    2        // chain, and n-1 -> 0
+#define  NET_CONN_ALL     3        // all-to-all, without self-connections
+#define  NET_CONN_RANDOM  4        // each pair with probability 1/4
+
+typedef struct {
+  uint8_t  n;                                 // number of neurons
+  uint8_t  nSpikes;                           // spikes in the last step
+  float    v[NET_MAX_NEURONS];
+  float    u[NET_MAX_NEURONS];
+  float    I_syn[NET_MAX_NEURONS];            // recurrent synaptic current
+  float    gain[NET_MAX_NEURONS];             // gain of the external drive
+  float    a[NET_MAX_NEURONS], b[NET_MAX_NEURONS];
+  float    c[NET_MAX_NEURONS], d[NET_MAX_NEURONS];
+  uint8_t  spiked[NET_MAX_NEURONS];           // 1 if reset in the last step
+  float    w[NET_MAX_NEURONS][NET_MAX_NEURONS];
+  } network_t;
+
+// -----------------------------------------------------------------------------
+// Set up `n` neurons at rest, all with mode `m`, without connections; only
+// neuron 0 receives the external drive
+// -----------------------------------------------------------------------------
+static inline void netSetMode(network_t* net, int i, const model_mode_t* m)
+{
+  net->a[i] = m->a;
+  net->b[i] = m->b;
+  net->c[i] = m->c;
+  net->d[i] = m->d;
+}
+
+static inline void netInit(network_t* net, int n, const model_mode_t* m)
+{
+  if(n < 1) n = 1;
+  if(n > NET_MAX_NEURONS) n = NET_MAX_NEURONS;
+  memset(net, 0, sizeof(network_t));
+  net->n = (uint8_t)n;
+  for(int i=0; i<n; i++) {
+    netSetMode(net, i, m);
+  }
+  net->gain[0] = 1.0;
+}
+
+// -----------------------------------------------------------------------------
+// Replace the connections by one of the NET_CONN_xxx patterns, all with the
+// same weight (negative weights are inhibitory)
+// -----------------------------------------------------------------------------
+static inline void netConnect(network_t* net, int pattern, float weight)
+{
+  uint32_t rnd = 2463534242UL;    // fixed seed, same network on every start
+
+  memset(net->w, 0, sizeof(net->w));
+  for(int post=0; post<net->n; post++) {
+    for(int pre=0; pre<net->n; pre++) {
+      bool on = false;
+      switch(pattern) {
+        case NET_CONN_CHAIN:  on = (post == pre +1); break;
+        case NET_CONN_RING:   on = (post == (pre +1) %net->n) && (post != pre); break;
+        case NET_CONN_ALL:    on = (post != pre); break;
+        case NET_CONN_RANDOM:
+          rnd ^= rnd << 13;
+          rnd ^= rnd >> 17;
+          rnd ^= rnd << 5;
+          on = (post != pre) && ((rnd & 3) == 0);
+          break;
+      }
+      if(on) net->w[post][pre] = weight;
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// Advance all neurons by one timestep, with `I_ext` as external drive (the
+// I_total of the single-neuron model); returns the number of spikes
+// -----------------------------------------------------------------------------
+static inline int netStep(network_t* net, float I_ext, const model_config_t* cfg)
+{
+  const int   n  = net->n;
+  const float dt = cfg->timestep_ms;
+  int         i, j;
+
+  // Izhikevich model, same statements as modelIntegrate()
+  //
+  for(i=0; i<n; i++) {
+    float v = net->v[i], u = net->u[i];
+    v = v + dt*(0.04f * v * v + 5*v + 140 - u + I_ext*net->gain[i] + net->I_syn[i]);
+    u = u + dt*(net->a[i] * (net->b[i]*v - u));
+    net->spiked[i] = (v >= 30.0f);
+    if (net->spiked[i]) {v = net->c[i]; u += net->d[i];}
+    if (v <= -90) {v = -90.0f;}
+    net->v[i] = v;
+    net->u[i] = u;
+  }
+
+  // Decay the synaptic currents and add the spikes of this step
+  //
+  net->nSpikes = 0;
+  for(i=0; i<n; i++) {
+    net->I_syn[i] *= cfg->Synapse_decay;
+  }
+  for(j=0; j<n; j++) {
+    if (!net->spiked[j]) continue;
+    net->nSpikes++;
+    for(i=0; i<n; i++) {
+      net->I_syn[i] += net->w[i][j];
+    }
+  }
+  return net->nSpikes;
+}
+
+#endif
+// -----------------------------------------------------------------------------
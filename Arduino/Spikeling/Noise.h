@@ -0,0 +1,132 @@
+// -----------------------------------------------------------------------------
+// Noise sources: the noise current of the model and the binary noise of the
+// stimulator (Syn1Mode = 2)
+//
+// Both come from one xorshift32 generator (Marsaglia 2003: three shifts and
+// XORs per 32 random bits, no multiplication or division), seeded with
+// NoiseSeed in Spikeling.ino. The same seed gives the same sequence on every
+// board and in the host tools, so a recording can be replayed exactly with
+// spikeling_sim. Arduino's random() instead takes two 32-bit divisions per
+// number on AVR (and one more for the range), and on the ESP32 it is the
+// hardware RNG, which cannot be replayed.
+//
+// The noise current follows I_Noise = 0.9 *(I_Noise +increment) (see Model.h);
+// the increments are
+//   - Gaussian (default): from a table of 128 quantiles of |N(0,1)| in units
+//     of 1/NOISE_GAUSS_ONE (adjusted to a variance of exactly 1), indexed by
+//     7 random bits, plus a sign bit; tails are cut at 2.9 SD
+//   - uniform: in [-range, range), as the random() of Spikeling 1.x did (but
+//     in steps of 1/NOISE_SCALE, so without its mean of -0.5)
+// with the same variance (range^2/3) for the same dial setting, so the noise
+// level does not change. Both are in units of 1/NOISE_SCALE; one 32-bit
+// number gives four Gaussian increments or 32 stimulator bits.
+//
+// This header is also compiled on the host and therefore must not depend on
+// the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  Noise_h
+#define  Noise_h
+
+#include <stdint.h>
+#include "Model.h"
+
+#if defined(__AVR__)
+  #include <avr/pgmspace.h>
+  #define NOISE_TABLE_ATTR     PROGMEM
+  #define noiseTableRead(i)    pgm_read_byte(&NoiseGaussTable[i])
+#else
+  #define NOISE_TABLE_ATTR
+  #define noiseTableRead(i)    NoiseGaussTable[i]
+#endif
+
+#define  NOISE_GAUSS_ONE      64          // table units per SD
+#define  NOISE_DEFAULT_SEED   2463534242UL // (Marsaglia's example seed, for seed 0)
+
+static const uint8_t NoiseGaussTable[128] NOISE_TABLE_ATTR = {
+    0,   1,   2,   2,   3,   3,   4,   5,   5,   6,   7,   7,   8,   9,   9,  10,
+   10,  11,  12,  12,  13,  14,  14,  15,  16,  16,  17,  17,  18,  19,  19,  20,
+   21,  21,  22,  23,  23,  24,  25,  25,  26,  27,  28,  28,  29,  30,  30,  31,
+   32,  32,  33,  34,  35,  35,  36,  37,  38,  38,  39,  40,  41,  41,  42,  43,
+   44,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,  56,  56,
+   57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  69,  70,  71,  72,  73,
+   74,  76,  77,  78,  80,  81,  82,  84,  85,  87,  88,  90,  92,  94,  96,  97,
+   99, 102, 104, 106, 109, 112, 115, 118, 121, 125, 130, 135, 142, 150, 162, 185};
+
+typedef struct {
+  uint32_t s;                     // generator state, never 0
+  uint32_t bits;                  // unused random bits for noiseBit() ...
+  uint8_t  nBits;
+  uint32_t bytes;                 // ... and for noiseGauss()
+  uint8_t  nBytes;
+  } noise_t;
+
+// -----------------------------------------------------------------------------
+static inline void noiseSeed(noise_t* n, uint32_t seed)
+{
+  n->s      = (seed != 0) ? seed : NOISE_DEFAULT_SEED;
+  n->nBits  = 0;
+  n->nBytes = 0;
+}
+
+static inline uint32_t noiseNext(noise_t* n)
+{
+  uint32_t x = n->s;
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  n->s = x;
+  return x;
+}
+
+// One random bit (0 or 1, each with probability 1/2)
+//
+static inline uint8_t noiseBit(noise_t* n)
+{
+  uint8_t b;
+  if(n->nBits == 0) {
+    n->bits  = noiseNext(n);
+    n->nBits = 32;
+  }
+  b = (uint8_t)(n->bits & 1);
+  n->bits >>= 1;
+  n->nBits--;
+  return b;
+}
+
+// N(0,1) in units of 1/NOISE_GAUSS_ONE
+//
+static inline int16_t noiseGauss(noise_t* n)
+{
+  uint8_t r;
+  int16_t g, sign;
+  if(n->nBytes == 0) {
+    n->bytes  = noiseNext(n);
+    n->nBytes = 4;
+  }
+  r = (uint8_t)(n->bytes & 0xFF);
+  n->bytes >>= 8;
+  n->nBytes--;
+  g    = noiseTableRead(r & 0x7F);
+  sign = -(int16_t)(r >> 7);                // 0 or -1, without a branch
+  return (g ^ sign) -sign;
+}
+
+// Increment of the noise current in units of 1/NOISE_SCALE, for the half
+// range `range` of modelNoiseRange() (see Model.h)
+//
+static inline long noiseIncrement(noise_t* n, long range, uint8_t gaussian)
+{
+  if(range <= 0) return 0;
+  if(gaussian) {
+    // SD range/sqrt(3), as the uniform increments: 2365/2^14 = 1/sqrt(3) times
+    // NOISE_SCALE/NOISE_GAUSS_ONE (= 1/4), rounded (>> is an arithmetic shift
+    // on all targets)
+    return ((int32_t)noiseGauss(n) *range *2365 +8192) >> 14;
+  }
+  // uniform in [-range, range): 16 random bits times the width, without modulo
+  return (long)((((uint32_t)(noiseNext(n) >> 16)) *(uint32_t)(2 *range *NOISE_SCALE)) >> 16)
+         -range *NOISE_SCALE;
+}
+
+#endif
+// -----------------------------------------------------------------------------
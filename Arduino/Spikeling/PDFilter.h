@@ -0,0 +1,129 @@
+// -----------------------------------------------------------------------------
+// Streaming filter for the photodiode readings
+//
+// Selected per neuron mode via Array_PD_filter and Array_PD_window (see
+// Spikeling.ino):
+//
+//   PD_FILTER_BOXCAR  mean over the last `window` readings (1..32), updated
+//                     in O(1) as a running sum
+//   PD_FILTER_EMA     exponential moving average, y += (x -y) /2^k, with 2^k
+//                     the largest power of two <= `window` (1..255)
+//   PD_FILTER_FIR     binomial (Gaussian-like) FIR with `window` taps (1..9),
+//                     integer coefficients that sum up to a power of two
+//
+// All versions work on the raw 10-bit ADC values in integer arithmetic.
+// This header is also compiled on the host and therefore must not depend on
+// the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  PDFilter_h
+#define  PDFilter_h
+
+#include <stdint.h>
+#include <string.h>
+
+#define  PD_FILTER_BOXCAR      0
+#define  PD_FILTER_EMA         1
+#define  PD_FILTER_FIR         2
+
+#define  PD_FILTER_MAX_WINDOW  32
+#define  PD_FIR_MAX_TAPS       9
+#define  PD_EMA_FRAC_BITS      6   // EMA state has 6 fractional bits
+
+typedef struct {
+  uint8_t  type;
+  uint8_t  window;
+  uint8_t  shift;                  // EMA: k, FIR: log2(sum of coefficients)
+  uint8_t  iHist;                  // position of the oldest reading
+  uint16_t hist[PD_FILTER_MAX_WINDOW];
+  uint8_t  coef[PD_FIR_MAX_TAPS];
+  uint16_t sum;                    // boxcar: sum over hist[]
+  uint16_t ema;                    // EMA: state << PD_EMA_FRAC_BITS
+  uint16_t out;                    // last filter output
+  } pdfilter_t;
+
+// -----------------------------------------------------------------------------
+// (Re)configure the filter; the history is filled with `init`, so switching
+// filters does not cause a jump in the output
+// -----------------------------------------------------------------------------
+static inline void pdfInit(pdfilter_t* f, int type, int window, uint16_t init)
+{
+  uint8_t i;
+
+  f->type   = (uint8_t)type;
+  f->shift  = 0;
+  switch(type) {
+    case PD_FILTER_EMA:
+      if(window < 1) window = 1;
+      if(window > 255) window = 255;
+      while((2 << f->shift) <= window) {
+        f->shift++;
+      }
+      break;
+
+    case PD_FILTER_FIR:
+      if(window < 1) window = 1;
+      if(window > PD_FIR_MAX_TAPS) window = PD_FIR_MAX_TAPS;
+      // Row `window`-1 of Pascal's triangle, sums up to 2^(window-1)
+      //
+      f->coef[0] = 1;
+      for(i=1; i<window; i++) {
+        f->coef[i] = (uint8_t)((uint16_t)f->coef[i-1] *(window -i) /i);
+      }
+      f->shift = window -1;
+      break;
+
+    case PD_FILTER_BOXCAR:
+    default:
+      f->type = PD_FILTER_BOXCAR;
+      if(window < 1) window = 1;
+      if(window > PD_FILTER_MAX_WINDOW) window = PD_FILTER_MAX_WINDOW;
+  }
+  f->window = (uint8_t)window;
+  f->iHist  = 0;
+  for(i=0; i<f->window; i++) {
+    f->hist[i] = init;
+  }
+  f->sum    = init *f->window;
+  f->ema    = (uint16_t)((uint32_t)init << PD_EMA_FRAC_BITS);
+  f->out    = init;
+}
+
+// -----------------------------------------------------------------------------
+// Add a reading (0..1023) and return the filtered value
+// -----------------------------------------------------------------------------
+static inline uint16_t pdfUpdate(pdfilter_t* f, uint16_t x)
+{
+  switch(f->type) {
+    case PD_FILTER_EMA:
+      f->ema += (int16_t)((((int32_t)x << PD_EMA_FRAC_BITS) -f->ema) >> f->shift);
+      f->out  = (f->ema +(1 << (PD_EMA_FRAC_BITS -1))) >> PD_EMA_FRAC_BITS;
+      break;
+
+    case PD_FILTER_FIR: {
+      // hist[iHist] is the oldest reading; replace it and then weight the
+      // readings from newest to oldest (the kernel is symmetric anyway)
+      //
+      uint32_t acc = 0;
+      uint8_t  j   = f->iHist;
+      f->hist[j] = x;
+      for(uint8_t i=0; i<f->window; i++) {
+        acc += (uint32_t)f->coef[i] *f->hist[j];
+        j = (j == 0) ? f->window -1 : j -1;
+      }
+      f->iHist = (f->iHist +1 >= f->window) ? 0 : f->iHist +1;
+      f->out   = (uint16_t)((acc +((1UL << f->shift) >> 1)) >> f->shift);
+      break;
+    }
+
+    case PD_FILTER_BOXCAR:
+    default:
+      f->sum  += x -f->hist[f->iHist];
+      f->hist[f->iHist] = x;
+      f->iHist = (f->iHist +1 >= f->window) ? 0 : f->iHist +1;
+      f->out   = f->sum /f->window;
+  }
+  return f->out;
+}
+
+#endif
+// -----------------------------------------------------------------------------
@@ -0,0 +1,64 @@
+// -----------------------------------------------------------------------------
+// Timing of the stages of loop() (if USES_STAGE_PROFILING is defined)
+//
+// Each stage is wrapped in PROFILE_STAGE(), which reads a clock before and
+// after the stage; the clock is provided by the Settings file:
+//
+//   profileClock()        current counter value (uint32_t)
+//   PROFILE_CLOCK_MASK    counter width (differences are taken modulo this)
+//   PROFILE_CLOCK_SCALE   CPU cycles per count
+//   PROFILE_CLOCK_UNIT    unit after scaling ("cycles")
+//
+// Every PROFILE_REPORT_EVERY steps, loop() sends the mean and maximum cycles
+// per stage as one JSON line (see reportProfile() in Spikeling.ino).
+//
+// This header is also compiled on the host and therefore must not depend on
+// the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  Profiling_h
+#define  Profiling_h
+
+#include <stdint.h>
+
+#define  STAGE_BUTTON          0
+#define  STAGE_ADC             1
+#define  STAGE_PD_FILTER       2
+#define  STAGE_CURRENTS        3
+#define  STAGE_IZHIKEVICH      4
+#define  STAGE_OUTPUTS         5
+#define  STAGE_STIMULATOR      6
+#define  STAGE_SERIAL          7
+#define  STAGE_PLOT            8       // display (boards with a screen)
+#define  N_STAGES              9
+
+#define  PROFILE_REPORT_EVERY  1000
+
+static const char* const StageNames[N_STAGES] = {
+  "button", "adc", "pd_filter", "currents", "izhikevich", "outputs",
+  "stimulator", "serial", "plot"};
+
+typedef struct {
+  uint32_t calls;
+  uint32_t sum;            // in cycles
+  uint32_t max;
+  } stageprof_t;
+
+static inline void profileAdd(stageprof_t* p, uint32_t cycles)
+{
+  p->calls++;
+  p->sum += cycles;
+  if(cycles > p->max) p->max = cycles;
+}
+
+#ifdef USES_STAGE_PROFILING
+  #define PROFILE_STAGE(id, call) { \
+    uint32_t t0_ = profileClock(); \
+    call; \
+    profileAdd(&StageProf[id], ((profileClock() -t0_) & PROFILE_CLOCK_MASK) *PROFILE_CLOCK_SCALE); \
+    }
+#else
+  #define PROFILE_STAGE(id, call) call
+#endif
+
+#endif
+// -----------------------------------------------------------------------------
@@ -0,0 +1,141 @@
+// -----------------------------------------------------------------------------
+// Ring buffers for one producer and one consumer: bytes (e.g. serial lines
+// and frames) and fixed-size records (e.g. output_t)
+//
+// The producer only changes `head`, the consumer only `tail`, so no locking is
+// needed as long as each side stays in its own context (e.g. model step and
+// serial output, or the two cores of the ESP32). `head` is only advanced
+// after the data is written, and `tail` only after it is read (with memory
+// fences, for the case that producer and consumer run on different cores).
+// The size must be a power of two; one byte (record) stays unused to tell a
+// full from an empty buffer.
+//
+// This header is also compiled on the host and therefore must not depend on
+// the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  RingBuffer_h
+#define  RingBuffer_h
+
+#include <stdint.h>
+#include <string.h>
+
+typedef struct {
+  uint8_t*          buf;
+  uint16_t          mask;          // size -1
+  volatile uint16_t head;          // next byte to write (producer)
+  volatile uint16_t tail;          // next byte to read (consumer)
+  } ringbuf_t;
+
+// -----------------------------------------------------------------------------
+static inline void rbInit(ringbuf_t* rb, uint8_t* buf, uint16_t size)
+{
+  rb->buf  = buf;
+  rb->mask = size -1;
+  rb->head = 0;
+  rb->tail = 0;
+}
+
+static inline uint16_t rbCount(const ringbuf_t* rb)
+{
+  return (rb->head -rb->tail) & rb->mask;
+}
+
+static inline uint16_t rbFree(const ringbuf_t* rb)
+{
+  return rb->mask -rbCount(rb);
+}
+
+// Append `len` bytes; if they do not fit, nothing is written and false is
+// returned, so that a frame or line is never sent in parts
+//
+static inline bool rbWrite(ringbuf_t* rb, const void* data, uint16_t len)
+{
+  uint16_t h = rb->head, n;
+
+  if(len > rbFree(rb)) {
+    return false;
+  }
+  n = rb->mask +1 -h;
+  if(n > len) n = len;
+  memcpy(rb->buf +h, data, n);
+  memcpy(rb->buf, (const uint8_t*)data +n, len -n);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  rb->head = (h +len) & rb->mask;
+  return true;
+}
+
+// Take up to `maxLen` bytes out of the buffer; returns the number of bytes
+//
+static inline uint16_t rbRead(ringbuf_t* rb, uint8_t* data, uint16_t maxLen)
+{
+  uint16_t t = rb->tail, len = rbCount(rb), n;
+
+  if(len > maxLen) len = maxLen;
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  n = rb->mask +1 -t;
+  if(n > len) n = len;
+  memcpy(data, rb->buf +t, n);
+  memcpy(data +n, rb->buf, len -n);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  rb->tail = (t +len) & rb->mask;
+  return len;
+}
+
+// -----------------------------------------------------------------------------
+// Ring of `nRecs` records of `recSize` bytes each
+// -----------------------------------------------------------------------------
+typedef struct {
+  uint8_t*          buf;
+  uint16_t          recSize;       // bytes per record
+  uint16_t          mask;          // number of records -1
+  volatile uint16_t head;          // next record to write (producer)
+  volatile uint16_t tail;          // next record to read (consumer)
+  } recring_t;
+
+static inline void rrInit(recring_t* rr, void* buf, uint16_t recSize, uint16_t nRecs)
+{
+  rr->buf     = (uint8_t*)buf;
+  rr->recSize = recSize;
+  rr->mask    = nRecs -1;
+  rr->head    = 0;
+  rr->tail    = 0;
+}
+
+static inline uint16_t rrCount(const recring_t* rr)
+{
+  return (rr->head -rr->tail) & rr->mask;
+}
+
+// Append one record; returns false (and drops it) if the ring is full
+//
+static inline bool rrPush(recring_t* rr, const void* rec)
+{
+  uint16_t h = rr->head;
+
+  if(((h +1) & rr->mask) == rr->tail) {
+    return false;
+  }
+  memcpy(rr->buf +(uint32_t)h *rr->recSize, rec, rr->recSize);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  rr->head = (h +1) & rr->mask;
+  return true;
+}
+
+// Take the oldest record out of the ring; returns false if it is empty
+//
+static inline bool rrPop(recring_t* rr, void* rec)
+{
+  uint16_t t = rr->tail;
+
+  if(t == rr->head) {
+    return false;
+  }
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  memcpy(rec, rr->buf +(uint32_t)t *rr->recSize, rr->recSize);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+  rr->tail = (t +1) & rr->mask;
+  return true;
+}
+
+#endif
+// -----------------------------------------------------------------------------
@@ -0,0 +1,158 @@
+// -----------------------------------------------------------------------------
+// Binary framed serial protocol
+//
+// Used instead of the ASCII lines if SerialMode > 0 (see Spikeling.ino). Each
+// frame is laid out as follows (all multi-byte values are little-endian, which
+// is the native byte order on AVR, ESP32 and x86):
+//
+//   sync   2 bytes  0xA5 0x5A
+//   type   1 byte   frame type (FRAME_TYPE_xxx), defines the payload
+//   length 1 byte   payload length in bytes
+//   seq    2 bytes  frame counter, incremented for every frame sent
+//   ...    length   payload
+//   crc    2 bytes  CRC-16/MCRF4XX (reflected CCITT, init 0xFFFF) over type,
+//                   length, seq and payload; same as avr-libc _crc_ccitt_update
+//
+// This header is shared with the host-side decoder ("Host tools" folder) and
+// therefore must not depend on the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  SerialFrame_h
+#define  SerialFrame_h
+
+#include <stdint.h>
+#include <string.h>
+#include "Definitions.h"
+
+#define  FRAME_SYNC0          0xA5
+#define  FRAME_SYNC1          0x5A
+#define  FRAME_HEADER_LEN     6
+#define  FRAME_CRC_LEN        2
+#define  FRAME_MAX_PAYLOAD    255
+
+// Frame types
+//
+#define  FRAME_TYPE_SAMPLE    'S'   // payload: sample_t
+#define  FRAME_TYPE_SPIKE     'P'   // payload: spikeevent_t (SerialMode = 2)
+#define  FRAME_TYPE_STIM      'I'   // payload: stateevent_t, new Stim_State
+#define  FRAME_TYPE_MODE      'M'   // payload: stateevent_t, new NeuronBehaviour
+#define  FRAME_TYPE_SYN1      'Y'   // payload: stateevent_t, pulses on synapse input 1
+#define  FRAME_TYPE_SYN2      'Z'   // payload: stateevent_t, pulses on synapse input 2
+#define  FRAME_TYPE_KEY       'K'   // payload: keysample_t (SerialMode = 3, see DeltaStream.h)
+#define  FRAME_TYPE_DELTA     'D'   // payload: delta records (SerialMode = 3)
+#define  FRAME_TYPE_STA       'T'   // payload: part of the on-board STA (see StaKernel.h)
+
+// Bits in sample_t.flags
+//
+#define  FLAG_STIM_STATE      0x01
+#define  FLAG_SPIKE_IN1       0x02
+#define  FLAG_SPIKE_IN2       0x04
+#define  FLAG_TICK_MISSED     0x08  // model ticks were missed before this sample
+
+// One model sample (derived from output_t, but with fixed-size fields)
+//
+typedef struct __attribute__((packed)) {
+  float    v, I_total, I_PD, I_AnalogIn, I_Synapse;
+  uint32_t currentMicros;
+  uint8_t  flags;
+  uint8_t  NeuronBehaviour;
+  } sample_t;
+
+#define  FRAME_SAMPLE_LEN     (FRAME_HEADER_LEN +sizeof(sample_t) +FRAME_CRC_LEN)
+
+// Events (SerialMode = 2); `step` counts the model steps since the start,
+// `t_us` is in the time base of currentMicros. For spikes, both are
+// interpolated to the 30 mV crossing: the spike happened `frac`/65535 of
+// the way from step-1 to `step`. For synapse inputs, `value` is the number
+// of pulses in the step and `t_us` the time of the latest one (both from the
+// edge capture with USES_SYNAPSE_EDGES; otherwise 1 and the step's time when
+// the polled input goes high).
+//
+typedef struct __attribute__((packed)) {
+  uint32_t step;
+  uint32_t t_us;
+  uint16_t frac;
+  } spikeevent_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t step;
+  uint32_t t_us;
+  uint8_t  value;
+  } stateevent_t;
+
+// -----------------------------------------------------------------------------
+static inline uint16_t crc16Update(uint16_t crc, uint8_t data)
+{
+  // Byte-wise reflected CCITT update without lookup table (cheap on AVR)
+  //
+  data ^= (uint8_t)(crc & 0xFF);
+  data ^= (uint8_t)(data << 4);
+  return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4)
+          ^ ((uint16_t)data << 3));
+}
+
+static inline uint16_t crc16(const uint8_t* buf, uint16_t len)
+{
+  uint16_t crc = 0xFFFF;
+  for(uint16_t i=0; i<len; i++) {
+    crc = crc16Update(crc, buf[i]);
+  }
+  return crc;
+}
+
+// -----------------------------------------------------------------------------
+// Write a complete frame into `buf` (which needs to hold at least
+// FRAME_HEADER_LEN +len +FRAME_CRC_LEN bytes) and return its total length
+// -----------------------------------------------------------------------------
+static inline uint16_t frameBuild(uint8_t* buf, uint8_t type, uint16_t seq,
+                                  const void* payload, uint8_t len)
+{
+  uint16_t crc;
+
+  buf[0] = FRAME_SYNC0;
+  buf[1] = FRAME_SYNC1;
+  buf[2] = type;
+  buf[3] = len;
+  buf[4] = (uint8_t)(seq & 0xFF);
+  buf[5] = (uint8_t)(seq >> 8);
+  memcpy(buf +FRAME_HEADER_LEN, payload, len);
+  crc = crc16(buf +2, FRAME_HEADER_LEN -2 +len);
+  buf[FRAME_HEADER_LEN +len]    = (uint8_t)(crc & 0xFF);
+  buf[FRAME_HEADER_LEN +len +1] = (uint8_t)(crc >> 8);
+  return FRAME_HEADER_LEN +len +FRAME_CRC_LEN;
+}
+
+// -----------------------------------------------------------------------------
+// Conversion between output_t and the sample payload
+// -----------------------------------------------------------------------------
+static inline void packSample(sample_t* s, const output_t* o)
+{
+  s->v               = o->v;
+  s->I_total         = o->I_total;
+  s->I_PD            = o->I_PD;
+  s->I_AnalogIn      = o->I_AnalogIn;
+  s->I_Synapse       = o->I_Synapse;
+  s->currentMicros   = (uint32_t)o->currentMicros;
+  s->flags           = (o->Stim_State    ? FLAG_STIM_STATE : 0)
+                     | (o->SpikeIn1State ? FLAG_SPIKE_IN1  : 0)
+                     | (o->SpikeIn2State ? FLAG_SPIKE_IN2  : 0)
+                     | (o->TickMissed    ? FLAG_TICK_MISSED : 0);
+  s->NeuronBehaviour = (uint8_t)o->NeuronBehaviour;
+}
+
+static inline void unpackSample(output_t* o, const sample_t* s)
+{
+  o->v               = s->v;
+  o->I_total         = s->I_total;
+  o->I_PD            = s->I_PD;
+  o->I_AnalogIn      = s->I_AnalogIn;
+  o->I_Synapse       = s->I_Synapse;
+  o->Stim_State      = (s->flags & FLAG_STIM_STATE) ? 1 : 0;
+  o->SpikeIn1State   = (s->flags & FLAG_SPIKE_IN1)  ? 1 : 0;
+  o->SpikeIn2State   = (s->flags & FLAG_SPIKE_IN2)  ? 1 : 0;
+  o->TickMissed      = (s->flags & FLAG_TICK_MISSED) ? 1 : 0;
+  o->currentMicros   = s->currentMicros;
+  o->NeuronBehaviour = s->NeuronBehaviour;
+}
+
+#endif
+// -----------------------------------------------------------------------------
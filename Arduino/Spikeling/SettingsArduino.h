@@ -9,9 +9,47 @@
 #define   USES_HOUSEKEEPING
 // Reads all ADCs in one pass
 
+//#define   USES_ADC_ISR
+// Converts the ADC channels in the background, driven by the ADC interrupt,
+// instead of reading them in housekeeping(); reading a value then never waits
+// for a conversion. Set the decimation per channel in ADCDecimation below
+
 //#define   USES_FASTER_PWM
 // Sets PWM pins 3 and 11 (timer 2) to 31250 Hz
 
+//#define   USES_FIXED_POINT
+// Computes currents and model in fixed-point integer arithmetic instead of
+// software-emulated float (see FixedPoint.h)
+
+//#define   USES_MODEL_TICK
+// Runs the model at a fixed rate (TickRateHz in Spikeling.ino) driven by
+// timer 1, and sends the serial output in the background. Timer 1 then also
+// generates the PWM for the LED (pin 9), at the tick rate
+
+//#define   USES_STAGE_PROFILING
+// Measures the cycles spent in each stage of loop() and sends them as a JSON
+// line every 1000 steps (see Profiling.h). Uses timer 1 as clock, therefore
+// not together with USES_MODEL_TICK; the LED on pin 9 then stays off
+
+//#define   USES_SYNAPSE_EDGES
+// Counts the rising edges on the synapse inputs (pins 4 and 5) with the pin
+// change interrupt, so that pulses shorter than one model step are not lost
+// and several pulses within one step all reach the synapse. The time of the
+// latest pulse is sent with the synapse events of SerialMode = 2
+
+//#define   USES_NETWORK
+// Simulates a small network of NetNeurons neurons instead of one (see
+// Network.h and the NetXxx parameters in Spikeling.ino). Float only; on the
+// Nano, each neuron adds about the time of the Izhikevich step (NetNeurons is
+// limited to NET_MAX_NEURONS)
+#define   NET_MAX_NEURONS  4
+
+//#define   USES_STA
+// Computes the spike-triggered average of the noise stimulus (Syn1Mode = 2)
+// and I_PD on the board (see StaKernel.h and SerialMode = 4). The window of
+// STA_POINTS steps takes 11 bytes of RAM per point
+#define   STA_POINTS       32
+
 //#define USES_PLOTTING
 //#define USES_FULL_REDRAW
 //#define USES_DAC
@@ -34,12 +72,29 @@
 #define DigitalOutPin 3  // "Axon" - generates 5V pulses
 #define AnalogOutPin  11 // Analog out for full spike waveform
 
-#ifdef USES_HOUSEKEEPING
+#if defined(USES_HOUSEKEEPING) || defined(USES_ADC_ISR)
   #define  MAX_ADC_DATA 8
   #define  N_ADC_IND    6
-  uint16_t ADCData[MAX_ADC_DATA];
   uint8_t iADCData[] = {PhotoDiodePin, VmPotPin, Syn1PotPin, Syn2PotPin,
                         NoisePotPin, AnalogInPin};
+  uint8_t iADCSource[]= {IN_PHOTODIODE, IN_VM_POT, IN_SYN1_POT, IN_SYN2_POT,
+                        IN_NOISE_POT, IN_ANALOG_IN};
+#endif
+#ifdef USES_ADC_ISR
+  // Two buffers per channel: the ISR writes into the older one and then flips
+  // the channel's bit in ADCFront, so a value is never read half-written
+  //
+  volatile uint16_t ADCData[MAX_ADC_DATA][2];
+  volatile uint8_t  ADCFront = 0; // bit i set: ADCData[i][1] is the newest
+  volatile uint8_t  iADCCurr = 0; // entry in iADCData being converted
+
+  // Convert entry i of iADCData only every ADCDecimation[i]-th time round;
+  // the dials do not need to be sampled as often as photodiode and analog in
+  //
+  uint8_t ADCDecimation[] = {1, 8, 8, 8, 8, 1};
+  uint8_t ADCSkip[N_ADC_IND];
+#elif defined(USES_HOUSEKEEPING)
+  uint16_t ADCData[MAX_ADC_DATA];
 #endif
 
 // Digital and analog I/O helper macros
@@ -47,8 +102,14 @@
 #define pinModeHelper(pin, mode)     pinMode(pin, mode)
 #define digitalReadHelper(pin)       digitalRead(pin)
 #define digitalWriteHelper(pin, val) digitalWrite(pin, val)
-#define analogWriteHelper(pin, val)  analogWrite(pin, val)
-#ifdef USES_HOUSEKEEPING
+#ifdef USES_MODEL_TICK
+  #define analogWriteHelper(pin, val)  analogWriteTick(pin, val)
+#else
+  #define analogWriteHelper(pin, val)  analogWrite(pin, val)
+#endif
+#if defined(USES_ADC_ISR)
+  #define analogReadHelper(pin)      ADC_get(pin -A0)
+#elif defined(USES_HOUSEKEEPING)
   #define analogReadHelper(pin)      ADCData[pin -A0]
 #else  
   #define analogReadHelper(pin)      analogRead(pin)
@@ -57,6 +118,7 @@
 // Serial out
 //
 #define SerOutBAUD 234000
+#define SerOutQueueSize 256 // bytes queued for background sending (power of 2)
 
 // -----------------------------------------------------------------------------
 // Pin definitions (hardware add-ons)
@@ -87,9 +149,19 @@ void ADC_init(void)
 {
   // Initialise buffers
   //
-  for(uint8_t i=0; i<MAX_ADC_DATA; i+=1) {
-    ADCData[i] = 0;
-  }
+  #if defined(USES_ADC_ISR)
+    for(uint8_t i=0; i<MAX_ADC_DATA; i+=1) {
+      ADCData[i][0] = 0;
+      ADCData[i][1] = 0;
+    }
+    for(uint8_t i=0; i<N_ADC_IND; i+=1) {
+      ADCSkip[i] = 0;
+    }
+  #elif defined(USES_HOUSEKEEPING)
+    for(uint8_t i=0; i<MAX_ADC_DATA; i+=1) {
+      ADCData[i] = 0;
+    }
+  #endif
   #ifdef USES_FAST_ADC
     // Change ADC prescaler 16, which slighly decreases the ADC precision but
     // speeds up the time per loop by ~20%
@@ -100,8 +172,47 @@ void ADC_init(void)
     cbi(ADCSRA,ADPS0);
 	  ADCSRA |= _BV(ADEN);  // Enable ADC
   #endif
+  #ifdef USES_ADC_ISR
+    // Start the first conversion; the ISR then keeps the ADC running
+    //
+    iADCCurr = 0;
+    ADMUX    = _BV(REFS0) | (iADCData[0] -A0);
+    ADCSRA  |= _BV(ADEN) | _BV(ADIE);
+    ADCSRA  |= _BV(ADSC);
+  #endif
 }
 
+#ifdef USES_ADC_ISR
+ISR(ADC_vect)
+{
+  // Store result in the back buffer of the channel and make it the front one
+  //
+  uint8_t ch = iADCData[iADCCurr] -A0;
+  ADCData[ch][((ADCFront >> ch) & 0x01) ^ 0x01] = ADC;
+  ADCFront ^= _BV(ch);
+
+  // Select the next channel that is due and start its conversion
+  //
+  for(;;) {
+    if(++iADCCurr >= N_ADC_IND) {
+      iADCCurr = 0;
+    }
+    if(ADCSkip[iADCCurr] == 0) {
+      ADCSkip[iADCCurr] = ADCDecimation[iADCCurr] -1;
+      break;
+    }
+    ADCSkip[iADCCurr]--;
+  }
+  ADMUX   = _BV(REFS0) | (iADCData[iADCCurr] -A0);
+  ADCSRA |= _BV(ADSC);
+}
+
+static inline uint16_t ADC_get(uint8_t ch)
+{
+  return ADCData[ch][(ADCFront >> ch) & 0x01];
+}
+#endif
+
 static uint16_t ADC_read(uint8_t pin)
 {
   #ifdef USES_FAST_ADC
@@ -118,6 +229,149 @@ static uint16_t ADC_read(uint8_t pin)
   #endif 
  }
 
+// -----------------------------------------------------------------------------
+// Model tick
+// -----------------------------------------------------------------------------
+#ifdef USES_MODEL_TICK
+  volatile uint32_t TickCount = 0;
+
+  ISR(TIMER1_OVF_vect)
+  {
+    TickCount++;
+  }
+
+  // Fast PWM with TOP=ICR1 (mode 14); the overflow interrupt marks the tick
+  // and OC1A (pin 9, the LED) is used as PWM output with ICR1+1 steps. The
+  // prescaler is the smallest that fits the period into 16 bits: 8 (0.5 us
+  // per count, up to 32768 us), 64 (4 us), 256 (16 us) or 1024 (64 us, up to
+  // 4194304 us). Returns the period that was set, rounded to whole counts
+  //
+  uint32_t ModelTick_init(uint32_t period_us)
+  {
+    uint8_t  cs;
+    uint8_t  shift;                 // us per count = 2^shift (0.5 us: 0)
+    uint32_t counts;
+
+    if(period_us <= 32768UL)        {cs = _BV(CS11);             shift = 0;}
+    else if(period_us <= 262144UL)  {cs = _BV(CS11) | _BV(CS10); shift = 2;}
+    else if(period_us <= 1048576UL) {cs = _BV(CS12);             shift = 4;}
+    else                            {cs = _BV(CS12) | _BV(CS10); shift = 6;}
+    counts = (shift == 0) ? period_us *2 : (period_us +(1UL << (shift -1))) >> shift;
+    if(counts < 2) counts = 2;
+    if(counts > 65536UL) counts = 65536UL;
+
+    noInterrupts();
+    TCCR1A = _BV(COM1A1) | _BV(WGM11);
+    TCCR1B = _BV(WGM13) | _BV(WGM12) | cs;
+    ICR1   = (uint16_t)(counts -1);
+    OCR1A  = 0;
+    TCNT1  = 0;
+    TIMSK1 = _BV(TOIE1);
+    interrupts();
+    return (shift == 0) ? counts /2 : counts << shift;
+  }
+
+  uint32_t ModelTick_count()
+  {
+    uint32_t n;
+    noInterrupts();
+    n = TickCount;
+    interrupts();
+    return n;
+  }
+
+  // analogWrite() for timer 1 pins would assume a TOP of 255
+  //
+  void analogWriteTick(uint8_t pin, int val)
+  {
+    if (pin == LEDOutPin) {
+      val = constrain(val, 0, 255);
+      OCR1A = (uint16_t)(((uint32_t)val *ICR1) /255);
+    }
+    else {
+      analogWrite(pin, val);
+    }
+  }
+#endif
+
+// -----------------------------------------------------------------------------
+// Edge capture on the synapse inputs
+// -----------------------------------------------------------------------------
+#ifdef USES_SYNAPSE_EDGES
+  // Pins 4 and 5 are PD4 and PD5, i.e. PCINT20 and PCINT21 of port D
+  //
+  volatile uint8_t       SynEdgeCount[2];  // rising edges since last taken
+  volatile unsigned long SynEdgeMicros[2]; // time of the latest rising edge
+  volatile uint8_t       SynEdgePrev;      // PIND at the last interrupt
+
+  ISR(PCINT2_vect)
+  {
+    uint8_t now  = PIND;
+    uint8_t rise = now & ~SynEdgePrev;
+    SynEdgePrev  = now;
+
+    if((rise & _BV(PD4)) && (SynEdgeCount[0] < 255)) {
+      SynEdgeCount[0]++;
+      SynEdgeMicros[0] = micros();
+    }
+    if((rise & _BV(PD5)) && (SynEdgeCount[1] < 255)) {
+      SynEdgeCount[1]++;
+      SynEdgeMicros[1] = micros();
+    }
+  }
+
+  void SynEdges_init()
+  {
+    noInterrupts();
+    SynEdgePrev = PIND;
+    PCMSK2 |= _BV(PCINT20) | _BV(PCINT21);
+    PCIFR   = _BV(PCIF2);
+    PCICR  |= _BV(PCIE2);
+    interrupts();
+  }
+
+  // Number of rising edges on synapse input i (0, 1) since the last call, and
+  // the time of the latest one
+  //
+  uint8_t SynEdges_take(uint8_t i, unsigned long* t)
+  {
+    uint8_t n;
+    noInterrupts();
+    n = SynEdgeCount[i];
+    SynEdgeCount[i] = 0;
+    *t = SynEdgeMicros[i];
+    interrupts();
+    return n;
+  }
+#endif
+
+// -----------------------------------------------------------------------------
+// Clock for stage profiling
+// -----------------------------------------------------------------------------
+#ifdef USES_STAGE_PROFILING
+  #ifdef USES_MODEL_TICK
+    #error USES_STAGE_PROFILING and USES_MODEL_TICK both need timer 1
+  #endif
+  // Timer 1 running freely in normal mode with prescaler 8, i.e. one count
+  // every 8 cycles; a stage must not take longer than 32 ms
+  //
+  #define PROFILE_CLOCK_MASK   0xFFFFUL
+  #define PROFILE_CLOCK_SCALE  8
+  #define PROFILE_CLOCK_UNIT   "cycles"
+
+  void ProfileClock_init()
+  {
+    TCCR1A = 0;
+    TCCR1B = _BV(CS11);
+    TIMSK1 = 0;
+  }
+
+  static inline uint32_t profileClock()
+  {
+    return TCNT1;
+  }
+#endif
+
 // -----------------------------------------------------------------------------
 // Helpers
 // -----------------------------------------------------------------------------
@@ -142,16 +396,29 @@ void initializeHardware()
   #endif  
 
   ADC_init();
+
+  #ifdef USES_SYNAPSE_EDGES
+    SynEdges_init();
+  #endif
+
+  #ifdef USES_STAGE_PROFILING
+    ProfileClock_init();
+  #endif
 }
 
 // -----------------------------------------------------------------------------
-// Housekeeping routine, to be called once per loop
+// Housekeeping routine, to be called once per loop; `due` is a bit mask of
+// the inputs to be read in this step (see InputScheduler.h)
 // -----------------------------------------------------------------------------
-void housekeeping()
+void housekeeping(uint16_t due)
 {
-  // Read all ADC values and store them
+  #ifndef USES_ADC_ISR
+  // Read the ADC values that are due and store them
   //
   for(uint8_t i=0; i<N_ADC_IND; i++) {
+    if(!(due & IN_BIT(iADCSource[i]))) {
+      continue;
+    }
     /*
     #ifdef USES_FAST_ADC
       ADMUX  &= ~(_BV(MUX3) | _BV(MUX2) | _BV(MUX1) | _BV(MUX0));
@@ -164,6 +431,7 @@ void housekeeping()
     */  
     ADCData[iADCData[i] -A0] = ADC_read(iADCData[i] -A0);     
   }
+  #endif
 }
 
 // -----------------------------------------------------------------------------
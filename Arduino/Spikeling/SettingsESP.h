@@ -12,7 +12,6 @@
 //    see https://learn.adafruit.com/adafruit-2-4-tft-touch-screen-featherwing
 //
 // Libraries (to be installed via Arduino IDE/Library manager:
-// - "Mcp3208" by Patrick Rogalla, v1.0.2
 // - "Adafruit_STMPE610" by Adafruit, v1.0.1
 // - "Mini Grafx" by Daniel Eichhorn, v1.0.0
 //   (contains a driver for the ILI9341 TFT spi display)
@@ -23,16 +22,46 @@
 //#define USES_FAST_ADC
 //#define USES_PLOTTING
 //#define USES_FULL_REDRAW
+//#define USES_PARTIAL_COMMIT // Sends only the changed part of the screen to the
+                            // display instead of the whole frame buffer
+                            // (ESP32 only; see "Partial display updates")
+//#define USES_ROLL_MODE    // Scrolls the traces like a chart recorder, using
+                            // the scroll function of the ILI9341 (ESP32 only;
+                            // see "Roll mode")
 #define   USES_HOUSEKEEPING
 #define   USES_DAC
+//#define USES_MODEL_TICK   // Runs the model at a fixed rate (TickRateHz),
+                            // driven by a hardware timer (ESP32 only)
+//#define USES_DUAL_CORE    // Runs the model in a task on core 1 and serial
+                            // output, display and touch on core 0 (ESP32
+                            // only, requires USES_MODEL_TICK); not yet timed
+                            // on a board: check with RateReport that the
+                            // model rate stays flat while the display updates
+//#define USES_STAGE_PROFILING // Measures the cycles spent in each stage of
+                            // loop() (see Profiling.h)
+//#define USES_SYNAPSE_EDGES // Counts the pulses on the synapse inputs via
+                            // the MCP23S08 interrupt (ESP32 only), with their
+                            // time in the events of SerialMode = 2
+//#define USES_NETWORK      // Simulates a network of NetNeurons neurons
+                            // (see Network.h and the NetXxx parameters)
+#define   NET_MAX_NEURONS 32
+//#define USES_STA          // Computes the spike-triggered average of the noise
+                            // stimulus on the board (see StaKernel.h and
+                            // SerialMode = 4)
+#define   STA_POINTS      200
 
 #include "Definitions.h"
+#include "Envelope.h"
 #include <SPI.h>
 #include "MiniGrafx.h"
 #include "ILI9341_SPI.h"
 #include <Adafruit_STMPE610.h>
-#include <Mcp3208.h>
 #include <Mcp23s08.h>
+#ifdef ESP32
+  #include <soc/soc.h>
+  #include <soc/gpio_reg.h>
+  #include <driver/spi_master.h>
+#endif
 
 // -----------------------------------------------------------------------------
 #define   MCP3208_FIRST  100
@@ -109,6 +138,8 @@
   // (2) analogReadNew() uses the 8-channel ADC MCP3208; therefore instead of
   //     pins, the mapping to the ADC channels on the chip are defined above,
   //     It's a 12 bit ADC, therefore the results need to be divided by 4.
+  //     The channels are read by the scan engine in housekeeping() (see
+  //     "A/D scan engine" below).
   //     The MCP3208 is connected to the second SPI bus of the ESP (HSPI), while
   //     the TFT display uses the primary SPI bus (VSPI). This is nescessary to
   //     be able to run the TFT at a particular frequency, at which the MCP3208
@@ -120,6 +151,9 @@
 // (115200=testing; 921600=standard; 1843200=a bit faster but less stable)
 //
 #define SerOutBAUD  921600
+#define SerOutQueueSize 2048 // bytes queued for background sending (power of 2)
+#define OutputRingSize  512  // output records passed to the I/O core (power of 2,
+                             // USES_DUAL_CORE)
 
 // -----------------------------------------------------------------------------
 // Pin definitions (hardware add-ons)
@@ -142,9 +176,10 @@
   #define ADC_CS    13       // secondary SPI bus (HSPI), client #1
   #define DIO_CS    4        // secondary SPI bus (HSPI), client #2
   #define DIO_ADDR  0x20     // address of MCP23S08 (defined by A0,A1 pins)
-  #define DIO_INT   36       // interrupt pin of MCP23S08 (not yet used)
+  #define DIO_INT   36       // interrupt pin of MCP23S08 (USES_SYNAPSE_EDGES)
   #define ADC_VREF  5000     // Vref for A/D
   #define ADC_CLK   1600000  // secondary SPI bus (HSPI), clock
+  #define TFT_CLK   40000000 // primary SPI bus (VSPI), clock for partial updates
 //#define ADC_CLK   4000000  // secondary SPI bus (HSPI), clock
 
 #endif
@@ -186,8 +221,6 @@ MiniGrafx         gfx     = MiniGrafx(&tft, BITS_PER_PIXEL, palette);
 Adafruit_STMPE610 ts      = Adafruit_STMPE610(TOUCH_CS);
 #ifdef ESP32
   SPIClass        *hspi   = new SPIClass(HSPI);
-  MCP3208         adc(ADC_VREF, ADC_CS, hspi);
-  uint16_t        ADCData[8][2];
   MCP23S08        dio(DIO_CS, DIO_ADDR, 0, hspi);
   uint8_t         DIOData;
 #endif
@@ -198,23 +231,676 @@ Adafruit_STMPE610 ts      = Adafruit_STMPE610(TOUCH_CS);
 #define MAX_TRACES   3   // Maximal number of traces shown in parallel
 #define MAX_VALUES   320 // Maximal trace length
 #define PLOT_UPDATE  16  // Redraw screen every # values
+#define PLOT_DECIMATION 1 // Samples per plot column; each column shows the
+                         // range (min to max) of its samples (see Envelope.h),
+                         // so larger values stretch the time base without
+                         // losing spikes
 
 const char* OutputInfoStr[] = {"V_m[mV]", "I_t[pA]", "I_PD[pA]", "I_AI[pA]",
                                "I_Sy[pA]", "StmSt", "SpIn1", "SpIn2",
                                "t[us]"};
 
 int    TraceCols[MAX_TRACES] = {13,11,15};
-int    Traces[MAX_TRACES][MAX_VALUES];
+envelope_t TraceEnv[MAX_TRACES];
 int    TracesStrIndex[MAX_TRACES];
 int    TraceSet;
 float  TracesMinMax[MAX_TRACES][2];
 int    iPnt, dyPlot, dxInfo;
 char   timeStr[16];
+bool   PlotHold = false;       // display frozen (toggled by touching the screen)
+unsigned long TouchMillis = 0;
+bool   lastTouched = false;
 bool   stateHousekeepingLED;
+uint8_t HousekeepCount = 0;
+#define HOUSEKEEP_LED_DIV 32
 
 // -----------------------------------------------------------------------------
 // Other hardware-related definitions
 // -----------------------------------------------------------------------------
+#ifdef USES_MODEL_TICK
+  #ifndef ESP32
+    #error USES_MODEL_TICK requires an ESP32
+  #endif
+  hw_timer_t*       TickTimer = NULL;
+  volatile uint32_t TickCount = 0;
+#endif
+#ifdef USES_DUAL_CORE
+  #ifndef ESP32
+    #error USES_DUAL_CORE requires an ESP32
+  #endif
+  #ifndef USES_MODEL_TICK
+    #error USES_DUAL_CORE requires USES_MODEL_TICK
+  #endif
+  TaskHandle_t      ModelTaskH = NULL;
+  TaskHandle_t      IOTaskH    = NULL;
+  void              (*DualCoreModelStep)() = NULL;
+  bool              (*DualCoreIOStep)()    = NULL;
+#endif
+
+// -----------------------------------------------------------------------------
+// Model tick
+// -----------------------------------------------------------------------------
+#ifdef USES_MODEL_TICK
+  void IRAM_ATTR onModelTick()
+  {
+    TickCount++;
+    #ifdef USES_DUAL_CORE
+    // Wake up the model task
+    //
+    BaseType_t woken = pdFALSE;
+    if(ModelTaskH != NULL) {
+      vTaskNotifyGiveFromISR(ModelTaskH, &woken);
+    }
+    if(woken) {
+      portYIELD_FROM_ISR();
+    }
+    #endif
+  }
+
+  // Timer 0 with prescaler 80, i.e. counting microseconds (80 MHz APB clock);
+  // returns the period that was set
+  //
+  uint32_t ModelTick_init(uint32_t period_us)
+  {
+    TickTimer = timerBegin(0, 80, true);
+    timerAttachInterrupt(TickTimer, &onModelTick, true);
+    timerAlarmWrite(TickTimer, period_us, true);
+    timerAlarmEnable(TickTimer);
+    return period_us;
+  }
+
+  uint32_t ModelTick_count()
+  {
+    // 32-bit reads are atomic on the ESP32
+    //
+    return TickCount;
+  }
+#endif
+
+// -----------------------------------------------------------------------------
+// Dual-core operation
+// -----------------------------------------------------------------------------
+#ifdef USES_DUAL_CORE
+  // The model task runs on core 1 and does one model step per tick; it never
+  // waits for serial output or the display. The model step passes its output
+  // records and messages through lock-free rings (see RingBuffer.h) to the
+  // I/O task on core 0, which sends them, plots them and polls the touch
+  // screen. The I/O task runs at idle priority, so that the idle task on
+  // core 0 (and with it the task watchdog) still gets its share; records that
+  // do not fit into the ring while the I/O core is busy are dropped and
+  // counted, the model rate is not affected.
+  //
+  void ModelTask(void* param)
+  {
+    for(;;) {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      DualCoreModelStep();
+    }
+  }
+
+  void IOTask(void* param)
+  {
+    for(;;) {
+      if(!DualCoreIOStep()) {
+        vTaskDelay(1);
+      }
+    }
+  }
+
+  // `modelStep` is called once per model tick, `ioStep` as often as
+  // possible; it returns false if there was nothing to do
+  //
+  void DualCore_start(void (*modelStep)(), bool (*ioStep)())
+  {
+    DualCoreModelStep = modelStep;
+    DualCoreIOStep    = ioStep;
+    xTaskCreatePinnedToCore(IOTask, "IO", 8192, NULL, tskIDLE_PRIORITY, &IOTaskH, 0);
+    xTaskCreatePinnedToCore(ModelTask, "Model", 8192, NULL,
+                            configMAX_PRIORITIES -2, &ModelTaskH, 1);
+  }
+#endif
+
+// -----------------------------------------------------------------------------
+// Edge capture on the synapse inputs
+// -----------------------------------------------------------------------------
+#ifdef USES_SYNAPSE_EDGES
+  #ifndef ESP32
+    #error USES_SYNAPSE_EDGES requires an ESP32
+  #endif
+  // The MCP23S08 pulls DIO_INT low when a synapse input changes and keeps
+  // the pin states of that moment in INTCAP until INTCAP is read. Reading
+  // needs the HSPI bus, which is not possible in the interrupt routine;
+  // instead, the interrupt wakes up a high-priority task that reads INTF and
+  // INTCAP in one frame (which also re-arms the interrupt) and counts the
+  // inputs that changed to HIGH. Pulses need to be longer than the time
+  // this takes (some 10 us). housekeeping() holds HSPIMutex during its
+  // accesses to the bus and, as reading GPIO also re-arms the interrupt,
+  // evaluates INTF and INTCAP as well.
+  //
+  #define SYN_EDGE_MASK  ((1 << (DigitalIn1Pin -MCP23S08_FIRST)) | \
+                          (1 << (DigitalIn2Pin -MCP23S08_FIRST)))
+
+  SemaphoreHandle_t      HSPIMutex     = NULL;
+  TaskHandle_t           SynEdgeTaskH  = NULL;
+  portMUX_TYPE           SynEdgeMux    = portMUX_INITIALIZER_UNLOCKED;
+  volatile unsigned long SynEdgeIntMicros = 0;
+  uint8_t                SynEdgeCount[2];
+  unsigned long          SynEdgeMicros[2];
+
+  void IRAM_ATTR onDIOInt()
+  {
+    BaseType_t woken = pdFALSE;
+    SynEdgeIntMicros = micros();
+    vTaskNotifyGiveFromISR(SynEdgeTaskH, &woken);
+    if(woken) {
+      portYIELD_FROM_ISR();
+    }
+  }
+
+  // Count the inputs that caused the interrupt (INTF) and were HIGH at that
+  // moment (INTCAP)
+  //
+  void SynEdges_capture(const uint8_t* reg)
+  {
+    uint8_t rise = reg[0] & reg[1] & SYN_EDGE_MASK;
+
+    if(rise == 0) {
+      return;
+    }
+    portENTER_CRITICAL(&SynEdgeMux);
+    if((rise & (1 << (DigitalIn1Pin -MCP23S08_FIRST))) && (SynEdgeCount[0] < 255)) {
+      SynEdgeCount[0]++;
+      SynEdgeMicros[0] = SynEdgeIntMicros;
+    }
+    if((rise & (1 << (DigitalIn2Pin -MCP23S08_FIRST))) && (SynEdgeCount[1] < 255)) {
+      SynEdgeCount[1]++;
+      SynEdgeMicros[1] = SynEdgeIntMicros;
+    }
+    portEXIT_CRITICAL(&SynEdgeMux);
+  }
+
+  void SynEdgeTask(void* param)
+  {
+    uint8_t reg[2]; // INTF, INTCAP
+
+    for(;;) {
+      // Also look every 10 ms, in case an interrupt edge was missed
+      //
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(10));
+      if(digitalRead(DIO_INT) == HIGH) {
+        continue;
+      }
+      xSemaphoreTake(HSPIMutex, portMAX_DELAY);
+      dio.readRegisters(dio.INTF, reg, 2);
+      xSemaphoreGive(HSPIMutex);
+      SynEdges_capture(reg);
+    }
+  }
+
+  void SynEdges_init()
+  {
+    // Interrupt on any change of the synapse inputs (INTCON = 0), INT pin
+    // active low, push-pull (IOCON as set by dio.begin())
+    //
+    HSPIMutex = xSemaphoreCreateMutex();
+    dio.gpioRegisterWriteByte(dio.INTCON, 0x00);
+    dio.gpioRegisterWriteByte(dio.GPINTEN, SYN_EDGE_MASK);
+    dio.gpioRegisterReadByte(dio.INTCAP);
+    xTaskCreatePinnedToCore(SynEdgeTask, "SynEdge", 2048, NULL,
+                            configMAX_PRIORITIES -1, &SynEdgeTaskH, 0);
+    pinMode(DIO_INT, INPUT);
+    attachInterrupt(digitalPinToInterrupt(DIO_INT), onDIOInt, FALLING);
+  }
+
+  // Number of rising edges on synapse input i (0, 1) since the last call, and
+  // the time of the latest one
+  //
+  uint8_t SynEdges_take(uint8_t i, unsigned long* t)
+  {
+    uint8_t n;
+    portENTER_CRITICAL(&SynEdgeMux);
+    n = SynEdgeCount[i];
+    SynEdgeCount[i] = 0;
+    *t = SynEdgeMicros[i];
+    portEXIT_CRITICAL(&SynEdgeMux);
+    return n;
+  }
+
+  #define HSPI_LOCK()    xSemaphoreTake(HSPIMutex, portMAX_DELAY)
+  #define HSPI_UNLOCK()  xSemaphoreGive(HSPIMutex)
+#else
+  #define HSPI_LOCK()
+  #define HSPI_UNLOCK()
+#endif
+
+// -----------------------------------------------------------------------------
+// A/D scan engine (MCP3208)
+// -----------------------------------------------------------------------------
+#ifdef ESP32
+  // All channels that are due in a step (according to the divisor of the
+  // input they belong to, see InputDivisor) are converted in one pass inside
+  // the SPI transaction of housekeeping(): each conversion is one 3-byte
+  // frame (start bit, single-ended, channel; the 12-bit result comes back in
+  // the last 12 bits), with ADC_CS toggled directly via the GPIO registers,
+  // as the MCP3208 starts a conversion on the falling edge of CS.
+  // The frames are queued at once as ESP-IDF spi_master transactions on the
+  // HSPI bus and the results collected afterwards, instead of one blocking
+  // transfer per channel. The driver calls ADC_select()/ADC_deselect()
+  // around each transaction; the hardware CS is not used, as the MCP23S08 on
+  // the same bus is driven through the Arduino SPI class (both under
+  // HSPI_LOCK, see housekeeping()).
+  // Each channel then goes through its own filter stage:
+  //   ADC_FILT_NONE    raw value
+  //   ADC_FILT_HOLD    values at the rails (< ADC_RAIL_LO, > ADC_RAIL_HI) are
+  //                    taken as glitches and the last value is kept
+  //   ADC_FILT_MEDIAN  median of the last three conversions; removes single
+  //                    glitches, but a step change shows one conversion later
+  //
+  #define ADC_N_CH         8
+  #define ADC_NO_INPUT     0xFF
+  #define ADC_FILT_NONE    0
+  #define ADC_FILT_HOLD    1
+  #define ADC_FILT_MEDIAN  2
+  #define ADC_RAIL_LO      30
+  #define ADC_RAIL_HI      4066
+
+  // Input (IN_xxx) that each channel belongs to, and its filter
+  //
+  const uint8_t ADCChInput[ADC_N_CH]  = {IN_VM_POT, IN_NOISE_POT, IN_PHOTODIODE,
+                                         IN_SYN1_POT, IN_SYN2_POT, IN_ANALOG_IN,
+                                         ADC_NO_INPUT, ADC_NO_INPUT};
+  const uint8_t ADCChFilter[ADC_N_CH] = {ADC_FILT_MEDIAN, ADC_FILT_MEDIAN, ADC_FILT_HOLD,
+                                         ADC_FILT_MEDIAN, ADC_FILT_MEDIAN, ADC_FILT_NONE,
+                                         ADC_FILT_NONE, ADC_FILT_NONE};
+
+  uint16_t ADCHist[ADC_N_CH][3];    // last three conversions
+  uint8_t  ADCiHist[ADC_N_CH];
+  uint16_t ADCData[ADC_N_CH];       // filtered value, 0..4095
+
+  static inline uint16_t median3(uint16_t a, uint16_t b, uint16_t c)
+  {
+    if(a > b) { uint16_t t = a; a = b; b = t; }
+    if(b > c) { b = c; }
+    return (a > b) ? a : b;
+  }
+
+  void ADC_filter(uint8_t ch, uint16_t v)
+  {
+    uint16_t* h = ADCHist[ch];
+
+    ADCiHist[ch] = (ADCiHist[ch] >= 2) ? 0 : ADCiHist[ch] +1;
+    h[ADCiHist[ch]] = v;
+    switch(ADCChFilter[ch]) {
+      case ADC_FILT_HOLD:
+        if((v >= ADC_RAIL_LO) && (v <= ADC_RAIL_HI)) {
+          ADCData[ch] = v;
+        }
+        break;
+      case ADC_FILT_MEDIAN:
+        ADCData[ch] = median3(h[0], h[1], h[2]);
+        break;
+      default:
+        ADCData[ch] = v;
+    }
+  }
+
+  spi_device_handle_t ADCDev = NULL;
+  spi_transaction_t   ADCTrans[ADC_N_CH];
+
+  void IRAM_ATTR ADC_select(spi_transaction_t*)
+  {
+    REG_WRITE(GPIO_OUT_W1TC_REG, 1UL << ADC_CS);
+  }
+
+  void IRAM_ATTR ADC_deselect(spi_transaction_t*)
+  {
+    REG_WRITE(GPIO_OUT_W1TS_REG, 1UL << ADC_CS);
+  }
+
+  // Convert the channels in `chMask` (bit i = channel i) and pass the
+  // results through the filters; the caller holds HSPI_LOCK()
+  //
+  void ADC_scan(uint8_t chMask)
+  {
+    spi_transaction_t* t;
+    uint8_t            n = 0;
+
+    for(uint8_t ch=0; ch<ADC_N_CH; ch++) {
+      if(!(chMask & (1 << ch))) {
+        continue;
+      }
+      t = &ADCTrans[ch];
+      memset(t, 0, sizeof(*t));
+      t->flags      = SPI_TRANS_USE_TXDATA | SPI_TRANS_USE_RXDATA;
+      t->length     = 24;
+      t->user       = (void*)(uintptr_t)ch;
+      t->tx_data[0] = 0b00000110 | (ch >> 2);
+      t->tx_data[1] = (ch & 0x03) << 6;
+      spi_device_queue_trans(ADCDev, t, portMAX_DELAY);
+      n++;
+    }
+    for(; n>0; n--) {
+      spi_device_get_trans_result(ADCDev, &t, portMAX_DELAY);
+      ADC_filter((uint8_t)(uintptr_t)t->user, ((t->rx_data[1] & 0x0F) << 8) | t->rx_data[2]);
+    }
+  }
+
+  // ADC device on the HSPI bus (after hspi->begin(), with the same pins and
+  // clock; ADC_CS is driven by ADC_select()/ADC_deselect())
+  //
+  void ADC_open()
+  {
+    spi_bus_config_t              bus;
+    spi_device_interface_config_t dev;
+
+    memset(&bus, 0, sizeof(bus));
+    bus.mosi_io_num   = ADC_MOSI;
+    bus.miso_io_num   = ADC_MISO;
+    bus.sclk_io_num   = ADC_SCK;
+    bus.quadwp_io_num = -1;
+    bus.quadhd_io_num = -1;
+    memset(&dev, 0, sizeof(dev));
+    dev.clock_speed_hz = ADC_CLK;
+    dev.mode           = 0;
+    dev.spics_io_num   = -1;
+    dev.queue_size     = ADC_N_CH;
+    dev.pre_cb         = ADC_select;
+    dev.post_cb        = ADC_deselect;
+    spi_bus_initialize(HSPI_HOST, &bus, SPI_DMA_DISABLED);
+    spi_bus_add_device(HSPI_HOST, &dev, &ADCDev);
+  }
+
+  // Channels that belong to the inputs in `due` (see InputScheduler.h)
+  //
+  uint8_t ADC_dueChannels(uint16_t due)
+  {
+    uint8_t mask = 0;
+
+    for(uint8_t ch=0; ch<ADC_N_CH; ch++) {
+      if((ADCChInput[ch] != ADC_NO_INPUT) && (due & IN_BIT(ADCChInput[ch]))) {
+        mask |= 1 << ch;
+      }
+    }
+    return mask;
+  }
+
+  // Fill the filter histories with a first conversion of each used channel
+  //
+  void ADC_init()
+  {
+    uint8_t used = ADC_dueChannels(IN_ALL);
+
+    ADC_open();
+    memset(ADCHist, 0, sizeof(ADCHist));
+    memset(ADCiHist, 0, sizeof(ADCiHist));
+    memset(ADCData, 0, sizeof(ADCData));
+    for(uint8_t i=0; i<3; i++) {
+      ADC_scan(used);
+    }
+  }
+#endif
+
+// -----------------------------------------------------------------------------
+// Clock for stage profiling
+// -----------------------------------------------------------------------------
+#ifdef USES_STAGE_PROFILING
+  // CPU cycle counter (240 MHz)
+  //
+  #define PROFILE_CLOCK_MASK   0xFFFFFFFFUL
+  #define PROFILE_CLOCK_SCALE  1
+  #define PROFILE_CLOCK_UNIT   "cycles"
+
+  static inline uint32_t profileClock()
+  {
+    return ESP.getCycleCount();
+  }
+#endif
+
+// -----------------------------------------------------------------------------
+// Direct access to the ILI9341 (partial updates and roll mode)
+// -----------------------------------------------------------------------------
+#if defined(USES_PARTIAL_COMMIT) || defined(USES_ROLL_MODE)
+  #ifndef ESP32
+    #error USES_PARTIAL_COMMIT and USES_ROLL_MODE require an ESP32
+  #endif
+  #define ILI9341_CASET     0x2A
+  #define ILI9341_PASET     0x2B
+  #define ILI9341_RAMWR     0x2C
+  #define ILI9341_VSCRDEF   0x33
+  #define ILI9341_VSCRSADD  0x37
+
+  typedef struct {
+    int16_t x0, y0, x1, y1;    // inclusive; empty if x0 > x1
+    } dirtyrect_t;
+
+  uint8_t TFTLine[2*SCREEN_WIDTH];
+
+  // Queued (DMA) transfers of TFT_pushRect(): two line buffers that are
+  // filled and sent in turn
+  //
+  spi_device_handle_t TFTDev = NULL;
+  WORD_ALIGNED_ATTR uint8_t TFTRows[2][2*SCREEN_WIDTH];
+  spi_transaction_t   TFTTrans[2];
+
+  void TFT_command(uint8_t cmd)
+  {
+    digitalWrite(TFT_DC, LOW);
+    SPI.write(cmd);
+    digitalWrite(TFT_DC, HIGH);
+  }
+
+  void TFT_begin()
+  {
+    SPI.beginTransaction(SPISettings(TFT_CLK, MSBFIRST, SPI_MODE0));
+    digitalWrite(TFT_CS, LOW);
+  }
+
+  void TFT_end()
+  {
+    digitalWrite(TFT_CS, HIGH);
+    SPI.endTransaction();
+  }
+
+  // Set the window for the following pixels (in the coordinates of the
+  // current rotation) and start the memory write
+  //
+  void TFT_window(int x0, int y0, int x1, int y1)
+  {
+    TFT_command(ILI9341_CASET);
+    SPI.write16(x0);
+    SPI.write16(x1);
+    TFT_command(ILI9341_PASET);
+    SPI.write16(y0);
+    SPI.write16(y1);
+    TFT_command(ILI9341_RAMWR);
+  }
+
+  // TFT device on the VSPI bus for the pixel data (after gfx.init(), which
+  // starts the bus with the Arduino SPI class; its pins are left as they
+  // are). Commands, CS and DC stay with TFT_begin()/TFT_window(), so that
+  // MiniGrafx and the touch controller can keep using the Arduino SPI class
+  //
+  void TFT_open()
+  {
+    spi_bus_config_t              bus;
+    spi_device_interface_config_t dev;
+
+    memset(&bus, 0, sizeof(bus));
+    bus.mosi_io_num     = -1;
+    bus.miso_io_num     = -1;
+    bus.sclk_io_num     = -1;
+    bus.quadwp_io_num   = -1;
+    bus.quadhd_io_num   = -1;
+    bus.max_transfer_sz = sizeof(TFTRows[0]);
+    memset(&dev, 0, sizeof(dev));
+    dev.clock_speed_hz = TFT_CLK;
+    dev.mode           = 0;
+    dev.spics_io_num   = -1;
+    dev.queue_size     = 2;
+    spi_bus_initialize(VSPI_HOST, &bus, SPI_DMA_CH_AUTO);
+    spi_bus_add_device(VSPI_HOST, &dev, &TFTDev);
+  }
+
+  // Copy a rectangle of the MiniGrafx frame buffer to the display. The rows
+  // are converted into the two line buffers in turn (as many rows as fit
+  // into one, so that narrow spans need few transactions) and queued; a
+  // buffer is filled again once its previous transfer is done, so the
+  // conversion overlaps with the transfer. Returns when all is sent
+  //
+  void TFT_pushRect(const dirtyrect_t* r)
+  {
+    int                w = r->x1 -r->x0 +1;
+    int                rows = SCREEN_WIDTH /max(w, 1);
+    int                pending = 0, b = 0;
+    spi_transaction_t* t;
+
+    if(w <= 0) {
+      return;
+    }
+    TFT_begin();
+    TFT_window(r->x0, r->y0, r->x1, r->y1);
+    for(int y=r->y0; y<=r->y1; y+=rows, b^=1) {
+      int      n = min(rows, r->y1 -y +1);
+      uint8_t* p = TFTRows[b];
+
+      if(pending == 2) {
+        spi_device_get_trans_result(TFTDev, &t, portMAX_DELAY);
+        pending--;
+      }
+      for(int j=0; j<n; j++) {
+        for(int i=0; i<w; i++) {
+          uint16_t c = palette[gfx.getPixel(r->x0 +i, y +j)];
+          *p++ = c >> 8;
+          *p++ = c & 0xFF;
+        }
+      }
+      memset(&TFTTrans[b], 0, sizeof(TFTTrans[b]));
+      TFTTrans[b].length    = 16*n*w;
+      TFTTrans[b].tx_buffer = TFTRows[b];
+      spi_device_queue_trans(TFTDev, &TFTTrans[b], portMAX_DELAY);
+      pending++;
+    }
+    for(; pending>0; pending--) {
+      spi_device_get_trans_result(TFTDev, &t, portMAX_DELAY);
+    }
+    TFT_end();
+  }
+#endif
+
+// -----------------------------------------------------------------------------
+// Partial display updates
+// -----------------------------------------------------------------------------
+#ifdef USES_PARTIAL_COMMIT
+  // Instead of gfx.commit(), which sends the whole frame buffer (320x240
+  // pixels, 150 kB at 16 bits per pixel), plot() only sends what it changed
+  // since the last commit: the span of plot columns and, if the time string
+  // was redrawn, its part of the info panel. The pixels are taken from the
+  // MiniGrafx frame buffer and written into a window of the ILI9341 (column
+  // and page address set, then memory write).
+  // The rows are sent as queued ESP-IDF spi_master (DMA) transactions from
+  // two line buffers (see TFT_pushRect()): the gfx.getPixel() and palette
+  // lookup per pixel for one buffer overlap with the transfer of the other
+  // (16 bits per pixel, i.e. 0.4 us per pixel at TFT_CLK = 40 MHz). The push
+  // still returns only when the last row is sent; in single-core builds,
+  // plot() runs in loop() after the model step, so the model waits for it,
+  // while with USES_DUAL_CORE, where plot() runs on the I/O core, it overlaps
+  // with the next model steps. The time plot() takes per sample is reported
+  // as stage "plot" with USES_STAGE_PROFILING; compare it with and without
+  // USES_PARTIAL_COMMIT.
+  // When the plot wraps around, the columns before the wrap are kept in
+  // DirtyWrap, so that the two spans are pushed on their own instead of as
+  // one rectangle across the full width.
+  //
+  dirtyrect_t DirtyPlot, DirtyWrap, DirtyInfo;
+
+  void dirtyClear(dirtyrect_t* r)
+  {
+    r->x0 = SCREEN_WIDTH;
+    r->y0 = SCREEN_HEIGHT;
+    r->x1 = -1;
+    r->y1 = -1;
+  }
+
+  void dirtyAdd(dirtyrect_t* r, int x0, int y0, int x1, int y1)
+  {
+    r->x0 = max(min((int)r->x0, x0), 0);
+    r->y0 = max(min((int)r->y0, y0), 0);
+    r->x1 = min(max((int)r->x1, x1), SCREEN_WIDTH -1);
+    r->y1 = min(max((int)r->y1, y1), SCREEN_HEIGHT -1);
+  }
+#endif
+
+// -----------------------------------------------------------------------------
+// Roll mode
+// -----------------------------------------------------------------------------
+#ifdef USES_ROLL_MODE
+  // The screen is used upright (240 pixels wide, 320 high), as the ILI9341
+  // can only scroll along its long side. The info panel is the fixed area at
+  // the top (INFO_DY rows), the rest is the scroll area, with one plot line
+  // per row: the values of the traces run from left to right, time from top
+  // to bottom. Each new line is written into the display memory row after
+  // the previous one, and the scroll start is set to the row after it, so
+  // that the new line appears at the bottom and all others move up by one.
+  // Per line, only these 240 pixels are sent; the frame buffer is not used
+  // for the traces.
+  //
+  #define ROLL_ORIENT  0                          // portrait, time downwards
+  #define ROLL_WIDTH   SCREEN_HEIGHT              // pixels per line
+  #define ROLL_ROWS    (SCREEN_WIDTH -INFO_DY)    // lines in the scroll area
+
+  int RollRow   = 0;             // display memory row of the next line
+  int RollCount = 0;
+
+  void Roll_init()
+  {
+    RollRow   = 0;
+    RollCount = 0;
+    TFT_begin();
+    TFT_command(ILI9341_VSCRDEF);
+    SPI.write16(INFO_DY);        // top fixed area
+    SPI.write16(ROLL_ROWS);      // scroll area
+    SPI.write16(0);              // bottom fixed area
+    TFT_command(ILI9341_VSCRSADD);
+    SPI.write16(INFO_DY);
+    TFT_end();
+  }
+
+  int getRollX(int iTr, float v)
+  {
+    // Convert the value into a position in the line
+    //
+    return constrain(map(round(v), TracesMinMax[iTr][0], TracesMinMax[iTr][1], 0, ROLL_WIDTH -1),
+                     0, ROLL_WIDTH -1);
+  }
+
+  // Write one line with the range (min to max) of each trace and scroll
+  //
+  void Roll_addLine(const envelope_t* env)
+  {
+    uint16_t c = palette[0];
+    int      x, x1;
+
+    for(x=0; x<ROLL_WIDTH; x++) {
+      TFTLine[2*x]    = c >> 8;
+      TFTLine[2*x +1] = c & 0xFF;
+    }
+    for(int iTr=0; iTr<MAX_TRACES; iTr++) {
+      c  = palette[TraceCols[iTr]];
+      x1 = getRollX(iTr, env[iTr].hi);
+      for(x=getRollX(iTr, env[iTr].lo); x<=x1; x++) {
+        TFTLine[2*x]    = c >> 8;
+        TFTLine[2*x +1] = c & 0xFF;
+      }
+    }
+    TFT_begin();
+    TFT_window(0, INFO_DY +RollRow, ROLL_WIDTH -1, INFO_DY +RollRow);
+    SPI.writeBytes(TFTLine, 2*ROLL_WIDTH);
+    RollRow = (RollRow +1) % ROLL_ROWS;
+    TFT_command(ILI9341_VSCRSADD);
+    SPI.write16(INFO_DY +RollRow);
+    TFT_end();
+  }
+#endif
 
 // -----------------------------------------------------------------------------
 // Helpers
@@ -267,16 +953,19 @@ void initializeHardware()
     SPISettings settingsHSPI(ADC_CLK, MSBFIRST, SPI_MODE0);
     hspi->begin(ADC_SCK, ADC_MISO, ADC_MOSI, ADC_CS);
     hspi->beginTransaction(settingsHSPI);
-    for(int i=0; i<8; i++) {
-      ADCData[0][0] = 0;
-      ADCData[0][1] = 0;
-    }
+    ADC_init();
     dio.begin();
     dio.gpioPinMode(ButtonPin -MCP23S08_FIRST, INPUT);
     dio.gpioPinMode(DigitalIn1Pin -MCP23S08_FIRST, INPUT);
     dio.gpioPinMode(DigitalIn2Pin -MCP23S08_FIRST, INPUT);
     dio.gpioPinMode(HousekeepLED -MCP23S08_FIRST, OUTPUT);
     DIOData = 0;
+    #ifdef USES_SYNAPSE_EDGES
+      SynEdges_init();
+    #endif
+    #ifdef USES_DUAL_CORE
+      ts.begin();
+    #endif
   #endif
 
   // Initialise a few variables
@@ -289,6 +978,7 @@ void initializeHardware()
   for(int i=0; i<MAX_TRACES; i++) {
     TracesMinMax[i][0] = 0;
     TracesMinMax[i][1] = 0;
+    envInit(&TraceEnv[i], PLOT_DECIMATION);
   }
   TraceSet = 0;
   setTraceSet();
@@ -297,11 +987,32 @@ void initializeHardware()
   // (landscape, USB port up)
   //
   gfx.init();
-  gfx.setRotation(SCREEN_ORIENT);
+  #if defined(USES_PARTIAL_COMMIT) || defined(USES_ROLL_MODE)
+    TFT_open();
+  #endif
   gfx.setFastRefresh(true);
   gfx.fillBuffer(0);
   gfx.setTextAlignment(TEXT_ALIGN_CENTER);
-  gfx.commit();
+  #ifdef USES_ROLL_MODE
+    // Upright, with the trace names in the fixed info panel at the top
+    //
+    gfx.setRotation(ROLL_ORIENT);
+    dxInfo = ROLL_WIDTH /(MAX_TRACES +1);
+    for(int i=0; i<MAX_TRACES; i++) {
+      gfx.setColor(TraceCols[i]);
+      gfx.drawString(dxInfo/2 +(i+1)*dxInfo, 0, OutputInfoStr[TracesStrIndex[i]]);
+    }
+    gfx.commit();
+    Roll_init();
+  #else
+    gfx.setRotation(SCREEN_ORIENT);
+    gfx.commit();
+  #endif
+  #ifdef USES_PARTIAL_COMMIT
+    dirtyClear(&DirtyPlot);
+    dirtyClear(&DirtyWrap);
+    dirtyClear(&DirtyInfo);
+  #endif
 }
 
 // -----------------------------------------------------------------------------
@@ -373,61 +1084,93 @@ int analogReadNew(int pin)
 
   if((pin >= MCP3208_FIRST) && (pin <= MCP3208_LAST)) {
     // Currently only input pins connected to A/D IC MCP3208 are handeled
+    // (without housekeeping, the channel is converted on request)
     //
-    switch (pin) {
-      case Syn1PotPin:
-        res = 300;
-        break;
-      case Syn2PotPin:
-        res = 128;
-        break;
-      case AnalogInPin:
-        res = 100;
-        break;
-
-      default:
-        #ifdef USES_HOUSEKEEPING
-        res = ADCData[pin -MCP3208_FIRST][1] >> 2;
-        #else
-        // *** TODO ***
-        #endif
-    }
+    #ifndef USES_HOUSEKEEPING
+    HSPI_LOCK();
+    ADC_scan(1 << (pin -MCP3208_FIRST));
+    HSPI_UNLOCK();
+    #endif
+    res = ADCData[pin -MCP3208_FIRST] >> 2;
   }
   return res;
 }
 
 // -----------------------------------------------------------------------------
-// Housekeeping routine, to be called once per loop
+// Housekeeping routine, to be called once per loop; `due` is a bit mask of
+// the inputs to be read in this step (see InputScheduler.h)
 // -----------------------------------------------------------------------------
-void housekeeping()
+void housekeeping(uint16_t due)
 {
-  uint16_t v;
-  uint8_t  iCh;
+  // One SPI transaction for all accesses to the HSPI bus in this cycle
+  //
+  HSPI_LOCK();
+  dio.beginExchange();
 
-  // Read A/D channels from MCP3208 and store data
+  // Convert the A/D channels of the inputs that are due and filter them
   //
-  for(iCh=0; iCh<3; iCh++) {
-    v  = adc.read(MCP3208::Channel(iCh | 0b1000));
-    if((v > 4066) || (v < 30)) {
-      ADCData[iCh][1] = ADCData[iCh][0];
-    }
-    else {
-      ADCData[iCh][0] = v;
-      ADCData[iCh][1] = v;
-    }
-   }
+  ADC_scan(ADC_dueChannels(due));
 
-   // Flash housekeeping LED, if defined
+   // Flash housekeeping LED, if defined (every HOUSEKEEP_LED_DIV cycles, so
+   // that the MCP23S08 outputs need not be written in every cycle)
    //
    #ifdef HousekeepLED
-   digitalWriteNew(HousekeepLED, stateHousekeepingLED);
-   stateHousekeepingLED = !stateHousekeepingLED;
+   if(++HousekeepCount >= HOUSEKEEP_LED_DIV) {
+     HousekeepCount = 0;
+     digitalWriteNew(HousekeepLED, stateHousekeepingLED);
+     stateHousekeepingLED = !stateHousekeepingLED;
+   }
    #endif
 
-   // Refresh MCP23S08 and retrieve data
+   // Retrieve data from MCP23S08 and refresh its outputs (only if changed)
    //
-   DIOData = dio.readGpioPort();
-   dio.gpioPortUpdate();
+   #ifdef USES_SYNAPSE_EDGES
+   uint8_t intRegs[2];
+   DIOData = dio.gpioPortExchange(intRegs);
+   SynEdges_capture(intRegs);
+   #else
+   DIOData = dio.gpioPortExchange();
+   #endif
+   dio.endExchange();
+   HSPI_UNLOCK();
+}
+
+// -----------------------------------------------------------------------------
+// Touch screen: a touch freezes the display, the next one continues
+// (polled every 50 ms; the STMPE610 shares the VSPI bus with the TFT)
+// -----------------------------------------------------------------------------
+void serviceTouch()
+{
+  bool touched;
+
+  if(millis() -TouchMillis < 50) {
+    return;
+  }
+  TouchMillis = millis();
+  touched = ts.touched();
+  while(!ts.bufferEmpty()) {
+    ts.getPoint();
+  }
+  if(touched && !lastTouched) {
+    PlotHold = !PlotHold;
+  }
+  lastTouched = touched;
+}
+
+// Send the changes to the display
+//
+void commitScreen()
+{
+  #ifdef USES_PARTIAL_COMMIT
+    TFT_pushRect(&DirtyWrap);
+    TFT_pushRect(&DirtyPlot);
+    TFT_pushRect(&DirtyInfo);
+    dirtyClear(&DirtyWrap);
+    dirtyClear(&DirtyPlot);
+    dirtyClear(&DirtyInfo);
+  #else
+    gfx.commit();
+  #endif
 }
 
 // -----------------------------------------------------------------------------
@@ -441,44 +1184,86 @@ int getYCoord(int iTr, float v)
 }
 
 
+// Redraw time and mode at height `y`
+// (first old string in black, then new string in white; this is much faster then
+//  clearing the info area with a filled rectangle)
+//
+void drawTimeStr(output_t* Output, int y)
+{
+  gfx.setColor(0);
+  gfx.drawString(dxInfo/2, y, timeStr);
+  sprintf(timeStr, "M%d %.1fs\n", Output->NeuronBehaviour, Output->currentMicros /1E6);
+  gfx.setColor(1);
+  gfx.drawString(dxInfo/2, y, timeStr);
+}
+
+
 void plot(output_t* Output)
 {
-  int y, iTr;
+  int   iTr;
+  bool  done = false;
+  float val[MAX_TRACES];
 
-  // Depending on selected trace set, add data to trace array
+  if(PlotHold) {
+    return;
+  }
+
+  // Depending on selected trace set, add data to the trace envelopes; a
+  // column is drawn every PLOT_DECIMATION samples
   //
   switch(TraceSet) {
     case 0:
     default:
-      Traces[0][iPnt] = getYCoord(0, Output->v);
-      Traces[1][iPnt] = getYCoord(1, Output->I_total);
-      Traces[2][iPnt] = getYCoord(2, Output->Stim_State);
+      val[0] = Output->v;
+      val[1] = Output->I_total;
+      val[2] = Output->Stim_State;
+  }
+  for(iTr=0; iTr<MAX_TRACES; iTr++) {
+    done = envAdd(&TraceEnv[iTr], val[iTr]);
+  }
+  if(!done) {
+    return;
   }
 
-  // Draw new piece of each trace
-  //
-  if(iPnt > 0) {
-    #ifndef USES_FULL_REDRAW
-      gfx.setColor(0);
-      gfx.drawLine(iPnt, 0, iPnt, dyPlot);
-    #endif
-    for(iTr=0; iTr<MAX_TRACES; iTr++) {
-      gfx.setColor(TraceCols[iTr]);
-      gfx.drawLine(iPnt-1, Traces[iTr][iPnt-1], iPnt, Traces[iTr][iPnt]);
+  #ifdef USES_ROLL_MODE
+    // Add one line to the chart; only the time string is drawn into the
+    // frame buffer, and only its part of the info panel is sent
+    //
+    Roll_addLine(TraceEnv);
+    if((RollCount++ % PLOT_UPDATE) == 0) {
+      const dirtyrect_t info = {0, 0, (int16_t)(dxInfo -1), INFO_DY -1};
+      drawTimeStr(Output, 0);
+      TFT_pushRect(&info);
     }
+    return;
+  #endif
+
+  // Draw new column of each trace, from its minimum to its maximum
+  //
+  #ifndef USES_FULL_REDRAW
+    gfx.setColor(0);
+    gfx.drawLine(iPnt, 0, iPnt, dyPlot);
+  #endif
+  for(iTr=0; iTr<MAX_TRACES; iTr++) {
+    gfx.setColor(TraceCols[iTr]);
+    gfx.drawLine(iPnt, getYCoord(iTr, TraceEnv[iTr].hi), iPnt, getYCoord(iTr, TraceEnv[iTr].lo));
   }
+  #ifdef USES_PARTIAL_COMMIT
+  dirtyAdd(&DirtyPlot, iPnt, 0, iPnt, dyPlot);
+  #endif
 
   iPnt++;
   if(iPnt >= MAX_VALUES) {
     // Set trace data pointer to the beginning of the array and clear screen
     //
     iPnt = 0;
-    #ifndef USES_FULL_REDRAW
-      gfx.setColor(0);
-      gfx.drawLine(0, 0, 0, dyPlot);
-    #else
+    #ifdef USES_FULL_REDRAW
       gfx.fillBuffer(0);
     #endif
+    #ifdef USES_PARTIAL_COMMIT
+      dirtyAdd(&DirtyWrap, DirtyPlot.x0, DirtyPlot.y0, DirtyPlot.x1, DirtyPlot.y1);
+      dirtyClear(&DirtyPlot);
+    #endif
 
     // Redraw info area
     //
@@ -486,21 +1271,24 @@ void plot(output_t* Output)
       gfx.setColor(TraceCols[iTr]);
       gfx.drawString(dxInfo/2 +(iTr+1)*dxInfo +5, dyPlot, OutputInfoStr[TracesStrIndex[iTr]]);
     }
+    #ifdef USES_PARTIAL_COMMIT
+      #ifdef USES_FULL_REDRAW
+      dirtyAdd(&DirtyPlot, 0, 0, SCREEN_WIDTH -1, dyPlot);
+      #endif
+      dirtyAdd(&DirtyInfo, 0, dyPlot, SCREEN_WIDTH -1, SCREEN_HEIGHT -1);
+    #endif
   }
   if((((iPnt-1) % PLOT_UPDATE) == 0) || (iPnt == 0)) {
     // Redraw time and mode
-    // (first old string in black, then new string in white; this is much faster then
-    //  clearing the info area with a filled rectangle)
     //
-    gfx.setColor(0);
-    gfx.drawString(dxInfo/2, dyPlot, timeStr);
-    sprintf(timeStr, "M%d %.1fs\n", Output->NeuronBehaviour, Output->currentMicros /1E6);
-    gfx.setColor(1);
-    gfx.drawString(dxInfo/2, dyPlot, timeStr);
+    drawTimeStr(Output, dyPlot);
+    #ifdef USES_PARTIAL_COMMIT
+    dirtyAdd(&DirtyInfo, 0, dyPlot, dxInfo -1, SCREEN_HEIGHT -1);
+    #endif
 
     // Commit graph commands
     //
-    gfx.commit();
+    commitScreen();
   }
 }
 
@@ -0,0 +1,247 @@
+// -----------------------------------------------------------------------------
+// Settings for the host build (Linux/macOS/Windows PC, no board attached)
+//
+// Selected in Spikeling.ino if SPIKELING_HOST is defined; used by the tools in
+// the "Host tools" folder (e.g. spikeling_sim), which include Spikeling.ino.
+// Instead of pins, the helper macros access the array HostPin[], which the
+// host tool fills from scripted input traces and which records the outputs.
+// The few Arduino functions and classes used by Spikeling.ino are emulated
+// here; random() gives the same sequence as on the Arduino (avr-libc).
+// -----------------------------------------------------------------------------
+//#define USES_FIXED_POINT  // set by the build (e.g. target spikeling_sim_fixed)
+//#define USES_STAGE_PROFILING
+//#define USES_NETWORK      // set by the build (e.g. target spikeling_sim_net)
+//#define USES_SYNAPSE_EDGES
+//#define USES_STA          // set by the build (target spikeling_sim_sta)
+#define   STA_POINTS 200
+
+#include <stdio.h>
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <string>
+#include "Definitions.h"
+
+// -----------------------------------------------------------------------------
+// Arduino basics
+// -----------------------------------------------------------------------------
+typedef bool    boolean;
+typedef uint8_t byte;
+
+#define HIGH        1
+#define LOW         0
+#define INPUT       0
+#define OUTPUT      1
+
+// -----------------------------------------------------------------------------
+// Pin definitions (simulation-related)
+// -----------------------------------------------------------------------------
+#define PhotoDiodePin 0  // Photodiode
+#define VmPotPin      1  // Resting membrane potential
+#define Syn1PotPin    2  // efficacy synapse 1
+#define Syn2PotPin    3  // efficacy synapse 2
+#define NoisePotPin   4  // scaling of Noise level
+#define AnalogInPin   5  // Analog in
+#define ButtonPin     6  // Push button to switch spike modes
+#define DigitalIn1Pin 7  // Synapse 1 Input
+#define DigitalIn2Pin 8  // Synapse 2 input
+#define DigitalOutPin 9  // "Axon"
+#define LEDOutPin     10 // LED
+#define AnalogOutPin  11 // Analog out for full spike waveform
+#define DACOutPin     12 // Analog out (DAC)
+#define LED_BUILTIN   13
+#define HOST_N_PINS   16
+
+int           HostPin[HOST_N_PINS];     // current value of each pin
+int           HostPinMode[HOST_N_PINS];
+unsigned long HostMicros     = 0;       // simulated system time
+unsigned long HostSpikeCount = 0;       // rising edges of DigitalOutPin
+
+// Digital and analog I/O helper macros
+//
+#define pinModeHelper(pin, mode)     hostPinMode(pin, mode)
+#define digitalReadHelper(pin)       HostPin[pin]
+#define digitalWriteHelper(pin, val) hostWrite(pin, val)
+#define analogReadHelper(pin)        HostPin[pin]
+#define analogWriteHelper(pin, val)  hostWrite(pin, val)
+#define dacWriteHelper(pin, val)     hostWrite(pin, val)
+
+// Serial out
+//
+#define SerOutBAUD      0
+#define SerOutQueueSize 4096
+
+// -----------------------------------------------------------------------------
+// Emulated Arduino functions
+// -----------------------------------------------------------------------------
+static inline void hostPinMode(int pin, int mode)
+{
+  HostPinMode[pin] = mode;
+}
+
+static inline void hostWrite(int pin, int val)
+{
+  if((pin == DigitalOutPin) && (val == HIGH) && (HostPin[pin] == LOW)) {
+    HostSpikeCount++;
+  }
+  HostPin[pin] = val;
+}
+
+static inline unsigned long micros()
+{
+  return HostMicros;
+}
+
+static inline unsigned long millis()
+{
+  return HostMicros /1000;
+}
+
+static inline void noInterrupts() {}
+static inline void interrupts() {}
+
+// Same generator as random() in avr-libc ("minimal standard" of Park and
+// Miller), so that the noise sequence matches the Arduino
+//
+static unsigned long HostRandomNext = 1;
+
+static inline long hostRandom()
+{
+  long hi, lo, x = (long)HostRandomNext;
+
+  if(x == 0) x = 123459876L;
+  hi = x /127773L;
+  lo = x %127773L;
+  x  = 16807L *lo -2836L *hi;
+  if(x < 0) x += 0x7FFFFFFFL;
+  HostRandomNext = (unsigned long)x;
+  return (long)((unsigned long)x %(0x7FFFFFFFUL +1));
+}
+
+static inline void randomSeed(unsigned long seed)
+{
+  HostRandomNext = seed;
+}
+
+static inline long random(long howbig)
+{
+  return (howbig == 0) ? 0 : hostRandom() %howbig;
+}
+
+static inline long random(long howsmall, long howbig)
+{
+  return (howsmall >= howbig) ? howsmall : random(howbig -howsmall) +howsmall;
+}
+
+// Subset of the Arduino String class; numbers are formatted as on the Arduino
+// (floats with 2 decimals)
+//
+class String
+{
+public:
+  String() {}
+  String&     operator =  (const char* s)     { _s = s; return *this; }
+  String&     operator =  (double f)          { _s.clear(); return (*this += f); }
+  String&     operator += (const char* s)     { _s += s; return *this; }
+  String&     operator += (char c)            { _s += c; return *this; }
+  String&     operator += (int i)             { return (*this += (long)i); }
+  String&     operator += (unsigned int i)    { return (*this += (unsigned long)i); }
+  String&     operator += (long i)            { return add("%ld", i); }
+  String&     operator += (unsigned long i)   { return add("%lu", i); }
+  String&     operator += (double f)          { return add("%.2f", zero(f)); }
+  const char* c_str() const                   { return _s.c_str(); }
+  unsigned    length() const                  { return (unsigned)_s.size(); }
+
+private:
+  // values that round to 0.00 print without a sign, as on the Arduino
+  static double zero(double f) { return (fabs(f) < 0.005) ? 0.0 : f; }
+
+  template <typename T>
+  String& add(const char* fmt, T val)
+  {
+    char buf[32];
+    snprintf(buf, sizeof(buf), fmt, val);
+    _s += buf;
+    return *this;
+  }
+  std::string _s;
+};
+
+// Serial port; output goes to a file (or nowhere if `out` is NULL), input
+// comes from `in` (filled by the host tool)
+//
+class HostSerial
+{
+public:
+  FILE*  out = NULL;
+  size_t nBytes = 0;
+  std::string in;
+
+  void   begin(long) {}
+  int    available() { return (int)in.size(); }
+  int    read()
+  {
+    if(in.empty()) return -1;
+    int c = (uint8_t)in[0];
+    in.erase(0, 1);
+    return c;
+  }
+  int    availableForWrite() { return 4096; }
+  size_t write(uint8_t b) { return write(&b, 1); }
+  size_t write(const uint8_t* buf, size_t len)
+  {
+    nBytes += len;
+    return (out != NULL) ? fwrite(buf, 1, len, out) : len;
+  }
+};
+
+HostSerial Serial;
+
+// Edge capture on the synapse inputs: counts the rising edges of the pin
+// values between two calls (at most one per step, as the pins only change
+// between steps)
+//
+#ifdef USES_SYNAPSE_EDGES
+  int HostSynPrev[2];
+
+  static inline uint8_t SynEdges_take(uint8_t i, unsigned long* t)
+  {
+    int now  = HostPin[(i == 0) ? DigitalIn1Pin : DigitalIn2Pin];
+    int rise = (now == HIGH) && (HostSynPrev[i] == LOW);
+    HostSynPrev[i] = now;
+    if(rise) *t = HostMicros;
+    return rise;
+  }
+#endif
+
+// Clock for stage profiling (time stamp counter on x86, else nanoseconds)
+//
+#ifdef USES_STAGE_PROFILING
+  #define PROFILE_CLOCK_MASK   0xFFFFFFFFUL
+  #define PROFILE_CLOCK_SCALE  1
+  #if defined(__x86_64__) || defined(__i386__)
+    #define PROFILE_CLOCK_UNIT "cycles"
+    #include <x86intrin.h>
+    static inline uint32_t profileClock() { return (uint32_t)__rdtsc(); }
+  #else
+    #define PROFILE_CLOCK_UNIT "ns"
+    #include <chrono>
+    static inline uint32_t profileClock()
+    {
+      return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+  #endif
+#endif
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+void initializeHardware()
+{
+  for(int i=0; i<HOST_N_PINS; i++) {
+    HostPinMode[i] = INPUT;
+  }
+}
+
+// -----------------------------------------------------------------------------
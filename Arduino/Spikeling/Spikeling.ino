@@ -7,8 +7,32 @@
 // Swap these if the ESP32is used instead of Arduino Nano
 // (for Spikeling 2.0, see GitHub/Manual)
 //
+#if defined(SPIKELING_HOST)
+  #include "SettingsHost.h"   // host build, see "Host tools/spikeling_sim"
+#else
 #include   "SettingsArduino.h"
 //#include "SettingsESP.h"
+#endif
+#include   "SerialFrame.h"
+#include   "DeltaStream.h"
+#include   "Model.h"
+#include   "RingBuffer.h"
+#include   "InputScheduler.h"
+#include   "PDFilter.h"
+#include   "Profiling.h"
+#include   "Noise.h"
+#ifdef USES_STA
+  #include "StaKernel.h"
+#endif
+#ifdef USES_FIXED_POINT
+  #include "FixedPoint.h"
+#endif
+#ifdef USES_NETWORK
+  #ifdef USES_FIXED_POINT
+    #error "USES_NETWORK requires the float model (no USES_FIXED_POINT)"
+  #endif
+  #include "Network.h"
+#endif
 
 ///////////////////////////////////////////////////////////////////////////
 // KEY PARAMETERS TO SET BY USER  /////////////////////////////////////////
@@ -23,10 +47,63 @@ int   FastMode        = 0;    // default 0; if >0, the script is more optimised
                               // FastMode = 1: Stores 4 model parameters via serial, runs at ~390 Hz, system time in column 4 (of 4)
                               // FastMode = 2: Stores 2 model parameters via serial, runs at ~480 Hz, system time in column 2 (of 2)
                               // FastMode = 3: Stores 0 model parameters via serial, runs at ~730 Hz, DOES NOT SEND DATA TO PC!
-                              // The next best thing to furhter increase speed would be to call the several analog.read/write functions
-                              // less frequently. If all are disabled, the mode can exceed 1kHz, but then the dials/PD don't work... One compromise
-                              // around this would be to call them less frequently. This would give a little extra speed but eventually make the
-                              // dials and photodiode feel "sluggish". The latter is currently not implemented
+                              // The next best thing to further increase speed is to read the dials, photodiode etc. less frequently,
+                              // which eventually makes them feel "sluggish". This is set for each input in InputDivisor below
+int   SerialMode      = 0;    // default 0
+                              // SerialMode = 0: Sends one line of comma-separated ASCII values per iteration (see FastMode)
+                              // SerialMode = 1: Sends one binary frame per iteration with all 9 model parameters (see SerialFrame.h).
+                              // ... This avoids the float-to-text conversion and is about half the size of an ASCII line. Of the
+                              // ... FastMode settings, only FastMode = 3 (no data) applies. Use "Host tools/spikeling_csv" to convert
+                              // ... the recording into the usual CSV format
+                              // SerialMode = 2: Sends only events as binary frames: spikes (model resets, with the time of the 30 mV
+                              // ... crossing interpolated within the step), changes of the stimulator state and of the neuron mode,
+                              // ... synapse input pulses (with their time if USES_SYNAPSE_EDGES is defined, see Settings file),
+                              // ... plus a sample frame every EventSummaryEvery steps for the continuous values. Use
+                              // ... "Host tools/spikeling_csv -e" to write the events into a CSV file
+                              // SerialMode = 3: Sends the continuous values compressed (see DeltaStream.h): rounded to 0.01 like the
+                              // ... ASCII lines and coded as differences to the previous step, usually 2-9 bytes per step instead of
+                              // ... ~60 (ASCII) or 40 (SerialMode = 1). Convert with "Host tools/spikeling_csv"
+                              // SerialMode = 4: Sends no samples, only the spike-triggered average of the noise stimulus (Syn1Mode = 2)
+                              // ... computed on the board, every StaReportEvery seconds (requires USES_STA, see Settings file). For
+                              // ... long kernel-mapping runs; convert with "Host tools/spikeling_csv -k"
+int   SerialSeq       = 0;    // default 0; only SerialMode = 0: if 1, a record number that counts every model step is added to
+                              // ... each line as last column (after the system time), so that lost, repeated and reordered lines
+                              // ... can be told apart ("Host tools/spikeling_ingest" writes them as a clean, ordered stream).
+                              // ... Binary frames always carry a frame counter
+int   EventSummaryEvery = 1000; // default 1000; only SerialMode = 2: send a sample frame every n-th model step (0: none)
+int   KeyFrameEvery   = 500;  // default 500; only SerialMode = 3: send the absolute values every n-th step, from which the PC can
+                              // ... continue after a lost frame (1: only absolute values)
+int   DeltaBlockSamples = 8;  // default 8; only SerialMode = 3: steps per frame (fewer: less delay, more bytes per step)
+int   StaReportEvery  = 10;   // default 10; only with USES_STA: send the on-board STA every n seconds while the Synapse 1 port
+                              // ... generates noise (0: only on request). As "STA" lines with SerialMode = 0, otherwise as binary
+                              // ... frames. Sending the character K over serial requests the STA, R restarts it (it also restarts
+                              // ... when the neuron mode changes)
+int   TickRateHz      = 500;  // default 500; only used if USES_MODEL_TICK is defined (see Settings file). The model is then computed
+                              // ... at exactly this rate (the period is rounded to whole microseconds), with the inputs read at the
+                              // ... start of each tick, and the system time column counts in multiples of the period. The serial
+                              // ... output is sent in the background, so choose a rate at which the data still fits through the
+                              // ... serial port (e.g. an ASCII line with FastMode = 0 takes ~2.5 ms at 234000 baud on the Arduino).
+                              // ... Ticks that are missed because a step took too long are counted and flagged in binary frames.
+                              // ... Rates outside 1..10000 Hz are clamped; at start, a line "Tick period us:" reports the period if
+                              // ... it differs from 1000000/TickRateHz (below ~31 Hz, the Arduino timer rounds it to 4-64 us)
+int   InputDivisor[]  = {1, 1, 1, 1, 1, 1, 1}; // default all 1; read an input only every n-th model step (n = 1..255). Order:
+                              // ... Vm dial, Synapse 1 dial, Synapse 2 (and Analog In) dial, Noise dial, Analog In, Photodiode, button.
+                              // ... E.g. {10, 10, 10, 10, 1, 1, 10} reads the dials and button 10x less often than the analog in and photodiode.
+                              // ... The synapse digital inputs are always read. Note: the PD filter window (below) counts photodiode reads
+int   RateReport      = 0;    // default 0; if >0, a line "Model rate:" with the achieved model rate in Hz is sent every RateReport
+                              // ... seconds (to compare InputDivisor settings); the rate is also sent when the mode is changed. With
+                              // ... USES_MODEL_TICK, the totals of missed ticks and dropped outputs follow (e.g. to check that the
+                              // ... rate stays flat with USES_DUAL_CORE while the display updates, with and without USES_PLOTTING)
+int   NetNeurons      = 8;    // default 8; only used if USES_NETWORK is defined (see Settings file). Number of neurons in the network
+                              // ... (up to NET_MAX_NEURONS). The inputs (photodiode, dials, synapses, analog in, noise) drive neuron 0
+                              // ... (all neurons if NetDriveAll = 1), the serial output and analog out show neuron 0, the digital out
+                              // ... pulses when any neuron spikes and the DAC (if present) gives the fraction of neurons that spiked
+int   NetConnect      = 1;    // default 1; connections between the neurons, 0: none, 1: chain (0->1->2..), 2: ring, 3: all-to-all,
+                              // ... 4: random (1 in 4 pairs, same on every start); see Network.h
+float NetWeight       = 10.0; // default 10; current added to a neuron when a neuron connected to it spikes. Negative for inhibition
+int   NetDriveAll     = 0;    // default 0; 1: all neurons receive the inputs, not only neuron 0
+int   NetModeStep     = 0;    // default 0; neuron i uses the mode NeuronBehaviour + i*NetModeStep (wrapped around), so with 1
+                              // ... the neurons cycle through the Array_xxx modes below; with 0, all are in the selected mode
 int   AnalogInActive  = 1;    // default = 1, PORT 3 setting: Is Analog In port in use? Note that this shares the dial with the Syn2 (PORT 2) dial
 int   Syn1Mode        = 1;    // default 1
                               // Syn1Mode = 0: Synapse 1 Port works like Synapse 2, to receive digital pulses as inputs
@@ -40,6 +117,10 @@ int   SynapseScaling  = 50;   // The lower, the stronger the synapse.
 int   VmPotiScaling   = 2;    // the lower, the stronger the impact of the Vm poti.  Default = 2
 int   AnalogInScaling = 2500; // the lower, the stronger the impact of Analog Input. Default = 2500
 int   NoiseScaling    = 10;   // the lower, the higher the default noise level.      Default = 10
+unsigned long NoiseSeed = 1;  // default 1; seed of the noise current and the noise stimulus (Syn1Mode = 2, see Noise.h). The same
+                              // ... seed gives the same noise on every board and in "Host tools/spikeling_sim -R", so a run can be
+                              // ... replayed. 0: a different seed at every start (from the system time)
+int   NoiseGaussian   = 1;    // default 1; Gaussian noise current increments. 0: uniform increments as in Spikeling 1.x (same level)
 
 float Synapse_decay   = 0.995;// speed of synaptic decay.The difference to 1 matters - the smaller the difference, the slower the decay. Default  = 0.995
 float PD_gain_min     = 0.0;  // the photodiode gain cannot decay below this value
@@ -59,6 +140,8 @@ float Array_d[]           =  {  6.0,   2.0, 0.05,  4.0,  6.0 }; // after spike r
 float Array_PD_decay[]    =  { 0.00005,  0.001, 0.00005,  0.001, 0.00005  }; // slow/fast adapting Photodiode - small numbers make diode slow to decay
 float Array_PD_recovery[] =  {   0.001,   0.01,   0.001,   0.01,   0.001  }; // slow/fast adapting Photodiode - small numbers make diode recover slowly
 int   Array_PD_polarity[] =  {       1,     -1,      -1,      1,       1  }; // 1 or -1, flips photodiode polarity, i.e. 1: ON cell, 2: OFF cell
+int   Array_PD_filter[]   =  {       0,      0,       0,      0,       0  }; // smoothing of the photodiode readings, 0: boxcar (mean), 1: exponential moving average, 2: binomial FIR (see PDFilter.h)
+int   Array_PD_window[]   =  {      10,     10,      10,     10,      10  }; // filter window in photodiode readings; boxcar: 1-32, EMA: time constant (rounded down to a power of 2), FIR: 1-9 taps
 
 int   Array_DigiOutMode[] =  {Syn1Mode,Syn1Mode,Syn1Mode,Syn1Mode,Syn1Mode}; // PORT 1 setting. 0: Synapse 1 In, 1: Stimulus out, 2: 50 Hz binary noise out (for reverse correlation)
 /////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -67,23 +150,48 @@ int   Array_DigiOutMode[] =  {Syn1Mode,Syn1Mode,Syn1Mode,Syn1Mode,Syn1Mode}; //
 
 ////////////////////////////////////////////////////////////////////////////
 // Setup variables required to drive the model
+model_input_t  ModelIn;      // inputs of the current step for the simulation core (Model.h)
+noise_t        Noise;        // noise current and noise stimulus (Noise.h)
+#ifndef USES_FIXED_POINT
+model_config_t ModelConfig;  // the parameters above
+model_mode_t   ModelModes[sizeof(Array_a)/sizeof(Array_a[0])];
+model_state_t  Model;        // model state
+#endif
+
 float I_total;           // Total input current to the model
 float I_PD;              // Photodiode current
-float I_Vm;              // Vm setting current
 float I_Synapse;         // Total synaptic current of both synapses
 float I_AnalogIn;        // Current from analog Input
-float I_Noise;           // Noise current
-float Synapse1Ampl;      // Synapse 1 efficacy
-float Synapse2Ampl;      // Synapse 2 efficacy
-float AnalogInAmpl;      // Analog In efficacy
-float NoiseAmpl;         // Added Noise level
 long  ModelpreviousMicros   = 0;
 
+// for the model tick and the background serial output
+#define TICK_RATE_MIN 1           // TickRateHz is clamped to this range
+#define TICK_RATE_MAX 10000
+uint32_t      LastTick       = 0;
+uint32_t      MissedTicks    = 0; // total number of missed ticks
+unsigned long TickPeriod_us  = 0;
+uint32_t      DroppedOutputs = 0; // lines/frames (or output records) that did not fit into the serial queue (output ring)
+uint8_t       SerialQueueBuf[SerOutQueueSize];
+ringbuf_t     SerialQueue;
+#ifdef USES_DUAL_CORE
+output_t      OutputRingBuf[OutputRingSize]; // output records from the model core to the I/O core
+recring_t     OutputRing;
+void          loopStepTask(); // the two tasks, see below
+bool          serviceIO();
+#endif
+
 // initialise state variables for different inputs
 boolean spike = false;
 int     buttonState    = 0;
+int     lastButtonState= 0;
+int     BlinkCount     = 0;   // LED toggles left to signal the mode
+unsigned long BlinkMillis = 0;
 int     SpikeIn1State  = 0;
 int     SpikeIn2State  = 0;
+#ifdef USES_SYNAPSE_EDGES
+unsigned long SpikeIn1Age = 0; // time from the latest pulse on each synapse input to reading the input
+unsigned long SpikeIn2Age = 0;
+#endif
 int     VmPotVal       = 0;
 float   Syn1PotVal     = 0.0;
 float   Syn2PotVal     = 0.0;
@@ -93,20 +201,65 @@ float   AnalogInVal    = 0.0;
 int     PDVal          = 0;
 int     Stimulator_Val = 0;
 
-// for PD smoothing // this is a dirty hack to smooth the photodiode current which in raw form generates ugly noise spikes
-int PDVal_Array[]         =  {0,0,0,0,0,0,0,0,0,0};
-int PD_integration_counter= 0;
+// for PD smoothing // the photodiode current in raw form generates ugly noise spikes
+pdfilter_t PDFilter;
 float PDVal_smoothed      = 0;
 
-float PD_gain = 1.0;
 int NeuronBehaviour = 0; // 0:8 for different modes, cycled by button
 int DigiOutStep = 0;     // stimestep counter for stimulator mode
 int Stim_State = 0;      // State of the internal stimulator
 float v; // voltage in Iziekevich model
-float u; // recovery variable in Iziekevich model
+boolean ModelSpike = false; // model was reset in this step ...
+float   SpikeFrac  = 0;     // ... with the 30 mV crossing at this fraction of the step
+
+#ifdef USES_NETWORK
+network_t Net;           // network of NetNeurons neurons (Network.h)
+int NetMode = -1;        // NeuronBehaviour the network was set up for
+#endif
+
+#ifdef USES_FIXED_POINT
+fx_config_t FxConfig;    // fixed-point versions of the parameters above
+fx_mode_t   FxModes[sizeof(Array_a)/sizeof(Array_a[0])];
+fx_state_t  Fx;          // fixed-point model state
+#endif
 
-output_t Output; // output structure for plotting
+inputsched_t Sched;      // per-input update rates
+uint16_t InputsDue = IN_ALL;
+
+#ifdef USES_STAGE_PROFILING
+stageprof_t StageProf[N_STAGES]; // timing of the stages of loop()
+#endif
+
+output_t Output; // output structure for plotting and binary serial output
 String   OutputStr;
+String   SampleStr; // ASCII line of one sample (formatted on the I/O core with USES_DUAL_CORE)
+sample_t Sample; // binary frame payload
+uint8_t  FrameBuf[FRAME_HEADER_LEN +DELTA_BLOCK_BYTES +FRAME_CRC_LEN]; // (largest frame: SerialMode = 3)
+uint16_t FrameSeq = 0;
+unsigned long OutputSeq = 0;        // record number of the next output record
+unsigned long FormatSeq = 0;        // record number expected by formatSample()
+uint32_t EventStep = 0;             // for SerialMode = 2: steps formatted so far, ...
+unsigned long EventPrevMicros = 0;  // ... time of the previous step, ...
+int      EventStim = -1;            // ... and last Stim_State and NeuronBehaviour sent
+int      EventMode = -1;
+int      EventSyn[2] = {0, 0};      // ... and the polled synapse input levels
+deltastate_t DeltaEnc;              // for SerialMode = 3: previous step and pending delta frame
+keysample_t  KeySample;
+#ifdef USES_STA
+sta_t    Sta;                       // on-board STA (StaKernel.h), ...
+int      StaMode = -1;              // ... for this NeuronBehaviour, ...
+unsigned long StaReportMicros = 0;  // ... last sent at this time
+#ifdef USES_DUAL_CORE
+sta_t    StaCopy;                   // sums of the running report, copied on the model core
+const sta_t* StaOut = &StaCopy;
+#else
+const sta_t* StaOut = &Sta;         // sums of the running report
+#endif
+int      StaNext = 0;               // next point to send, owned by the sender ...
+volatile boolean StaSending = false; // ... while a report is running
+volatile boolean StaReportDue = false; // requested over serial (K, R)
+volatile boolean StaResetDue  = false;
+#endif
 
 int startMicros = micros();
 
@@ -117,122 +270,322 @@ int startMicros = micros();
 void setup(void) {
   Serial.begin(SerOutBAUD);
   initializeHardware(); // Set all the PINs
+  rbInit(&SerialQueue, SerialQueueBuf, SerOutQueueSize);
+  deltaInit(&DeltaEnc);
+  noiseSeed(&Noise, (NoiseSeed != 0) ? NoiseSeed : micros());
+  #ifdef USES_STA
+    staInit(&Sta);
+  #endif
+  schedInit(&Sched, InputDivisor, millis());
+  pdfInit(&PDFilter, Array_PD_filter[NeuronBehaviour], Array_PD_window[NeuronBehaviour], 0);
+
+  #ifndef USES_FIXED_POINT
+    // Set up simulation core
+    modelInitConfig(&ModelConfig, timestep_ms, Synapse_decay, PD_gain_min, PD_Scaling, VmPotiScaling, AnalogInScaling, SynapseScaling, AnalogInActive);
+    for (int i = 0; i < nModes; i++) {
+      modelInitMode(&ModelModes[i], Array_a[i], Array_b[i], Array_c[i], Array_d[i], Array_PD_decay[i], Array_PD_recovery[i], Array_PD_polarity[i]);
+    }
+    modelInitState(&Model);
+    #ifdef USES_NETWORK
+      netInit(&Net, NetNeurons, &ModelModes[NeuronBehaviour]);
+      netConnect(&Net, NetConnect, NetWeight);
+      for (int i = 1; i < Net.n; i++) {
+        Net.gain[i] = NetDriveAll;
+      }
+    #endif
+  #else
+    // Convert parameters into fixed-point
+    fxInitConfig(&FxConfig, timestep_ms, Synapse_decay, PD_gain_min, PD_Scaling, VmPotiScaling, AnalogInScaling, SynapseScaling, AnalogInActive);
+    for (int i = 0; i < nModes; i++) {
+      fxInitMode(&FxModes[i], Array_a[i], Array_b[i], Array_c[i], Array_d[i], Array_PD_decay[i], Array_PD_recovery[i], Array_PD_polarity[i], timestep_ms);
+    }
+    fxInitState(&Fx);
+  #endif
+
+  #ifdef USES_DUAL_CORE
+    // Model step on core 1, serial output and display on core 0 (see Settings file)
+    rrInit(&OutputRing, OutputRingBuf, sizeof(output_t), OutputRingSize);
+    DualCore_start(loopStepTask, serviceIO);
+  #endif
+
+  #ifdef USES_MODEL_TICK
+    // Start timer for the model tick; report the period if TickRateHz is out
+    // of range or the timer had to round it
+    unsigned long period_us = 1000000UL / constrain(TickRateHz, TICK_RATE_MIN, TICK_RATE_MAX);
+    TickPeriod_us = ModelTick_init(period_us);
+    if ((TickRateHz < TICK_RATE_MIN) || (TickRateHz > TICK_RATE_MAX) || (TickPeriod_us != period_us)) {
+      OutputStr  = "Tick period us:";
+      OutputStr += TickPeriod_us;
+      OutputStr += "\r\n";
+      Serial.write((const uint8_t*)OutputStr.c_str(), OutputStr.length());
+    }
+  #endif
 }
 
 ////////////////////////////////////////////////////////////////////////////
-// MAIN ////////////////////////////////////////////////////////////////////
+// HELPERS /////////////////////////////////////////////////////////////////
 ////////////////////////////////////////////////////////////////////////////
 
-void loop(void) {
+// Send a complete line or frame; with USES_MODEL_TICK it is queued and sent
+// by serviceSerial() in the background, and dropped if the queue is full
+void sendOutput(const uint8_t* buf, uint16_t len) {
+  #ifdef USES_MODEL_TICK
+    if (!rbWrite(&SerialQueue, buf, len)) {DroppedOutputs++;}
+  #else
+    Serial.write(buf, len);
+  #endif
+}
 
-  // check system time in microseconds
-  unsigned long currentMicros = micros() - startMicros;
+// Pass as many queued bytes to the serial port as fit without blocking
+void serviceSerial() {
+  uint8_t buf[32];
+  int n = Serial.availableForWrite();
+  if (n > (int)sizeof(buf)) {n = sizeof(buf);}
+  if (n > 0) {
+    n = rbRead(&SerialQueue, buf, n);
+    if (n > 0) {Serial.write(buf, n);}
+  }
+}
 
-  // do housekeeping, if needed
-  #ifdef USES_HOUSEKEEPING
-    housekeeping();
-  #endif
+#ifdef USES_DUAL_CORE
+// Write directly to the serial port (I/O core only)
+void writeSerial(const uint8_t* buf, uint16_t len) {
+  Serial.write(buf, len);
+}
+#endif
 
-  // read button to change spike model
-  buttonState = digitalReadHelper(ButtonPin);
-  if (buttonState == HIGH) {
+// Read button to change spike model, and blink the onboard LED according to
+// which programme is selected (without blocking the model)
+void serviceButton() {
+  if (BlinkCount > 0) {
+    if (millis() - BlinkMillis >= 150) {
+      BlinkMillis = millis();
+      BlinkCount -= 1;
+      digitalWriteHelper(LED_BUILTIN, (BlinkCount % 2) ? HIGH : LOW);
+    }
+    return; // button is ignored while blinking
+  }
+  if (InputsDue & IN_BIT(IN_BUTTON)) {
+    buttonState = digitalReadHelper(ButtonPin);
+  }
+  if ((buttonState == HIGH) && (lastButtonState == LOW)) {
     NeuronBehaviour+=1;
     if (NeuronBehaviour>=nModes) {NeuronBehaviour=0;}
-    Serial.print("Neuron Mode:");
-    Serial.println(NeuronBehaviour);
-    for (int modeblink = 0; modeblink < NeuronBehaviour +1; modeblink++) {
-      digitalWriteHelper(LED_BUILTIN, HIGH); // Blinks the onboard LED according to which programme is selected
-      delay(150);
-      digitalWriteHelper(LED_BUILTIN, LOW);
-      delay(150);
-    }
+    pdfInit(&PDFilter, Array_PD_filter[NeuronBehaviour], Array_PD_window[NeuronBehaviour], PDFilter.out);
+    OutputStr  = "Neuron Mode:";
+    OutputStr += NeuronBehaviour;
+    OutputStr += "\r\nModel rate:";
+    OutputStr += Sched.rateHz;
+    #ifdef USES_MODEL_TICK
+      OutputStr += "\r\nMissed ticks:";
+      OutputStr += MissedTicks;
+      OutputStr += "\r\nDropped outputs:";
+      OutputStr += DroppedOutputs;
+    #endif
+    OutputStr += "\r\n";
+    sendOutput((const uint8_t*)OutputStr.c_str(), OutputStr.length());
+    BlinkCount = (NeuronBehaviour +1) *2;
+    BlinkMillis = millis();
+    digitalWriteHelper(LED_BUILTIN, HIGH);
     if (Array_DigiOutMode[NeuronBehaviour]==0) {
       pinModeHelper(DigitalIn1Pin, INPUT); // SET SYNAPSE 1 IN AS INTENDED
     } else {
       pinModeHelper(DigitalIn1Pin, OUTPUT); // SET SYNAPSE 1 IN AS STIMULATOR OUT CHANNEL
     }
   }
+  lastButtonState = buttonState;
+}
 
- // NOTE: the below analogRead functions take some microseconds to execute so to speed up the model they
- // could be called less frequently or removed entirely.
- // To remove them, simply change e.g. PotVal = analogRead(VmPotPin); to PotVal = 512;
+#ifdef USES_STAGE_PROFILING
+// Send the stage timing as one JSON line and restart the measurement
+void reportProfile() {
+  OutputStr  = "{\"profile\":{\"unit\":\"" PROFILE_CLOCK_UNIT "\",\"stages\":{";
+  for (int i = 0; i < N_STAGES; i++) {
+    if (i > 0) {OutputStr += ",";}
+    OutputStr += "\"";
+    OutputStr += StageNames[i];
+    OutputStr += "\":{\"calls\":";
+    OutputStr += StageProf[i].calls;
+    OutputStr += ",\"mean\":";
+    OutputStr += (StageProf[i].calls > 0) ? (float)StageProf[i].sum / StageProf[i].calls : 0.0;
+    OutputStr += ",\"max\":";
+    OutputStr += StageProf[i].max;
+    OutputStr += "}";
+    StageProf[i].calls = 0;
+    StageProf[i].sum = 0;
+    StageProf[i].max = 0;
+  }
+  OutputStr += "}}}\r\n";
+  sendOutput((const uint8_t*)OutputStr.c_str(), OutputStr.length());
+}
+#endif
 
-  // read Vm potentiometer to calculate I_Vm
-  VmPotVal = analogReadHelper(VmPotPin); // 0:1023, Vm
-  I_Vm = -1 * (VmPotVal-512) / VmPotiScaling;
+////////////////////////////////////////////////////////////////////////////
+// STAGES OF THE MAIN LOOP /////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////
 
-  // read analog In potentiometer to set Analog in and Noise scaling
-  AnalogInPotVal = analogReadHelper(Syn2PotPin); // 0:1023, Vm - reads same pot as Synapse 2!
-  AnalogInAmpl = (AnalogInPotVal - 512) / AnalogInScaling;
+// Read dials, photodiode and synapse inputs
+void readInputs() {
+  // do housekeeping, if needed
+  #ifdef USES_HOUSEKEEPING
+    housekeeping(InputsDue);
+  #endif
 
-  NoisePotVal = analogReadHelper(NoisePotPin); // 0:1023, Vm
-  NoiseAmpl = -1 * ((NoisePotVal-512) / NoiseScaling);
-  if (NoiseAmpl<0) {NoiseAmpl = 0;}
-   I_Noise+=random(-NoiseAmpl/2,NoiseAmpl/2);
-  I_Noise*=0.9;
+ // NOTE: the below analogRead functions take some microseconds to execute; inputs that are not due
+ // in this step (see InputDivisor) keep their last value
 
-  // read analog in to calculate I_AnalogIn
-  AnalogInVal = analogReadHelper(AnalogInPin); // 0:1023
-  I_AnalogIn = -1 * (AnalogInVal) * AnalogInAmpl;
-  if (AnalogInActive == 0) {I_AnalogIn = 0;}
+  // read Vm potentiometer
+  if (InputsDue & IN_BIT(IN_VM_POT)) {
+    VmPotVal = analogReadHelper(VmPotPin); // 0:1023, Vm
+  }
 
+  // read analog In potentiometer to set Analog in and Noise scaling
+  if (InputsDue & IN_BIT(IN_SYN2_POT)) {
+    AnalogInPotVal = analogReadHelper(Syn2PotPin); // 0:1023, Vm - reads same pot as Synapse 2!
+  }
+  if (InputsDue & IN_BIT(IN_NOISE_POT)) {
+    NoisePotVal = analogReadHelper(NoisePotPin); // 0:1023, Vm
+  }
 
-  // read Photodiode
-  int PDVal = analogReadHelper(PhotoDiodePin); // 0:1023
-  if (PD_integration_counter<10) {   // PD integration over 5 points
-    PD_integration_counter+=1;
-  } else {
-    PD_integration_counter=0;
-  }
-  PDVal_Array[PD_integration_counter]=PDVal;
-  PDVal_smoothed=(PDVal_Array[0]+PDVal_Array[1]+PDVal_Array[2]+PDVal_Array[3]+PDVal_Array[4]+PDVal_Array[5]+PDVal_Array[6]+PDVal_Array[7]+PDVal_Array[8]+PDVal_Array[9])/10; // dirty hack to smooth PD current - could be a lot more elegant
-  I_PD = ((PDVal_smoothed) / PD_Scaling) * PD_gain; // input current
-
-  if (PD_gain>PD_gain_min){
-    PD_gain-=Array_PD_decay[NeuronBehaviour]*I_PD; // adapts proportional to I_PD
-     if (PD_gain<PD_gain_min){
-      PD_gain=PD_gain_min;
-    }
+  // read analog in
+  if (InputsDue & IN_BIT(IN_ANALOG_IN)) {
+    AnalogInVal = analogReadHelper(AnalogInPin); // 0:1023
   }
-  if (PD_gain<1.0) {
-    PD_gain+=Array_PD_recovery[NeuronBehaviour]; // recovers by constant % per iteration
+
+  // read Photodiode
+  if (InputsDue & IN_BIT(IN_PHOTODIODE)) {
+    PDVal = analogReadHelper(PhotoDiodePin); // 0:1023
   }
 
-  // Read the two synapses to calculate Synapse Ampl parameters
-  Syn1PotVal = analogReadHelper(Syn1PotPin); // 0:1023, Vm
-  Synapse1Ampl = -1* (Syn1PotVal-512) / SynapseScaling; //
-  Syn2PotVal = analogReadHelper(Syn2PotPin); // 0:1023, Vm
-  Synapse2Ampl = -1 * (Syn2PotVal-512) / SynapseScaling; //
+  // Read the two synapses
+  if (InputsDue & IN_BIT(IN_SYN1_POT)) {
+    Syn1PotVal = analogReadHelper(Syn1PotPin); // 0:1023, Vm
+  }
+  if (InputsDue & IN_BIT(IN_SYN2_POT)) {
+    Syn2PotVal = analogReadHelper(Syn2PotPin); // 0:1023, Vm
+  }
 
   // read Synapse digital inputs
-  SpikeIn1State = digitalReadHelper(DigitalIn1Pin);
+  #ifdef USES_SYNAPSE_EDGES
+    // number of pulses since the last step, counted by interrupt, and the time of the latest (see Settings file)
+    unsigned long t1 = 0, t2 = 0;
+    SpikeIn1State = SynEdges_take(0, &t1);
+    SpikeIn2State = SynEdges_take(1, &t2);
+    SpikeIn1Age = micros() - t1;
+    SpikeIn2Age = micros() - t2;
+  #else
+    SpikeIn1State = digitalReadHelper(DigitalIn1Pin);
+    SpikeIn2State = digitalReadHelper(DigitalIn2Pin);
+  #endif
   if (Array_DigiOutMode[NeuronBehaviour]>0){
     SpikeIn1State = LOW;
   }
-  SpikeIn2State = digitalReadHelper(DigitalIn2Pin);
-  if (SpikeIn1State == HIGH) {I_Synapse+=Synapse1Ampl;}
-  if (SpikeIn2State == HIGH) {I_Synapse+=Synapse2Ampl;}
+}
+
+// Smooth the photodiode readings
+void filterPD() {
+  if (InputsDue & IN_BIT(IN_PHOTODIODE)) {
+    PDVal_smoothed = pdfUpdate(&PDFilter, PDVal); // smooth PD current, filter depends on mode (see Array_PD_filter)
+  }
+}
+
+// Sum up the input currents, including synapses and noise
+void computeCurrents() {
+  // Inputs for the simulation core
+  ModelIn.VmPotVal = VmPotVal;
+  ModelIn.AnalogInPotVal = AnalogInPotVal;
+  ModelIn.AnalogInVal = AnalogInVal;
+  ModelIn.PDVal_smoothed = PDVal_smoothed;
+  ModelIn.Syn1PotVal = Syn1PotVal;
+  ModelIn.Syn2PotVal = Syn2PotVal;
+  ModelIn.SpikeIn1State = SpikeIn1State;
+  ModelIn.SpikeIn2State = SpikeIn2State;
+  long NoiseRange = modelNoiseRange(NoisePotVal, NoiseScaling);
+  ModelIn.Noise = noiseIncrement(&Noise, NoiseRange, NoiseGaussian);
+
+  #ifdef USES_FIXED_POINT
+    // Sum up currents in fixed-point (see FixedPoint.h)
+    fxCurrents(&Fx, &ModelIn, &FxModes[NeuronBehaviour], &FxConfig);
+  #else
+    // Sum up currents (see Model.h)
+    modelCurrents(&Model, &ModelIn, &ModelModes[NeuronBehaviour], &ModelConfig);
+  #endif
+}
+
+// Advance the Izhikevich model
+void computeModel() {
+  #ifdef USES_FIXED_POINT
+    // Compute Izhikevich model in fixed-point (see FixedPoint.h)
+    float v_start = q16ToFloat(Fx.v);
+    ModelSpike = fxIntegrate(&Fx, &FxModes[NeuronBehaviour], &FxConfig);
+    SpikeFrac = modelSpikeFraction(v_start, q16ToFloat(Fx.v_pre));
 
-  // Decay all synaptic current towards zero
-  I_Synapse*=Synapse_decay;
+    // convert back to float for the outputs
+    v = q16ToFloat(Fx.v);
+    I_total = q16ToFloat(Fx.I_total);
+    I_PD = q16ToFloat(Fx.I_PD);
+    I_AnalogIn = q16ToFloat(Fx.I_AnalogIn);
+    I_Synapse = q16ToFloat(Fx.I_Synapse);
+  #elif defined(USES_NETWORK)
+    // Compute the network, driven by the summed input currents (see Network.h)
+    if (NeuronBehaviour != NetMode) {
+      for (int i = 0; i < Net.n; i++) {
+        netSetMode(&Net, i, &ModelModes[(NeuronBehaviour + i*NetModeStep) % nModes]);
+      }
+      NetMode = NeuronBehaviour;
+    }
+    netStep(&Net, Model.I_total, &ModelConfig);
+    ModelSpike = Net.spiked[0]; // (the network keeps no pre-reset v, so spikes of neuron 0 are at the end of the step)
+    SpikeFrac = 1.0;
+
+    v = Net.v[0];
+    I_total = Model.I_total;
+    I_PD = Model.I_PD;
+    I_AnalogIn = Model.I_AnalogIn;
+    I_Synapse = Model.I_Synapse;
+  #else
+    // Compute Izhikevich model (see Model.h)
+    float v_start = Model.v;
+    ModelSpike = modelIntegrate(&Model, &ModelModes[NeuronBehaviour], &ModelConfig);
+    SpikeFrac = modelSpikeFraction(v_start, Model.v_pre);
+
+    v = Model.v;
+    I_total = Model.I_total;
+    I_PD = Model.I_PD;
+    I_AnalogIn = Model.I_AnalogIn;
+    I_Synapse = Model.I_Synapse;
+  #endif
+}
 
-  // compute Izhikevich model
-  float I_total = I_PD*Array_PD_polarity[NeuronBehaviour] + I_Vm + I_Synapse + I_AnalogIn + I_Noise; // Add up all current sources
-  v = v + timestep_ms*(0.04 * v * v + 5*v + 140 - u + I_total);
-  u = u + timestep_ms*(Array_a[NeuronBehaviour] * ( Array_b[NeuronBehaviour]*v - u));
-  if (v>=30.0){v=Array_c[NeuronBehaviour]; u+=Array_d[NeuronBehaviour];}
-  if (v<=-90) {v=-90.0;} // prevent from analog out (below) going into overdrive - but also means that it will flatline at -90. Change the "90" in this line and the one below if want to
+// Analog out, LED and spike out
+void writeOutputs() {
   int AnalogOutValue = (v+90) * 2;
   analogWriteHelper(AnalogOutPin,AnalogOutValue);
 
-  #ifdef USES_DAC
-    dacWriteHelper(DACOutPin, uint8_t(map(v, -90,20, 0,255)));
+  #ifdef USES_NETWORK
+    // Digi out and DAC show the whole network: a pulse if any neuron spikes,
+    // and the fraction of neurons that are spiking
+    int NetSpiking = 0;
+    for (int i = 0; i < Net.n; i++) {
+      if (Net.v[i]>-30.0) {NetSpiking++;}
+    }
+    #ifdef USES_DAC
+      dacWriteHelper(DACOutPin, uint8_t(NetSpiking * 255 / Net.n));
+    #endif
+  #else
+    #ifdef USES_DAC
+      dacWriteHelper(DACOutPin, uint8_t(map(v, -90,20, 0,255)));
+    #endif
   #endif
 
   if (noled==0) {
     analogWriteHelper(LEDOutPin,AnalogOutValue);
   }
-  if  (v>-30.0) {spike=true;}   // check if there has been a spike for digi out routine (below)
+  #ifdef USES_NETWORK
+    if (NetSpiking>0) {spike=true;}
+  #else
+    if  (v>-30.0) {spike=true;}   // check if there has been a spike for digi out routine (below)
+  #endif
 
   // trigger audio click and Digi out 5V pulse if there has been a spike
   if (spike==true) {
@@ -244,8 +597,10 @@ void loop(void) {
   else {
     digitalWriteHelper(DigitalOutPin, LOW);
   }
+}
 
-
+// Stimulator on the Synapse 1 port
+void stimulator() {
   // Set DigiOut level if Array_DigiOutMode[NeuronBehaviour] is not 0
   if (Array_DigiOutMode[NeuronBehaviour]==1){ // if in Step Mode
     if (DigiOutStep<Stimulator_Val){
@@ -266,11 +621,240 @@ void loop(void) {
     } // the *2 sets duty cycle to 50 %. higher multipliers reduce duty cycle
   }
   if (Array_DigiOutMode[NeuronBehaviour]==2){ // if in Noise Mode
-    int randNumber = random(100);
-    if (randNumber<50) {digitalWriteHelper(DigitalIn1Pin, LOW); Stim_State = 0;}
-    if (randNumber>=50) {digitalWriteHelper(DigitalIn1Pin, HIGH); Stim_State = 1;}
+    Stim_State = noiseBit(&Noise);
+    digitalWriteHelper(DigitalIn1Pin, Stim_State ? HIGH : LOW);
+  }
+}
+
+// Send the events of one output record as binary frames (SerialMode = 2)
+void formatEvents(const output_t* o, void (*send)(const uint8_t*, uint16_t)) {
+  spikeevent_t sp;
+  stateevent_t st;
+
+  if (o->Spike) {
+    // spike, at the 30 mV crossing between the previous step and this one
+    sp.step = EventStep;
+    sp.t_us = EventPrevMicros + (uint32_t)(o->SpikeFrac * (o->currentMicros - EventPrevMicros));
+    sp.frac = (uint16_t)(o->SpikeFrac * 65535.0);
+    send(FrameBuf, frameBuild(FrameBuf, FRAME_TYPE_SPIKE, FrameSeq++, &sp, sizeof(sp)));
+  }
+  st.step = EventStep;
+  st.t_us = o->currentMicros;
+  if (o->Stim_State != EventStim) {
+    EventStim = o->Stim_State;
+    st.value = (uint8_t)EventStim;
+    send(FrameBuf, frameBuild(FrameBuf, FRAME_TYPE_STIM, FrameSeq++, &st, sizeof(st)));
+  }
+  if (o->NeuronBehaviour != EventMode) {
+    EventMode = o->NeuronBehaviour;
+    st.value = (uint8_t)EventMode;
+    send(FrameBuf, frameBuild(FrameBuf, FRAME_TYPE_MODE, FrameSeq++, &st, sizeof(st)));
+  }
+  for (uint8_t i = 0; i < 2; i++) {
+    // synapse input pulses: counted in this step with USES_SYNAPSE_EDGES,
+    // else one when the polled input goes high
+    int n = (i == 0) ? o->SpikeIn1State : o->SpikeIn2State;
+    #ifndef USES_SYNAPSE_EDGES
+      int level = n;
+      n = (level > 0) && (EventSyn[i] == 0);
+      EventSyn[i] = level;
+    #endif
+    if (n > 0) {
+      st.t_us = (i == 0) ? o->SpikeIn1Micros : o->SpikeIn2Micros;
+      st.value = (uint8_t)n;
+      send(FrameBuf, frameBuild(FrameBuf, (i == 0) ? FRAME_TYPE_SYN1 : FRAME_TYPE_SYN2, FrameSeq++, &st, sizeof(st)));
+    }
+  }
+  if ((EventSummaryEvery > 0) && (EventStep % EventSummaryEvery == 0)) {
+    // low-rate summary with the continuous values
+    packSample(&Sample, o);
+    send(FrameBuf, frameBuild(FrameBuf, FRAME_TYPE_SAMPLE, FrameSeq++, &Sample, sizeof(Sample)));
+  }
+  EventPrevMicros = o->currentMicros;
+  EventStep++;
+}
+
+// Send the pending delta frame of the compressed stream, if any
+void flushDelta(void (*send)(const uint8_t*, uint16_t)) {
+  if (DeltaEnc.n > 0) {
+    send(FrameBuf, frameBuild(FrameBuf, FRAME_TYPE_DELTA, FrameSeq++, DeltaEnc.block, DeltaEnc.len));
+    deltaBlockSent(&DeltaEnc);
+  }
+}
+
+// Add one output record to the compressed stream (SerialMode = 3)
+void formatDelta(const output_t* o, void (*send)(const uint8_t*, uint16_t)) {
+  if (deltaKeyDue(&DeltaEnc, KeyFrameEvery)) {
+    // pending delta frame first, then the absolute values
+    flushDelta(send);
+    deltaKey(&DeltaEnc, o, &KeySample);
+    send(FrameBuf, frameBuild(FrameBuf, FRAME_TYPE_KEY, FrameSeq++, &KeySample, sizeof(KeySample)));
+    return;
+  }
+  deltaAppend(&DeltaEnc, o);
+  if ((DeltaEnc.n >= DeltaBlockSamples) || (DeltaEnc.len > DELTA_BLOCK_BYTES - DELTA_RECORD_MAX)) {
+    flushDelta(send);
+  }
+}
+
+#ifdef USES_STA
+// Read commands sent over serial: K requests the on-board STA, R restarts it
+void serviceCommands() {
+  while (Serial.available() > 0) {
+    int c = Serial.read();
+    if ((c == 'K') || (c == 'k')) {StaReportDue = true;}
+    if ((c == 'R') || (c == 'r')) {StaResetDue = true;}
+  }
+}
+
+// Add one model step to the on-board STA and start a report when one is due.
+// Called in the model step, so that with USES_DUAL_CORE every step is added,
+// also those that do not fit into the output ring. All parts of a report come
+// from the same sums: with USES_DUAL_CORE the sender reads a copy made here
+// (StaSending hands it over and back), otherwise no spikes are added while a
+// report is running
+void staStep(const output_t* o) {
+  boolean noise = (Array_DigiOutMode[o->NeuronBehaviour]==2);
+
+  if (StaResetDue || (o->NeuronBehaviour != StaMode)) {
+    staInit(&Sta);
+    StaMode = o->NeuronBehaviour;
+    StaResetDue = false;
+    StaReportMicros = o->currentMicros;
+    #ifndef USES_DUAL_CORE
+      StaSending = false; // (the running report read the cleared sums)
+    #endif
+  }
+  if (noise) {
+    #ifdef USES_DUAL_CORE
+      boolean spike = o->Spike;
+    #else
+      boolean spike = o->Spike && !StaSending; // (the report reads Sta)
+    #endif
+    staAdd(&Sta, o->Stim_State, o->I_PD, spike, o->currentMicros);
+  }
+  if (!StaSending && (StaReportDue || (noise && (StaReportEvery > 0) &&
+      (o->currentMicros - StaReportMicros >= StaReportEvery * 1000000UL)))) {
+    StaReportDue = false;
+    StaReportMicros = o->currentMicros;
+    #ifdef USES_DUAL_CORE
+      StaCopy = Sta;
+    #endif
+    StaNext = 0;
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    StaSending = true;    // hands StaNext and StaCopy to the sender
+  }
+}
+
+// Send the next part of a running report (on the I/O core with
+// USES_DUAL_CORE): one frame with STA_FRAME_POINTS points per output record,
+// or with SerialMode = 0 one line "STA:point, stim, I_PD" (means) per record
+// after a line "STA spikes:n"
+void staSend(void (*send)(const uint8_t*, uint16_t)) {
+  uint8_t payload[STA_FRAME_MAX_LEN];
+
+  if (!StaSending) {return;}
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  int next = StaNext;
+
+  if (SerialMode==0) {
+    float scale = (StaOut->spikes > 0) ? 1.0 / StaOut->spikes : 0.0;
+    SampleStr = "";
+    if (next == 0) {
+      SampleStr += "STA spikes:";
+      SampleStr += StaOut->spikes;
+      SampleStr += "\r\n";
+    }
+    SampleStr += "STA:";
+    SampleStr += next;
+    SampleStr += ", ";
+    SampleStr += StaOut->stim[next] * scale;
+    SampleStr += ", ";
+    SampleStr += StaOut->pd[next] * scale / STA_PD_SCALE;
+    SampleStr += "\r\n";
+    send((const uint8_t*)SampleStr.c_str(), SampleStr.length());
+    next++;
   }
+  else {
+    uint8_t len = staFrame(StaOut, next, payload);
+    send(FrameBuf, frameBuild(FrameBuf, FRAME_TYPE_STA, FrameSeq++, payload, len));
+    next += STA_FRAME_POINTS;
+  }
+  StaNext = next;
+  if (next >= STA_POINTS) {
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    StaSending = false;   // (back to the model core)
+  }
+}
+#endif
+
+// Format one output record as binary frame or ASCII line and pass it to `send`
+void formatSample(const output_t* o, void (*send)(const uint8_t*, uint16_t)) {
+  // Records dropped before formatting (output ring full with USES_DUAL_CORE)
+  unsigned long dropped = o->Seq - FormatSeq;
+  FormatSeq = o->Seq + 1;
+  #ifdef USES_STA
+    staSend(send);
+  #endif
+  if (SerialMode==4){
+    // On-board STA only (see above)
+  }
+  else if ((SerialMode==3) && (FastMode<3)){
+    // Compressed continuous values
+    formatDelta(o, send);
+  }
+  else if ((SerialMode==2) && (FastMode<3)){
+    // Events only
+    formatEvents(o, send);
+  }
+  else if ((SerialMode==1) && (FastMode<3)){
+    // Binary frame with all model parameters; dropped records leave a gap in
+    // the frame numbers, so that the receiver counts them as lost
+    FrameSeq += (uint16_t)dropped;
+    packSample(&Sample, o);
+    send(FrameBuf, frameBuild(FrameBuf, FRAME_TYPE_SAMPLE, FrameSeq++, &Sample, sizeof(Sample)));
+  }
+  else {
+    if (FastMode<3){
+      // Oscilloscope 1
+      SampleStr  = o->v;               // Ch1: voltage
+      SampleStr += ", ";
+    }
+    if (FastMode<2){
+      SampleStr += o->I_total;         // Ch2: Total input current
+      SampleStr += ", ";
+      SampleStr += o->Stim_State;      // Ch3: Internal Stimulus State (if Synapse 1 mode >0)
+      SampleStr += ", ";
+    }
+    if (FastMode<1){
+      // Oscilloscope 2
+      SampleStr += o->SpikeIn1State;   // Ch4: State of Synapse 1 (High/Low)
+      SampleStr += ", ";
+      SampleStr += o->SpikeIn2State;   // Ch5: State of Synapse 2 (High/Low)
+      SampleStr += ", ";
+      SampleStr += o->I_PD;            // Ch6: Total Photodiode current
+      SampleStr += ", ";
+
+      // Oscilloscope 3
+      SampleStr += o->I_AnalogIn;      // Ch7: Total Analog In current
+      SampleStr += ", ";
+      SampleStr += o->I_Synapse;       // Ch8: Total Synaptic Current
+      SampleStr += ", ";
+    }
+    if (FastMode<3){
+      SampleStr += o->currentMicros;   // Ch9: System Time in us
+      if (SerialSeq>0){
+        SampleStr += ", ";
+        SampleStr += o->Seq;           // last column: record number
+      }
+      SampleStr += "\r\r\n";          // same line end as Serial.println(... "\r")
+      send((const uint8_t*)SampleStr.c_str(), SampleStr.length());
+    }
+  }
+}
 
+// Send the model parameters via serial
+void sendSample(unsigned long currentMicros, int TickMissed) {
   // Serial output in order
 
 /*if (FastMode<3){
@@ -304,52 +888,162 @@ void loop(void) {
     Serial.println("\r");
   }*/
 
-  if (FastMode<3){
-    // Oscilloscope 1
-    OutputStr  = v;               // Ch1: voltage
-    OutputStr += ", ";
+  Output.v = v;
+  Output.I_total = I_total;
+  Output.I_PD = I_PD;
+  Output.I_AnalogIn = I_AnalogIn;
+  Output.I_Synapse = I_Synapse;
+  Output.Stim_State = Stim_State;
+  Output.SpikeIn1State = SpikeIn1State;
+  Output.SpikeIn2State = SpikeIn2State;
+  Output.currentMicros = currentMicros;
+  Output.NeuronBehaviour = NeuronBehaviour;
+  Output.TickMissed = TickMissed;
+  Output.Spike = ModelSpike;
+  Output.SpikeFrac = SpikeFrac;
+  Output.Seq = OutputSeq++;
+  #ifdef USES_SYNAPSE_EDGES
+    Output.SpikeIn1Micros = currentMicros - SpikeIn1Age;
+    Output.SpikeIn2Micros = currentMicros - SpikeIn2Age;
+  #else
+    Output.SpikeIn1Micros = currentMicros;
+    Output.SpikeIn2Micros = currentMicros;
+  #endif
+  #ifdef USES_STA
+    staStep(&Output);
+  #endif
+
+  #ifdef USES_DUAL_CORE
+    // formatted and sent on the I/O core (see serviceIO())
+    if (!rrPush(&OutputRing, &Output)) {DroppedOutputs++;}
+  #else
+    formatSample(&Output, sendOutput);
+  #endif
+}
+
+#ifdef USES_DUAL_CORE
+// Send queued messages and output records, and update the display (runs on
+// the I/O core); returns false if there was nothing to do
+bool serviceIO() {
+  uint8_t  buf[64];
+  uint16_t n;
+  output_t rec;
+  bool     busy = false;
+
+  while ((n = rbRead(&SerialQueue, buf, sizeof(buf))) > 0) {
+    Serial.write(buf, n);
+    busy = true;
   }
-  if (FastMode<2){
-    OutputStr += I_total;         // Ch2: Total input current
-    OutputStr += ", ";
-    OutputStr += Stim_State;      // Ch3: Internal Stimulus State (if Synapse 1 mode >0)
-    OutputStr += ", ";
+  #ifdef USES_STA
+    serviceCommands();
+  #endif
+  for (int i = 0; (i < 32) && rrPop(&OutputRing, &rec); i++) {
+    formatSample(&rec, writeSerial);
+    #ifdef USES_PLOTTING
+      plot(&rec);
+    #endif
+    busy = true;
   }
-  if (FastMode<1){
-    // Oscilloscope 2
-    OutputStr += SpikeIn1State;   // Ch4: State of Synapse 1 (High/Low)
-    OutputStr += ", ";
-    OutputStr += SpikeIn2State;   // Ch5: State of Synapse 2 (High/Low)
-    OutputStr += ", ";
-    OutputStr += I_PD;            // Ch6: Total Photodiode current
-    OutputStr += ", ";
+  #ifdef USES_PLOTTING
+    serviceTouch();
+  #endif
+  return busy;
+}
+#endif
 
-    // Oscilloscope 3
-    OutputStr += I_AnalogIn;      // Ch7: Total Analog In current
-    OutputStr += ", ";
-    OutputStr += I_Synapse;       // Ch8: Total Synaptic Current
-    OutputStr += ", ";
-  }
-  if (FastMode<3){
-    OutputStr += currentMicros;   // Ch9: System Time in us
-    OutputStr += "\r";
-    Serial.println(OutputStr);
+////////////////////////////////////////////////////////////////////////////
+// MAIN ////////////////////////////////////////////////////////////////////
+////////////////////////////////////////////////////////////////////////////
+
+// One model step; returns false if the next model tick is not due yet
+bool loopStep() {
+  unsigned long currentMicros;
+  int TickMissed = 0;
+
+  #ifdef USES_MODEL_TICK
+    // Wait for the next tick; meanwhile, send serial output and check the button
+    uint32_t Tick = ModelTick_count();
+    if (Tick == LastTick) {
+      #ifndef USES_DUAL_CORE
+        serviceSerial();
+        serviceButton();
+      #endif
+      return false;
+    }
+    if (Tick - LastTick > 1) {
+      MissedTicks += Tick - LastTick - 1;
+      TickMissed = 1;
+    }
+    LastTick = Tick;
+    currentMicros = Tick * TickPeriod_us; // uniform system time
+  #else
+    // check system time in microseconds
+    currentMicros = micros() - startMicros;
+  #endif
+
+  // which inputs to read in this step (see InputDivisor)
+  InputsDue = schedNext(&Sched);
+
+  #if !defined(USES_MODEL_TICK) || defined(USES_DUAL_CORE)
+    // read button to change spike model
+    PROFILE_STAGE(STAGE_BUTTON, serviceButton());
+  #endif
+  #if defined(USES_STA) && !defined(USES_DUAL_CORE)
+    // commands for the on-board STA (on the I/O core with USES_DUAL_CORE)
+    serviceCommands();
+  #endif
+
+  // Stages of one model step (timed if USES_STAGE_PROFILING is defined)
+  PROFILE_STAGE(STAGE_ADC,        readInputs());
+  PROFILE_STAGE(STAGE_PD_FILTER,  filterPD());
+  PROFILE_STAGE(STAGE_CURRENTS,   computeCurrents());
+  PROFILE_STAGE(STAGE_IZHIKEVICH, computeModel());
+  PROFILE_STAGE(STAGE_OUTPUTS,    writeOutputs());
+  PROFILE_STAGE(STAGE_STIMULATOR, stimulator());
+  PROFILE_STAGE(STAGE_SERIAL,     sendSample(currentMicros, TickMissed));
+
+  // Report achieved model rate, if requested
+  if (schedRate(&Sched, millis(), (RateReport>0) ? RateReport*1000L : 1000L) && (RateReport>0)) {
+    OutputStr  = "Model rate:";
+    OutputStr += Sched.rateHz;
+    #ifdef USES_MODEL_TICK
+      OutputStr += "\r\nMissed ticks:";
+      OutputStr += MissedTicks;
+      OutputStr += "\r\nDropped outputs:";
+      OutputStr += DroppedOutputs;
+    #endif
+    OutputStr += "\r\n";
+    sendOutput((const uint8_t*)OutputStr.c_str(), OutputStr.length());
   }
 
-  #ifdef USES_PLOTTING
-    // Plot data if display is connected
-    //
-    Output.v = v;
-    Output.I_total = I_total;
-    Output.I_PD = I_PD;
-    Output.I_AnalogIn = I_AnalogIn;
-    Output.I_Synapse = I_Synapse;
-    Output.Stim_State = Stim_State;
-    Output.SpikeIn1State = SpikeIn1State;
-    Output.SpikeIn2State = SpikeIn2State;
-    Output.currentMicros = currentMicros;
-    Output.NeuronBehaviour = NeuronBehaviour;
-    plot(&Output);
+  #ifdef USES_STAGE_PROFILING
+    // Send stage timing every PROFILE_REPORT_EVERY steps
+    if (StageProf[STAGE_ADC].calls >= PROFILE_REPORT_EVERY) {
+      reportProfile();
+    }
+  #endif
+  return true;
+}
+
+#ifdef USES_DUAL_CORE
+// Model task, woken up by each model tick (see Settings file)
+void loopStepTask() {
+  loopStep();
+}
+#endif
+
+void loop(void) {
+  #ifdef USES_DUAL_CORE
+    // model and I/O run in their own tasks (started in setup())
+    vTaskDelete(NULL);
+  #else
+    if (loopStep()) {
+      #ifdef USES_PLOTTING
+        // Plot data if display is connected
+        //
+        PROFILE_STAGE(STAGE_PLOT, plot(&Output));
+      #endif
+    }
   #endif
 }
 
@@ -0,0 +1,122 @@
+// -----------------------------------------------------------------------------
+// Spike-triggered average (STA) computed on the board (USES_STA)
+//
+// While the Synapse 1 port generates binary noise (Array_DigiOutMode = 2),
+// every model step is added to a ring of the last STA_POINTS steps
+// (Stim_State and I_PD); at each spike (model reset), the ring is added to
+// the kernel sums. Point j of the kernel is the step STA_POINTS -j before the
+// spike step, as in "Host tools/spikeling_online". Spikes before the ring was
+// filled once are not counted.
+//
+// The sums are sent as they are (FRAME_TYPE_STA frames, or "STA" lines in
+// ASCII mode); the mean is sum /spikes. I_PD is kept in units of
+// 1/STA_PD_SCALE as int16_t (clipped to +-3276.7), so that the sums are exact
+// and the same on all targets; they overflow after roughly 2^31 /(10 *|I_PD|)
+// spikes.
+//
+// This header is shared with the host-side decoder ("Host tools" folder) and
+// therefore must not depend on the Arduino libraries.
+// -----------------------------------------------------------------------------
+#ifndef  StaKernel_h
+#define  StaKernel_h
+
+#include <stdint.h>
+#include <string.h>
+
+#ifndef  STA_POINTS
+  #define STA_POINTS        32    // set in the Settings file
+#endif
+#define  STA_PD_SCALE       10    // I_PD in units of 0.1
+#define  STA_FRAME_POINTS   10    // kernel points per frame
+
+// Frame payload (FRAME_TYPE_STA): staheader_t, followed by up to
+// STA_FRAME_POINTS stapoint_t for the points first, first+1, ...
+//
+typedef struct __attribute__((packed)) {
+  uint32_t spikes;                // spikes in the sums
+  uint32_t t_us;                  // currentMicros of the last step added
+  uint16_t points;                // STA_POINTS
+  uint16_t first;                 // index of the first point in this frame
+  } staheader_t;
+
+typedef struct __attribute__((packed)) {
+  uint32_t stim;                  // spikes with Stim_State = 1 at this point
+  int32_t  pd;                    // sum of I_PD, in units of 1/STA_PD_SCALE
+  } stapoint_t;
+
+#define  STA_FRAME_MAX_LEN  (sizeof(staheader_t) +STA_FRAME_POINTS*sizeof(stapoint_t))
+
+typedef struct {
+  uint8_t  ringStim[STA_POINTS];
+  int16_t  ringPD[STA_POINTS];
+  uint16_t pos;                   // oldest entry of the ring
+  uint16_t filled;                // entries in the ring (up to STA_POINTS)
+  uint32_t stim[STA_POINTS];      // kernel sums
+  int32_t  pd[STA_POINTS];
+  uint32_t spikes;
+  uint32_t t_us;
+  } sta_t;
+
+// -----------------------------------------------------------------------------
+static inline void staInit(sta_t* s)
+{
+  memset(s, 0, sizeof(sta_t));
+}
+
+static inline int16_t staQuantizePD(float I_PD)
+{
+  float x = I_PD *STA_PD_SCALE;
+  if(x >  32767.0f) return  32767;
+  if(x < -32767.0f) return -32767;
+  return (int16_t)((x < 0) ? x -0.5f : x +0.5f);
+}
+
+// Add one model step; `spike` is the model reset in this step. The ring is
+// added before the step itself, so the kernel ends with the step before the
+// spike.
+//
+static inline void staAdd(sta_t* s, uint8_t stim, float I_PD, uint8_t spike,
+                          uint32_t t_us)
+{
+  if(spike && (s->filled == STA_POINTS)) {
+    uint16_t i = s->pos;
+    for(uint16_t j=0; j<STA_POINTS; j++) {
+      s->stim[j] += s->ringStim[i];
+      s->pd[j]   += s->ringPD[i];
+      if(++i == STA_POINTS) i = 0;
+    }
+    s->spikes++;
+  }
+  s->ringStim[s->pos] = stim ? 1 : 0;
+  s->ringPD[s->pos]   = staQuantizePD(I_PD);
+  if(++s->pos == STA_POINTS) s->pos = 0;
+  if(s->filled < STA_POINTS) s->filled++;
+  s->t_us = t_us;
+}
+
+// Payload of the frame with the points from `first` on; returns its length
+// (0 if `first` is past the end)
+//
+static inline uint8_t staFrame(const sta_t* s, uint16_t first, uint8_t* buf)
+{
+  staheader_t h;
+  stapoint_t  p;
+  uint8_t     n;
+
+  if(first >= STA_POINTS) return 0;
+  n = (STA_POINTS -first < STA_FRAME_POINTS) ? STA_POINTS -first : STA_FRAME_POINTS;
+  h.spikes = s->spikes;
+  h.t_us   = s->t_us;
+  h.points = STA_POINTS;
+  h.first  = first;
+  memcpy(buf, &h, sizeof(h));
+  for(uint8_t k=0; k<n; k++) {
+    p.stim = s->stim[first +k];
+    p.pd   = s->pd[first +k];
+    memcpy(buf +sizeof(h) +k*sizeof(p), &p, sizeof(p));
+  }
+  return sizeof(h) +n*sizeof(p);
+}
+
+#endif
+// -----------------------------------------------------------------------------
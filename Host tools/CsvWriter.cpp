@@ -0,0 +1,14 @@
+// -----------------------------------------------------------------------------
+#include "CsvWriter.h"
+
+// -----------------------------------------------------------------------------
+void writeCsvLine(FILE* f, const output_t& o, int precision)
+{
+  fprintf(f, "%.*f, %.*f, %d, %d, %d, %.*f, %.*f, %.*f, %lu\n",
+          precision, o.v, precision, o.I_total,
+          o.Stim_State, o.SpikeIn1State, o.SpikeIn2State,
+          precision, o.I_PD, precision, o.I_AnalogIn, precision, o.I_Synapse,
+          (unsigned long)o.currentMicros);
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,22 @@
+// -----------------------------------------------------------------------------
+// Writes model samples in the same comma-separated format as the firmware's
+// ASCII output (SerialMode = 0, FastMode = 0), i.e. the format expected by
+// "spikelingFunctions.m" and "Spikeling Analysis.ipynb":
+//
+//   v, I_total, Stim_State, SpikeIn1State, SpikeIn2State, I_PD, I_AnalogIn,
+//   I_Synapse, currentMicros
+// -----------------------------------------------------------------------------
+#ifndef  CsvWriter_h
+#define  CsvWriter_h
+
+#include <stdio.h>
+#include "Definitions.h"
+
+// Number of decimals the Arduino `String` class uses for floats
+//
+#define  CSV_DEFAULT_PRECISION  2
+
+void writeCsvLine(FILE* f, const output_t& o, int precision = CSV_DEFAULT_PRECISION);
+
+#endif
+// -----------------------------------------------------------------------------
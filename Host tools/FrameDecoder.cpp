@@ -0,0 +1,203 @@
+// -----------------------------------------------------------------------------
+#include <string.h>
+#include "FrameDecoder.h"
+
+// -----------------------------------------------------------------------------
+FrameDecoder::FrameDecoder()
+{
+  reset();
+}
+
+void FrameDecoder::reset()
+{
+  _buf.clear();
+  _pos     = 0;
+  _haveSeq = false;
+  _lastSeq = 0;
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+// -----------------------------------------------------------------------------
+void FrameDecoder::feed(const uint8_t* data, size_t len, const FrameHandler& onFrame)
+{
+  _buf.insert(_buf.end(), data, data +len);
+
+  while(_buf.size() -_pos >= FRAME_HEADER_LEN) {
+    const uint8_t* p = _buf.data() +_pos;
+
+    // Search for sync word
+    //
+    if((p[0] != FRAME_SYNC0) || (p[1] != FRAME_SYNC1)) {
+      _pos++;
+      _stats.bytesSkipped++;
+      continue;
+    }
+    // Wait for the complete frame
+    //
+    size_t n = FRAME_HEADER_LEN +p[3] +FRAME_CRC_LEN;
+    if(_buf.size() -_pos < n) {
+      break;
+    }
+    uint16_t crc = p[n -2] | (p[n -1] << 8);
+    if(crc16(p +2, n -2 -FRAME_CRC_LEN) != crc) {
+      // Not a valid frame (or a corrupted one); skip sync and try again
+      //
+      _stats.crcErrors++;
+      _pos++;
+      _stats.bytesSkipped++;
+      continue;
+    }
+    Frame frame;
+    frame.type    = p[2];
+    frame.length  = p[3];
+    frame.seq     = p[4] | (p[5] << 8);
+    frame.payload = p +FRAME_HEADER_LEN;
+
+    // Check frame counter for lost frames
+    //
+    if(_haveSeq) {
+      uint16_t gap = (uint16_t)(frame.seq -_lastSeq -1);
+      if(gap > 0) {
+        _stats.seqGaps++;
+        _stats.framesLost += gap;
+      }
+    }
+    _haveSeq = true;
+    _lastSeq = frame.seq;
+    _stats.frames++;
+    onFrame(frame);
+    _pos += n;
+  }
+
+  // Drop consumed bytes
+  //
+  if(_pos > 0) {
+    _buf.erase(_buf.begin(), _buf.begin() +_pos);
+    _pos = 0;
+  }
+}
+
+// -----------------------------------------------------------------------------
+DeltaStreamDecoder::DeltaStreamDecoder()
+{
+  reset();
+}
+
+void DeltaStreamDecoder::reset()
+{
+  deltaInit(&_state);
+  _haveSeq       = false;
+  _lastSeq       = 0;
+  _framesSkipped = 0;
+}
+
+bool DeltaStreamDecoder::frame(const Frame& frame, const SampleHandler& onSample)
+{
+  output_t o;
+  bool     lost = _haveSeq && (frame.seq != (uint16_t)(_lastSeq +1));
+
+  // Other frames (e.g. the on-board STA) count for the sequence, too
+  //
+  _haveSeq = true;
+  _lastSeq = frame.seq;
+  if((frame.type != FRAME_TYPE_KEY) && (frame.type != FRAME_TYPE_DELTA)) {
+    return false;
+  }
+  memset(&o, 0, sizeof(o));
+
+  // A lost frame breaks the chain of differences
+  //
+  if(lost) {
+    _state.valid = false;
+  }
+
+  if(frame.type == FRAME_TYPE_KEY) {
+    keysample_t k;
+    if(frame.length != sizeof(k)) {
+      _state.valid = false;
+      return true;
+    }
+    memcpy(&k, frame.payload, sizeof(k));
+    deltaDecodeKey(&_state, &k, &o);
+    onSample(o);
+    return true;
+  }
+  if(!_state.valid) {
+    _framesSkipped++;
+    return true;
+  }
+  const uint8_t* p   = frame.payload;
+  const uint8_t* end = frame.payload +frame.length;
+  while(p < end) {
+    if((p = deltaDecodeRecord(&_state, p, end, &o)) == NULL) {
+      _state.valid = false;
+      break;
+    }
+    onSample(o);
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+bool decodeSample(const Frame& frame, output_t* out)
+{
+  sample_t s;
+
+  if((frame.type != FRAME_TYPE_SAMPLE) || (frame.length != sizeof(sample_t))) {
+    return false;
+  }
+  memcpy(&s, frame.payload, sizeof(s));
+  unpackSample(out, &s);
+  return true;
+}
+
+bool decodeEvent(const Frame& frame, Event* ev)
+{
+  spikeevent_t sp;
+  stateevent_t st;
+
+  if((frame.type == FRAME_TYPE_SPIKE) && (frame.length == sizeof(sp))) {
+    // the spike happened between step-1 and step
+    memcpy(&sp, frame.payload, sizeof(sp));
+    ev->type  = frame.type;
+    ev->step  = sp.step -1 +sp.frac /65535.0;
+    ev->t_us  = sp.t_us;
+    ev->value = 0;
+    return true;
+  }
+  if(((frame.type == FRAME_TYPE_STIM) || (frame.type == FRAME_TYPE_MODE) ||
+      (frame.type == FRAME_TYPE_SYN1) || (frame.type == FRAME_TYPE_SYN2)) &&
+     (frame.length == sizeof(st))) {
+    memcpy(&st, frame.payload, sizeof(st));
+    ev->type  = frame.type;
+    ev->step  = st.step;
+    ev->t_us  = st.t_us;
+    ev->value = st.value;
+    return true;
+  }
+  return false;
+}
+
+bool decodeSta(const Frame& frame, StaPart* part)
+{
+  staheader_t h;
+  size_t      n;
+
+  if((frame.type != FRAME_TYPE_STA) || (frame.length < sizeof(h)) ||
+     ((frame.length -sizeof(h)) % sizeof(stapoint_t) != 0)) {
+    return false;
+  }
+  memcpy(&h, frame.payload, sizeof(h));
+  n = (frame.length -sizeof(h)) /sizeof(stapoint_t);
+  if(h.first +n > h.points) return false;
+
+  part->spikes = h.spikes;
+  part->t_us   = h.t_us;
+  part->points = h.points;
+  part->first  = h.first;
+  part->sums.resize(n);
+  memcpy(part->sums.data(), frame.payload +sizeof(h), n *sizeof(stapoint_t));
+  return true;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,115 @@
+// -----------------------------------------------------------------------------
+// Streaming decoder for the binary framed serial protocol (see SerialFrame.h)
+//
+// Bytes can be fed in arbitrary portions; complete frames with a valid CRC
+// are handed to a callback. After a CRC error, the decoder resynchronises by
+// searching for the next sync word.
+// -----------------------------------------------------------------------------
+#ifndef  FrameDecoder_h
+#define  FrameDecoder_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <functional>
+#include <vector>
+#include "SerialFrame.h"
+#include "DeltaStream.h"
+#include "StaKernel.h"
+
+// -----------------------------------------------------------------------------
+struct Frame {
+  uint8_t        type;
+  uint8_t        length;
+  uint16_t       seq;
+  const uint8_t* payload;
+};
+
+struct FrameStats {
+  uint64_t       frames;        // valid frames
+  uint64_t       crcErrors;     // frames dropped because of a wrong CRC
+  uint64_t       bytesSkipped;  // bytes discarded while searching for sync
+  uint64_t       seqGaps;       // number of discontinuities in `seq`
+  uint64_t       framesLost;    // frames missing according to `seq`
+};
+
+// Event from an event frame (SerialMode = 2)
+//
+struct Event {
+  uint8_t        type;          // FRAME_TYPE_SPIKE, _STIM, _MODE, _SYN1 or _SYN2
+  double         step;          // model step, with the fraction for spikes
+  uint32_t       t_us;          // time in us
+  int            value;         // stimulator state, neuron mode or number of
+                                // synapse input pulses; 0 for spikes
+};
+
+// Part of the on-board STA (FRAME_TYPE_STA, see StaKernel.h): the sums of
+// the points first .. first +sums.size() -1 of a kernel of `points` points
+//
+struct StaPart {
+  uint32_t       spikes;
+  uint32_t       t_us;
+  uint16_t       points;
+  uint16_t       first;
+  std::vector<stapoint_t> sums;
+};
+
+typedef std::function<void(const Frame&)> FrameHandler;
+typedef std::function<void(const output_t&)> SampleHandler;
+
+// -----------------------------------------------------------------------------
+class FrameDecoder
+{
+public:
+  FrameDecoder();
+
+  void               feed(const uint8_t* data, size_t len, const FrameHandler& onFrame);
+  void               reset();
+  const FrameStats&  stats() const { return _stats; }
+
+private:
+  std::vector<uint8_t> _buf;
+  size_t             _pos;
+  bool               _haveSeq;
+  uint16_t           _lastSeq;
+  FrameStats         _stats;
+};
+
+// -----------------------------------------------------------------------------
+// Reassembles the samples of a compressed stream (SerialMode = 3, see
+// DeltaStream.h) from key and delta frames. After a lost or damaged frame,
+// delta frames are skipped until the next key frame.
+// -----------------------------------------------------------------------------
+class DeltaStreamDecoder
+{
+public:
+  DeltaStreamDecoder();
+
+  // Returns false for frames that are not part of a compressed stream
+  bool               frame(const Frame& frame, const SampleHandler& onSample);
+  void               reset();
+  uint64_t           framesSkipped() const { return _framesSkipped; }
+
+private:
+  deltastate_t       _state;
+  bool               _haveSeq;
+  uint16_t           _lastSeq;        // of any frame passed to frame()
+  uint64_t           _framesSkipped;  // delta frames without preceding key frame
+};
+
+// Decode the payload of a FRAME_TYPE_SAMPLE frame; returns false for other
+// frame types or a wrong payload length
+//
+bool decodeSample(const Frame& frame, output_t* out);
+
+// Decode the payload of a FRAME_TYPE_SPIKE, _STIM, _MODE, _SYN1 or _SYN2 frame; returns
+// false for other frame types or a wrong payload length
+//
+bool decodeEvent(const Frame& frame, Event* ev);
+
+// Decode the payload of a FRAME_TYPE_STA frame; returns false for other
+// frame types or an inconsistent payload
+//
+bool decodeSta(const Frame& frame, StaPart* part);
+
+#endif
+// -----------------------------------------------------------------------------
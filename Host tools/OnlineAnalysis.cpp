@@ -0,0 +1,148 @@
+// -----------------------------------------------------------------------------
+#include <algorithm>
+#include "OnlineAnalysis.h"
+
+// -----------------------------------------------------------------------------
+OnlineAnalysis::OnlineAnalysis(const OnlineOptions& opt) : _opt(opt)
+{
+  _opt.staPoints = std::max(1, _opt.staPoints);
+  _opt.psthBin   = std::max(1, _opt.psthBin);
+  _n = _nSpikes = _nSta = _nOnsets = 0;
+  _t0 = _t1   = 0;
+  _lastMicros = 0;
+  _vPrev      = 0;
+  _stimPrev   = 0;
+  _ringStim.assign(_opt.staPoints, 0);
+  _ringI.assign(_opt.staPoints, 0);
+  _ringPos    = 0;
+  _staStim.assign(_opt.staPoints, 0);
+  _staI.assign(_opt.staPoints, 0);
+  _loopLen    = _opt.loopLen;
+  _pos        = 0;
+  _inLoop     = false;
+  if(_loopLen > 0) growLoop(_loopLen);
+}
+
+void OnlineAnalysis::growLoop(int64_t len)
+{
+  _sumV.resize(len, 0);
+  _sumI.resize(len, 0);
+  _sumStim.resize(len, 0);
+  _count.resize(len, 0);
+  _psthSpikes.resize((len +_opt.psthBin -1) /_opt.psthBin, 0);
+}
+
+double OnlineAnalysis::sampleInterval() const
+{
+  return (_n > 1) ? (_t1 -_t0) *1e-6 /(_n -1) : 0;
+}
+
+// -----------------------------------------------------------------------------
+void OnlineAnalysis::add(const output_t& o)
+{
+  bool spike = (_n > 0) && (_vPrev < _opt.thresh) && (o.v > _opt.thresh);
+  bool onset = (_n > 0) && (o.Stim_State > _stimPrev);
+
+  // currentMicros wraps after 71.6 min; add the (signed 32-bit) step instead
+  uint32_t t = (uint32_t)o.currentMicros;
+  if(_n == 0) _t0 = _t1 = t;
+  else _t1 += (int32_t)(t -_lastMicros);
+  _lastMicros = t;
+
+  // STA over the samples before this one (once the window is filled)
+  //
+  if(spike) {
+    _nSpikes++;
+    if(_n >= (uint64_t)_opt.staPoints) {
+      int n1 = _opt.staPoints -_ringPos;
+      for(int j=0; j<n1; j++) {
+        _staStim[j] += _ringStim[_ringPos +j];
+        _staI[j]    += _ringI[_ringPos +j];
+      }
+      for(int j=0; j<_ringPos; j++) {
+        _staStim[n1 +j] += _ringStim[j];
+        _staI[n1 +j]    += _ringI[j];
+      }
+      _nSta++;
+    }
+  }
+  _ringStim[_ringPos] = (float)o.Stim_State;
+  _ringI[_ringPos]    = o.I_total;
+  if(++_ringPos == _opt.staPoints) _ringPos = 0;
+
+  // Loops
+  //
+  if(onset) {
+    if(_inLoop && (_loopLen == 0)) {
+      // the first loop defines the length
+      _loopLen = std::max<int64_t>(1, _pos);
+      growLoop(_loopLen);
+    }
+    _nOnsets++;
+    _inLoop = true;
+    _pos    = 0;
+  }
+  if(_inLoop) {
+    if((_loopLen == 0) && (_pos < _opt.maxLoop) && (_pos >= (int64_t)_count.size())) {
+      growLoop(std::min<int64_t>(_opt.maxLoop, std::max<int64_t>(1024, _pos *2)));
+    }
+    if(_pos < (int64_t)_count.size() && ((_loopLen == 0) || (_pos < _loopLen))) {
+      _sumV[_pos]    += o.v;
+      _sumI[_pos]    += o.I_total;
+      _sumStim[_pos] += o.Stim_State;
+      _count[_pos]++;
+      if(spike) _psthSpikes[_pos /_opt.psthBin]++;
+    }
+    _pos++;
+  }
+
+  _vPrev    = o.v;
+  _stimPrev = o.Stim_State;
+  _n++;
+}
+
+// -----------------------------------------------------------------------------
+void OnlineAnalysis::sta(std::vector<double>* stim, std::vector<double>* I_total) const
+{
+  double scale = (_nSta > 0) ? 1.0 /_nSta : 0;
+
+  stim->resize(_opt.staPoints);
+  I_total->resize(_opt.staPoints);
+  for(int j=0; j<_opt.staPoints; j++) {
+    (*stim)[j]    = _staStim[j] *scale;
+    (*I_total)[j] = _staI[j] *scale;
+  }
+}
+
+void OnlineAnalysis::loopMeans(std::vector<double>* v, std::vector<double>* I_total,
+                               std::vector<double>* stim) const
+{
+  int64_t len = (_loopLen > 0) ? _loopLen : std::min<int64_t>(_pos, _count.size());
+
+  v->resize(len);
+  I_total->resize(len);
+  stim->resize(len);
+  for(int64_t j=0; j<len; j++) {
+    double scale = (_count[j] > 0) ? 1.0 /_count[j] : 0;
+    (*v)[j]       = _sumV[j] *scale;
+    (*I_total)[j] = _sumI[j] *scale;
+    (*stim)[j]    = _sumStim[j] *scale;
+  }
+}
+
+void OnlineAnalysis::psth(std::vector<double>* rate) const
+{
+  int64_t len  = (_loopLen > 0) ? _loopLen : std::min<int64_t>(_pos, _count.size());
+  int64_t bins = (len +_opt.psthBin -1) /_opt.psthBin;
+  double  dt   = sampleInterval();
+
+  rate->assign(bins, 0);
+  for(int64_t b=0; b<bins; b++) {
+    // samples in this bin, summed over the loops
+    double n = 0;
+    for(int64_t j=b *_opt.psthBin; j<std::min(len, (b +1) *_opt.psthBin); j++) n += _count[j];
+    if((n > 0) && (dt > 0)) (*rate)[b] = _psthSpikes[b] /(n *dt);
+  }
+}
+
+// -----------------------------------------------------------------------------
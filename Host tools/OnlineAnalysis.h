@@ -0,0 +1,78 @@
+// -----------------------------------------------------------------------------
+// Streaming spike-triggered average (STA) and stimulus-locked averages, updated
+// with every sample as it arrives (see spikeling_online)
+//
+// Computes the same results as the last part of "Spikeling Analysis.ipynb",
+// but without keeping the recording: memory depends only on the window sizes.
+//   - STA of Stim_State and I_total over the `staPoints` samples before each
+//     spike (spikes: v rising through `thresh`)
+//   - mean v, I_total and Stim_State over the loops, aligned to the stimulus
+//     onsets (Stim_State rising), and the PSTH (spike rate in bins of
+//     `psthBin` samples). Without a given loop length, it is taken from the
+//     first two onsets, as in the notebook; samples after the first onset are
+//     collected up to `maxLoop` samples until then.
+// The results can be read at any time; the last loop is included as far as
+// it has come.
+// -----------------------------------------------------------------------------
+#ifndef  OnlineAnalysis_h
+#define  OnlineAnalysis_h
+
+#include <stdint.h>
+#include <vector>
+#include "Definitions.h"
+
+struct OnlineOptions {
+  double  thresh    = 10;       // spike threshold (mV)
+  int     staPoints = 200;      // STA window (samples before the spike)
+  int64_t loopLen   = 0;        // samples per loop, 0: from the first onsets
+  int64_t maxLoop   = 1000000;  // longest loop if loopLen is 0
+  int     psthBin   = 10;       // samples per PSTH bin
+};
+
+class OnlineAnalysis
+{
+public:
+  explicit OnlineAnalysis(const OnlineOptions& opt = OnlineOptions());
+
+  void               add(const output_t& o);
+
+  uint64_t           samples() const { return _n; }
+  uint64_t           spikes() const { return _nSpikes; }
+  uint64_t           staSpikes() const { return _nSta; }
+  uint64_t           onsets() const { return _nOnsets; }
+  int64_t            loopLength() const { return _loopLen; }
+  double             sampleInterval() const;  // mean, in s
+
+  // Mean of the STA window (index 0: staPoints samples before the spike)
+  void               sta(std::vector<double>* stim, std::vector<double>* I_total) const;
+  // Means over the loops, one value per sample of the loop
+  void               loopMeans(std::vector<double>* v, std::vector<double>* I_total,
+                               std::vector<double>* stim) const;
+  // Spike rate (Hz) per PSTH bin
+  void               psth(std::vector<double>* rate) const;
+
+private:
+  void               growLoop(int64_t len);
+
+  OnlineOptions      _opt;
+  uint64_t           _n, _nSpikes, _nSta, _nOnsets;
+  double             _t0, _t1;                  // first and last time (us, unwrapped)
+  uint32_t           _lastMicros;               // currentMicros of the last sample
+  float              _vPrev;
+  int                _stimPrev;
+
+  // STA: ring of the last staPoints samples and the sums
+  std::vector<float> _ringStim, _ringI;
+  int                _ringPos;
+  std::vector<double> _staStim, _staI;
+
+  // Loops: position in the current loop and sums per position
+  int64_t            _loopLen, _pos;
+  bool               _inLoop;
+  std::vector<double> _sumV, _sumI, _sumStim;
+  std::vector<uint32_t> _count;
+  std::vector<uint32_t> _psthSpikes;
+};
+
+#endif
+// -----------------------------------------------------------------------------
@@ -0,0 +1,459 @@
+// -----------------------------------------------------------------------------
+// Memory mapping uses the POSIX calls (Linux, macOS)
+// -----------------------------------------------------------------------------
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include "Recording.h"
+
+static const char* ColumnNames[REC_N_COLUMNS] = {
+  "time_us", "v", "I_total", "Stim_State", "SpikeIn1State", "SpikeIn2State",
+  "I_PD", "I_AnalogIn", "I_Synapse", "NeuronBehaviour", "TickMissed"
+};
+
+static inline size_t align8(size_t n)
+{
+  return (n +7) & ~(size_t)7;
+}
+
+// -----------------------------------------------------------------------------
+const char* recColumnName(int col)
+{
+  return ((col >= 0) && (col < REC_N_COLUMNS)) ? ColumnNames[col] : "";
+}
+
+int recColumnFind(const std::string& name)
+{
+  for(int i=0; i<REC_N_COLUMNS; i++) {
+    if(name == ColumnNames[i]) return i;
+  }
+  return -1;
+}
+
+size_t recColumnSize(int col)
+{
+  switch(col) {
+    case REC_COL_TIME:       return sizeof(uint64_t);
+    case REC_COL_V:
+    case REC_COL_I_TOTAL:
+    case REC_COL_I_PD:
+    case REC_COL_I_ANALOG:
+    case REC_COL_I_SYNAPSE:  return sizeof(float);
+    default:                 return sizeof(uint8_t);
+  }
+}
+
+uint32_t recBinSamples(uint32_t chunkSamples, int level)
+{
+  // (the finest level has at least 16 samples per bin, so that the
+  // summaries stay smaller than the samples)
+  uint32_t n = chunkSamples >> (REC_LEVEL_SHIFT *level);
+  return (n < (1u << REC_LEVEL_SHIFT)) ? (1u << REC_LEVEL_SHIFT) : n;
+}
+
+uint32_t recBins(uint32_t n, uint32_t binSamples)
+{
+  return (n +binSamples -1) /binSamples;
+}
+
+// Offsets within a chunk of `n` samples
+//
+static size_t columnOffset(uint32_t n, int col)
+{
+  size_t ofs = 0;
+  for(int j=0; j<col; j++) ofs += align8(n *recColumnSize(j));
+  return ofs;
+}
+
+static size_t summaryOffset(uint32_t chunkSamples, uint32_t n, int level, int col)
+{
+  size_t ofs = columnOffset(n, REC_N_COLUMNS);
+  for(int l=1; l<=level; l++) {
+    size_t size = align8(recBins(n, recBinSamples(chunkSamples, l)) *sizeof(rec_summary_t));
+    ofs += size *((l < level) ? REC_N_VALUES : (col -1));
+  }
+  return ofs;
+}
+
+static inline float columnValue(const void* data, int col, uint32_t i)
+{
+  if(recColumnSize(col) == sizeof(float)) return ((const float*)data)[i];
+  return ((const uint8_t*)data)[i];
+}
+
+static rec_summary_t summarise(const void* data, int col, uint32_t i0, uint32_t i1)
+{
+  rec_summary_t s;
+  double        sum = 0;
+
+  s.min = s.max = columnValue(data, col, i0);
+  for(uint32_t i=i0; i<i1; i++) {
+    float x = columnValue(data, col, i);
+    if(x < s.min) s.min = x;
+    if(x > s.max) s.max = x;
+    sum += x;
+  }
+  s.mean = (float)(sum /(i1 -i0));
+  return s;
+}
+
+// -----------------------------------------------------------------------------
+// Writer
+// -----------------------------------------------------------------------------
+RecordingWriter::RecordingWriter() : _f(NULL), _ok(false)
+{
+}
+
+RecordingWriter::~RecordingWriter()
+{
+  if(_f != NULL) close();
+}
+
+bool RecordingWriter::open(const char* fName, uint32_t chunkSamples)
+{
+  rec_header_t hdr;
+
+  if((_f = fopen(fName, "wb")) == NULL) {
+    return false;
+  }
+  _ok           = true;
+  _chunkSamples = chunkSamples;
+  _nSamples     = 0;
+  _lastMicros   = 0;
+  _wrap         = 0;
+  _n            = 0;
+  _pos          = 0;
+  _dir.clear();
+  _cols.resize(REC_N_COLUMNS);
+  for(int c=0; c<REC_N_COLUMNS; c++) {
+    _cols[c].assign(chunkSamples *recColumnSize(c), 0);
+  }
+  // Header is written again with the counts when closing
+  //
+  memset(&hdr, 0, sizeof(hdr));
+  return writeAligned(&hdr, sizeof(hdr));
+}
+
+void RecordingWriter::add(const output_t& o)
+{
+  uint64_t t = (uint32_t)o.currentMicros;
+  float    f;
+  uint8_t  b;
+
+  // Extend the 32-bit time of the firmware
+  //
+  if((_nSamples > 0) && (t +_wrap < _lastMicros) && (_lastMicros -(t +_wrap) > 0x80000000ULL)) {
+    _wrap += 0x100000000ULL;
+  }
+  t += _wrap;
+  _lastMicros = t;
+
+  memcpy(&_cols[REC_COL_TIME][_n *sizeof(t)], &t, sizeof(t));
+  f = o.v;          memcpy(&_cols[REC_COL_V][_n *sizeof(f)], &f, sizeof(f));
+  f = o.I_total;    memcpy(&_cols[REC_COL_I_TOTAL][_n *sizeof(f)], &f, sizeof(f));
+  f = o.I_PD;       memcpy(&_cols[REC_COL_I_PD][_n *sizeof(f)], &f, sizeof(f));
+  f = o.I_AnalogIn; memcpy(&_cols[REC_COL_I_ANALOG][_n *sizeof(f)], &f, sizeof(f));
+  f = o.I_Synapse;  memcpy(&_cols[REC_COL_I_SYNAPSE][_n *sizeof(f)], &f, sizeof(f));
+  b = (uint8_t)o.Stim_State;      _cols[REC_COL_STIM][_n] = b;
+  b = (uint8_t)o.SpikeIn1State;   _cols[REC_COL_SPIKE_IN1][_n] = b;
+  b = (uint8_t)o.SpikeIn2State;   _cols[REC_COL_SPIKE_IN2][_n] = b;
+  b = (uint8_t)o.NeuronBehaviour; _cols[REC_COL_MODE][_n] = b;
+  b = (uint8_t)o.TickMissed;      _cols[REC_COL_TICK_MISSED][_n] = b;
+
+  _nSamples++;
+  if(++_n == _chunkSamples) {
+    writeChunk();
+  }
+}
+
+bool RecordingWriter::writeAligned(const void* data, size_t len)
+{
+  static const uint8_t zero[8] = {0};
+  size_t               pad = align8(len) -len;
+
+  if(_ok && ((fwrite(data, 1, len, _f) != len) || (fwrite(zero, 1, pad, _f) != pad))) {
+    _ok = false;
+  }
+  _pos += len +pad;
+  return _ok;
+}
+
+void RecordingWriter::writeChunk()
+{
+  rec_chunk_t                ch;
+  std::vector<rec_summary_t> bins;
+
+  memset(&ch, 0, sizeof(ch));
+  ch.offset   = _pos;
+  ch.nSamples = _n;
+  memcpy(&ch.t0, &_cols[REC_COL_TIME][0], sizeof(ch.t0));
+  memcpy(&ch.t1, &_cols[REC_COL_TIME][(_n -1) *sizeof(ch.t1)], sizeof(ch.t1));
+
+  for(int c=0; c<REC_N_COLUMNS; c++) {
+    writeAligned(_cols[c].data(), _n *recColumnSize(c));
+  }
+  for(int l=1; l<=REC_N_LEVELS; l++) {
+    uint32_t binSamples = recBinSamples(_chunkSamples, l);
+    for(int c=1; c<REC_N_COLUMNS; c++) {
+      bins.clear();
+      for(uint32_t i=0; i<_n; i+=binSamples) {
+        bins.push_back(summarise(_cols[c].data(), c, i, std::min(i +binSamples, _n)));
+      }
+      writeAligned(bins.data(), bins.size() *sizeof(rec_summary_t));
+    }
+  }
+  for(int c=1; c<REC_N_COLUMNS; c++) {
+    ch.total[c -1] = summarise(_cols[c].data(), c, 0, _n);
+  }
+  _dir.push_back(ch);
+  _n = 0;
+}
+
+bool RecordingWriter::close()
+{
+  rec_header_t hdr;
+
+  if(_f == NULL) {
+    return false;
+  }
+  if(_n > 0) {
+    writeChunk();
+  }
+  memset(&hdr, 0, sizeof(hdr));
+  memcpy(hdr.magic, REC_MAGIC, sizeof(hdr.magic));
+  hdr.version      = REC_VERSION;
+  hdr.nColumns     = REC_N_COLUMNS;
+  hdr.chunkSamples = _chunkSamples;
+  hdr.nLevels      = REC_N_LEVELS;
+  hdr.nSamples     = _nSamples;
+  hdr.nChunks      = _dir.size();
+  hdr.dirOffset    = _pos;
+  writeAligned(_dir.data(), _dir.size() *sizeof(rec_chunk_t));
+
+  if(_ok && ((fseek(_f, 0, SEEK_SET) != 0) || (fwrite(&hdr, 1, sizeof(hdr), _f) != sizeof(hdr)))) {
+    _ok = false;
+  }
+  if(fclose(_f) != 0) {
+    _ok = false;
+  }
+  _f = NULL;
+  _cols.clear();
+  return _ok;
+}
+
+// -----------------------------------------------------------------------------
+// Reader
+// -----------------------------------------------------------------------------
+RecordingReader::RecordingReader() : _map(NULL), _size(0), _hdr(NULL), _dir(NULL)
+{
+}
+
+RecordingReader::~RecordingReader()
+{
+  close();
+}
+
+bool RecordingReader::open(const char* fName)
+{
+  struct stat st;
+  int         fd;
+  void*       map;
+
+  close();
+  if((fd = ::open(fName, O_RDONLY)) < 0) {
+    return false;
+  }
+  if((fstat(fd, &st) != 0) || ((size_t)st.st_size < sizeof(rec_header_t))) {
+    ::close(fd);
+    return false;
+  }
+  map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if(map == MAP_FAILED) {
+    return false;
+  }
+  _map  = (const uint8_t*)map;
+  _size = st.st_size;
+  _hdr  = (const rec_header_t*)_map;
+
+  if((memcmp(_hdr->magic, REC_MAGIC, sizeof(_hdr->magic)) != 0) ||
+     (_hdr->version != REC_VERSION) || (_hdr->nColumns != REC_N_COLUMNS) ||
+     (_hdr->nLevels != REC_N_LEVELS) || (_hdr->chunkSamples == 0) ||
+     (_hdr->dirOffset > _size) ||
+     (_hdr->nChunks > (_size -_hdr->dirOffset) /sizeof(rec_chunk_t))) {
+    close();
+    return false;
+  }
+  _dir = (const rec_chunk_t*)(_map +_hdr->dirOffset);
+
+  // Every chunk must lie before the directory; all but the last are full
+  //
+  uint64_t n = 0;
+  for(uint64_t k=0; k<_hdr->nChunks; k++) {
+    const rec_chunk_t& ch = _dir[k];
+    bool last = (k +1 == _hdr->nChunks);
+    if((ch.nSamples == 0) || (ch.nSamples > _hdr->chunkSamples) ||
+       (!last && (ch.nSamples != _hdr->chunkSamples)) || (ch.offset & 7) ||
+       (ch.offset > _hdr->dirOffset) ||
+       (summaryOffset(_hdr->chunkSamples, ch.nSamples, REC_N_LEVELS, REC_N_VALUES +1) >
+        _hdr->dirOffset -ch.offset)) {
+      close();
+      return false;
+    }
+    n += ch.nSamples;
+  }
+  if(n != _hdr->nSamples) {
+    close();
+    return false;
+  }
+  return true;
+}
+
+void RecordingReader::close()
+{
+  if(_map != NULL) {
+    munmap((void*)_map, _size);
+  }
+  _map  = NULL;
+  _size = 0;
+  _hdr  = NULL;
+  _dir  = NULL;
+}
+
+const void* RecordingReader::column(uint64_t k, int col) const
+{
+  return _map +_dir[k].offset +columnOffset(_dir[k].nSamples, col);
+}
+
+const rec_summary_t* RecordingReader::summary(uint64_t k, int level, int col, uint32_t* nBins) const
+{
+  *nBins = recBins(_dir[k].nSamples, recBinSamples(_hdr->chunkSamples, level));
+  return (const rec_summary_t*)(_map +_dir[k].offset +
+                                summaryOffset(_hdr->chunkSamples, _dir[k].nSamples, level, col));
+}
+
+float RecordingReader::value(uint64_t k, int col, uint32_t i) const
+{
+  return columnValue(column(k, col), col, i);
+}
+
+uint64_t RecordingReader::time(uint64_t k, uint32_t i) const
+{
+  return ((const uint64_t*)column(k, REC_COL_TIME))[i];
+}
+
+// -----------------------------------------------------------------------------
+uint64_t RecordingReader::findTime(uint64_t t) const
+{
+  // Chunk (all but the last have chunkSamples samples), then sample
+  //
+  const rec_chunk_t* ch = std::lower_bound(_dir, _dir +_hdr->nChunks, t,
+                            [](const rec_chunk_t& c, uint64_t t) { return c.t1 < t; });
+  if(ch == _dir +_hdr->nChunks) {
+    return _hdr->nSamples;
+  }
+  uint64_t        k = ch -_dir;
+  const uint64_t* times = (const uint64_t*)column(k, REC_COL_TIME);
+  return k *_hdr->chunkSamples +(std::lower_bound(times, times +ch->nSamples, t) -times);
+}
+
+void RecordingReader::read(uint64_t i0, uint64_t i1, std::vector<output_t>* out) const
+{
+  output_t o;
+
+  memset(&o, 0, sizeof(o));
+  out->clear();
+  i1 = std::min(i1, nSamples());
+  for(uint64_t i=i0; i<i1; i++) {
+    uint64_t k = i /_hdr->chunkSamples;
+    uint32_t j = (uint32_t)(i %_hdr->chunkSamples);
+    o.currentMicros   = (unsigned long)time(k, j);
+    o.v               = value(k, REC_COL_V, j);
+    o.I_total         = value(k, REC_COL_I_TOTAL, j);
+    o.Stim_State      = (int)value(k, REC_COL_STIM, j);
+    o.SpikeIn1State   = (int)value(k, REC_COL_SPIKE_IN1, j);
+    o.SpikeIn2State   = (int)value(k, REC_COL_SPIKE_IN2, j);
+    o.I_PD            = value(k, REC_COL_I_PD, j);
+    o.I_AnalogIn      = value(k, REC_COL_I_ANALOG, j);
+    o.I_Synapse       = value(k, REC_COL_I_SYNAPSE, j);
+    o.NeuronBehaviour = (int)value(k, REC_COL_MODE, j);
+    o.TickMissed      = (int)value(k, REC_COL_TICK_MISSED, j);
+    out->push_back(o);
+  }
+}
+
+// -----------------------------------------------------------------------------
+void RecordingReader::overview(int col, uint64_t t0, uint64_t t1, size_t maxBins,
+                               std::vector<RecordingBin>* out) const
+{
+  uint64_t i0 = findTime(t0), i1 = (t1 == UINT64_MAX) ? nSamples() : findTime(t1 +1);
+  uint32_t cs = _hdr->chunkSamples;
+  int      level;
+
+  out->clear();
+  if((i1 <= i0) || (col < 1) || (col >= REC_N_COLUMNS) || (maxBins < 1)) {
+    return;
+  }
+
+  // Finest level with no more than maxBins bins in the window (level 0:
+  // whole chunks, level REC_N_LEVELS +1: single samples)
+  //
+  for(level=REC_N_LEVELS +1; level>0; level--) {
+    uint32_t binSamples = (level > REC_N_LEVELS) ? 1 : recBinSamples(cs, level);
+    if((i1 -1) /binSamples -i0 /binSamples +1 <= maxBins) break;
+  }
+  uint32_t binSamples = (level > REC_N_LEVELS) ? 1 : recBinSamples(cs, level);
+
+  // Bins that overlap the window, with their sample counts
+  //
+  std::vector<RecordingBin> bins;
+  std::vector<uint32_t>     counts;
+  for(uint64_t k=i0 /cs; k<=(i1 -1) /cs; k++) {
+    const rec_chunk_t& ch  = _dir[k];
+    uint64_t           lo  = (k *cs < i0) ? i0 -k *cs : 0;
+    uint64_t           hi  = std::min<uint64_t>(i1 -k *cs, ch.nSamples);
+    const rec_summary_t* s = NULL;
+    uint32_t           nBins;
+
+    if((level >= 1) && (level <= REC_N_LEVELS)) s = summary(k, level, col, &nBins);
+    for(uint32_t b=(uint32_t)(lo /binSamples); b<=(hi -1) /binSamples; b++) {
+      RecordingBin bin;
+      uint32_t     j0 = b *binSamples, n = std::min(binSamples, ch.nSamples -j0);
+      if(level == 0) {
+        bin.s = ch.total[col -1];
+      }
+      else if(s != NULL) {
+        bin.s = s[b];
+      }
+      else {
+        bin.s.min = bin.s.max = bin.s.mean = value(k, col, j0);
+      }
+      bin.t0 = (level == 0) ? ch.t0 : time(k, j0);
+      bin.t1 = (level == 0) ? ch.t1 : time(k, j0 +n -1);
+      bins.push_back(bin);
+      counts.push_back(n);
+    }
+  }
+
+  // Merge bins if there are still too many (only at level 0)
+  //
+  size_t group = (bins.size() +maxBins -1) /maxBins;
+  for(size_t i=0; i<bins.size(); i+=group) {
+    RecordingBin m = bins[i];
+    double       sum = 0, n = 0;
+    for(size_t j=i; j<std::min(i +group, bins.size()); j++) {
+      m.s.min = std::min(m.s.min, bins[j].s.min);
+      m.s.max = std::max(m.s.max, bins[j].s.max);
+      m.t1    = bins[j].t1;
+      sum    += (double)bins[j].s.mean *counts[j];
+      n      += counts[j];
+    }
+    m.s.mean = (float)(sum /n);
+    out->push_back(m);
+  }
+}
+
+// -----------------------------------------------------------------------------
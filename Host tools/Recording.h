@@ -0,0 +1,165 @@
+// -----------------------------------------------------------------------------
+// Chunked, columnar recording files (.spkr) with min/max/mean summaries at
+// several zoom levels, so that long sessions can be shown as an overview
+// without reading all samples, and a window can be read without parsing the
+// rest (see spikeling_rec)
+//
+// The file is meant to be memory-mapped; all values are little-endian and
+// every block starts at a multiple of 8 bytes:
+//
+//   header     rec_header_t (64 bytes)
+//   chunks     `nChunks` chunks of up to `chunkSamples` samples, each with
+//                - the columns, one array per column (REC_COL_xxx, in this
+//                  order, types see recColumnSize()), each padded to 8 bytes
+//                - the summaries of the value columns (all but the time)
+//                  for levels 1..REC_N_LEVELS, from coarse to fine: for each
+//                  level, for each value column, one rec_summary_t per bin
+//                  of recBinSamples() samples, padded to 8 bytes
+//   directory  `nChunks` rec_chunk_t, at `dirOffset`, with the position,
+//              time range and summary (level 0) of each chunk
+//
+// The time column holds currentMicros extended to 64 bits (the firmware's
+// 32-bit counter wraps after 71 minutes).
+// -----------------------------------------------------------------------------
+#ifndef  Recording_h
+#define  Recording_h
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <string>
+#include <vector>
+#include "Definitions.h"
+
+#define  REC_MAGIC          "SPKLREC1"
+#define  REC_VERSION        1
+#define  REC_CHUNK_SAMPLES  65536   // default samples per chunk
+#define  REC_N_LEVELS       3       // summary levels within a chunk
+#define  REC_LEVEL_SHIFT    4       // each level has 16x as many bins
+
+// Columns, in the order of the ASCII/CSV lines (after the time)
+//
+#define  REC_COL_TIME       0       // uint64_t, us
+#define  REC_COL_V          1       // float
+#define  REC_COL_I_TOTAL    2       // float
+#define  REC_COL_STIM       3       // uint8_t
+#define  REC_COL_SPIKE_IN1  4       // uint8_t
+#define  REC_COL_SPIKE_IN2  5       // uint8_t
+#define  REC_COL_I_PD       6       // float
+#define  REC_COL_I_ANALOG   7       // float
+#define  REC_COL_I_SYNAPSE  8       // float
+#define  REC_COL_MODE       9       // uint8_t, NeuronBehaviour
+#define  REC_COL_TICK_MISSED 10     // uint8_t
+#define  REC_N_COLUMNS      11
+#define  REC_N_VALUES       (REC_N_COLUMNS -1)  // columns with summaries
+
+typedef struct {
+  char     magic[8];
+  uint32_t version;
+  uint32_t nColumns;
+  uint32_t chunkSamples;
+  uint32_t nLevels;
+  uint64_t nSamples;
+  uint64_t nChunks;
+  uint64_t dirOffset;
+  uint8_t  reserved[16];
+  } rec_header_t;
+
+typedef struct {
+  float    min, max, mean;
+  } rec_summary_t;
+
+typedef struct {
+  uint64_t      offset;              // of the chunk in the file
+  uint32_t      nSamples;
+  uint32_t      reserved;
+  uint64_t      t0, t1;              // time of the first and last sample
+  rec_summary_t total[REC_N_VALUES]; // summary of the whole chunk
+  } rec_chunk_t;
+
+// Layout helpers
+//
+const char* recColumnName(int col);
+int         recColumnFind(const std::string& name);   // -1 if unknown
+size_t      recColumnSize(int col);
+uint32_t    recBinSamples(uint32_t chunkSamples, int level);  // level 1..REC_N_LEVELS
+uint32_t    recBins(uint32_t n, uint32_t binSamples);
+
+// -----------------------------------------------------------------------------
+// Writes a recording sample by sample; only the current chunk is kept in
+// memory
+// -----------------------------------------------------------------------------
+class RecordingWriter
+{
+public:
+  RecordingWriter();
+  ~RecordingWriter();
+
+  bool               open(const char* fName, uint32_t chunkSamples = REC_CHUNK_SAMPLES);
+  void               add(const output_t& o);
+  bool               close();
+
+private:
+  void               writeChunk();
+  bool               writeAligned(const void* data, size_t len);
+
+  FILE*              _f;
+  bool               _ok;
+  uint32_t           _chunkSamples;
+  uint64_t           _pos;
+  uint64_t           _nSamples;
+  uint64_t           _lastMicros, _wrap;
+  std::vector<std::vector<uint8_t>> _cols;
+  uint32_t           _n;                   // samples in the current chunk
+  std::vector<rec_chunk_t> _dir;
+};
+
+// -----------------------------------------------------------------------------
+// Reads a memory-mapped recording
+// -----------------------------------------------------------------------------
+struct RecordingBin {
+  uint64_t           t0, t1;               // time range of the bin
+  rec_summary_t      s;
+};
+
+class RecordingReader
+{
+public:
+  RecordingReader();
+  ~RecordingReader();
+
+  bool               open(const char* fName);   // false if not a valid recording
+  void               close();
+
+  uint64_t           nSamples() const { return _hdr ? _hdr->nSamples : 0; }
+  uint64_t           nChunks() const { return _hdr ? _hdr->nChunks : 0; }
+  uint32_t           chunkSamples() const { return _hdr->chunkSamples; }
+  const rec_chunk_t& chunk(uint64_t k) const { return _dir[k]; }
+
+  // Column `col` of chunk `k` (chunk(k).nSamples values)
+  const void*        column(uint64_t k, int col) const;
+  // Summaries of value column `col` (1..) of chunk `k` at `level` (1..);
+  // `nBins` receives their number
+  const rec_summary_t* summary(uint64_t k, int level, int col, uint32_t* nBins) const;
+
+  // Index of the first sample at or after `t` (us)
+  uint64_t           findTime(uint64_t t) const;
+  // Samples [i0, i1) as output_t (TickMissed, NeuronBehaviour included)
+  void               read(uint64_t i0, uint64_t i1, std::vector<output_t>* out) const;
+  // Summary of column `col` between the times t0 and t1 in at most `maxBins`
+  // bins, taken from the finest level that fits (raw samples if they fit)
+  void               overview(int col, uint64_t t0, uint64_t t1, size_t maxBins,
+                              std::vector<RecordingBin>* out) const;
+
+private:
+  float              value(uint64_t k, int col, uint32_t i) const;
+  uint64_t           time(uint64_t k, uint32_t i) const;
+
+  const uint8_t*       _map;
+  size_t               _size;
+  const rec_header_t*  _hdr;
+  const rec_chunk_t*   _dir;
+};
+
+#endif
+// -----------------------------------------------------------------------------
@@ -0,0 +1,122 @@
+// -----------------------------------------------------------------------------
+#include <string.h>
+#include <algorithm>
+#include "SequenceBuffer.h"
+
+// -----------------------------------------------------------------------------
+uint64_t unwrapSeq(uint64_t ref, uint32_t raw, int bits)
+{
+  uint64_t period = (uint64_t)1 << bits;
+  uint64_t cand   = (ref & ~(period -1)) | raw;
+
+  // the candidate in the same period, or the one before or after it
+  if((cand > ref) && (cand -ref > period /2) && (cand >= period)) cand -= period;
+  else if((cand < ref) && (ref -cand > period /2)) cand += period;
+  return cand;
+}
+
+// -----------------------------------------------------------------------------
+SequenceBuffer::SequenceBuffer(size_t window)
+{
+  _window  = std::max<size_t>(1, window);
+  _history = std::max<size_t>(1024, _window *16);
+  _started = false;
+  _next    = _max = 0;
+  _haveMicros = false;
+  _maxMicros  = 0;
+  _seen.assign(_history +_window, Seen{UINT64_MAX, 0});
+  memset(&_stats, 0, sizeof(_stats));
+}
+
+// A sample that does not fit the times of the ones before it
+//
+bool SequenceBuffer::isRestart(uint64_t seq, const output_t* o) const
+{
+  if((o == NULL) || !_haveMicros) return false;
+  uint32_t t = (uint32_t)o->currentMicros;
+  if(seq > _max) return (int32_t)(t -_maxMicros) < 0;   // (across the 32-bit wrap)
+  const Seen& s = _seen[seq %_seen.size()];
+  return (s.seq == seq) && (s.micros != t);
+}
+
+void SequenceBuffer::restart(uint64_t seq, const SampleHandler& onRecord)
+{
+  emit(onRecord, 0);
+  _missing.clear();
+  std::fill(_seen.begin(), _seen.end(), Seen{UINT64_MAX, 0});
+  _haveMicros = false;
+  _stats.restarts++;
+  _next = _max = seq;
+}
+
+void SequenceBuffer::add(uint64_t seq, const output_t* o, const SampleHandler& onRecord)
+{
+  _stats.received++;
+  if(!_started) {
+    _next    = _max = seq;
+    _started = true;
+  }
+
+  if(isRestart(seq, o) || (seq +_history < _next)) {
+    restart(seq, onRecord);
+  }
+
+  // Behind the records passed on: late or repeated
+  //
+  if(seq < _next) {
+    if(_missing.erase(seq) > 0) _stats.late++;
+    else _stats.duplicates++;
+    return;
+  }
+  if(_held.count(seq) > 0) {
+    _stats.duplicates++;
+    return;
+  }
+  if(seq < _max) _stats.reordered++;
+  if(o != NULL) {
+    _seen[seq %_seen.size()] = Seen{seq, (uint32_t)o->currentMicros};
+    if((seq >= _max) || !_haveMicros) {
+      _maxMicros  = (uint32_t)o->currentMicros;
+      _haveMicros = true;
+    }
+  }
+  _max = std::max(_max, seq);
+
+  Entry& e = _held[seq];
+  e.valid  = (o != NULL);
+  if(o != NULL) e.o = *o;
+  emit(onRecord, _window);
+}
+
+void SequenceBuffer::flush(const SampleHandler& onRecord)
+{
+  emit(onRecord, 0);
+}
+
+// Pass on the held records that are next in order, and the oldest ones while
+// more than `keep` are held (the numbers before them are then lost)
+//
+void SequenceBuffer::emit(const SampleHandler& onRecord, size_t keep)
+{
+  while(!_held.empty()) {
+    auto it = _held.begin();
+    if((it->first != _next) && (_held.size() <= keep)) break;
+
+    for(uint64_t s=std::max(_next, it->first -std::min<uint64_t>(it->first, _history));
+        s<it->first; s++) {
+      _missing.insert(s);
+    }
+    _stats.lost += it->first -_next;
+    if(it->second.valid) {
+      onRecord(it->second.o);
+      _stats.written++;
+    }
+    _next = it->first +1;
+    _held.erase(it);
+  }
+  while(!_missing.empty() && (*_missing.begin() +_history < _next)) {
+    _missing.erase(_missing.begin());
+  }
+}
+
+// -----------------------------------------------------------------------------
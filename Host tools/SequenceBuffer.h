@@ -0,0 +1,87 @@
+// -----------------------------------------------------------------------------
+// Puts records with sequence numbers back into order and accounts for lost,
+// repeated and reordered records (see spikeling_ingest)
+//
+// Records are held back until `window` later records have arrived, so that a
+// record that arrives up to `window` places too late is still written in
+// order. A record that is still missing then counts as lost; if it turns up
+// afterwards, it counts as late and is dropped. A number that was already
+// written (or is held back) counts as duplicate.
+//
+// A restart of the board (the held records are written and the order starts
+// over) is taken from the time of the samples: a number ahead of all others
+// whose currentMicros lies before that of the latest sample, or a number
+// seen before with a different currentMicros. A jump back by more than the
+// history of lost numbers is a restart as well. (A restart that repeats
+// numbers and times exactly, e.g. with USES_MODEL_TICK within the first
+// records, looks like repeated records.)
+//
+// Sequence numbers are 64 bits; use unwrapSeq() to extend the 16-bit frame
+// counter or the 32-bit record number of the ASCII lines.
+// -----------------------------------------------------------------------------
+#ifndef  SequenceBuffer_h
+#define  SequenceBuffer_h
+
+#include <stdint.h>
+#include <map>
+#include <set>
+#include <vector>
+#include "FrameDecoder.h"
+
+struct SequenceStats {
+  uint64_t           received;      // records passed to add()
+  uint64_t           written;       // records passed on, in order
+  uint64_t           lost;          // numbers never received in time
+  uint64_t           duplicates;    // numbers received more than once
+  uint64_t           reordered;     // records that came after a later one
+  uint64_t           late;          // records that came after being counted lost
+  uint64_t           restarts;      // board resets (see above)
+};
+
+// Number nearest to `ref` whose lower `bits` bits are `raw`
+//
+uint64_t unwrapSeq(uint64_t ref, uint32_t raw, int bits);
+
+class SequenceBuffer
+{
+public:
+  explicit SequenceBuffer(size_t window = 64);
+
+  // Add a record; `o` may be NULL for numbers that are used, but not passed
+  // on (e.g. frames that are not samples)
+  void               add(uint64_t seq, const output_t* o, const SampleHandler& onRecord);
+  // Pass on all held records (at the end of the input)
+  void               flush(const SampleHandler& onRecord);
+
+  const SequenceStats& stats() const { return _stats; }
+  uint64_t           last() const { return _max; }    // highest number so far
+
+private:
+  void               emit(const SampleHandler& onRecord, size_t keep);
+  bool               isRestart(uint64_t seq, const output_t* o) const;
+  void               restart(uint64_t seq, const SampleHandler& onRecord);
+
+  struct Entry {
+    bool             valid;
+    output_t         o;
+  };
+
+  size_t             _window, _history;
+  bool               _started;
+  uint64_t           _next;         // next number to pass on
+  uint64_t           _max;
+  std::map<uint64_t, Entry> _held;
+  std::set<uint64_t> _missing;      // recent numbers counted as lost
+  bool               _haveMicros;
+  uint32_t           _maxMicros;    // currentMicros of the sample with the highest number
+
+  struct Seen {
+    uint64_t         seq;
+    uint32_t         micros;
+  };
+  std::vector<Seen>  _seen;         // recent samples, by number modulo the size
+  SequenceStats      _stats;
+};
+
+#endif
+// -----------------------------------------------------------------------------
@@ -0,0 +1,111 @@
+// -----------------------------------------------------------------------------
+// The loops are written without branches in their bodies where possible, so
+// that the compiler can vectorise them (e.g. the threshold comparisons)
+// -----------------------------------------------------------------------------
+#include <string.h>
+#include "SpikeAnalysis.h"
+
+// Collect the indices where `mask` is set; works in blocks so that the
+// comparisons (the expensive part) run in vector registers
+//
+#define  SPKL_BLOCK  1024
+
+template <typename Test>
+static int64_t collect(int64_t i0, int64_t n, Test test, int64_t* idx, int64_t max)
+{
+  uint8_t mask[SPKL_BLOCK];
+  int64_t count = 0;
+
+  for(int64_t b=i0; b<n; b+=SPKL_BLOCK) {
+    int64_t m   = (n -b < SPKL_BLOCK) ? n -b : SPKL_BLOCK;
+    uint8_t any = 0;
+    for(int64_t j=0; j<m; j++) {
+      mask[j] = test(b +j);
+      any    |= mask[j];
+    }
+    if(!any) continue;
+    for(int64_t j=0; j<m; j++) {
+      if(mask[j]) {
+        if(count < max) idx[count] = b +j;
+        count++;
+      }
+    }
+  }
+  return count;
+}
+
+// -----------------------------------------------------------------------------
+int64_t spkl_find_spikes(const double* v, int64_t n, double thresh, int64_t* idx, int64_t max)
+{
+  return collect(1, n, [=](int64_t i) { return (uint8_t)((v[i -1] < thresh) & (v[i] > thresh)); },
+                 idx, max);
+}
+
+void spkl_spike_rate(const double* t, int64_t n, const int64_t* spikes, int64_t nSpikes, double* rate)
+{
+  int64_t done = 0;
+
+  for(int64_t k=0; k+1<nSpikes; k++) {
+    int64_t a = spikes[k], b = spikes[k +1];
+    double  r = (t[b] > t[a]) ? 1.0 /(t[b] -t[a]) : 0.0;
+    if(a > done) memset(rate +done, 0, (a -done) *sizeof(double));
+    for(int64_t i=a; i<b; i++) rate[i] = r;
+    done = b;
+  }
+  if(n > done) memset(rate +done, 0, (n -done) *sizeof(double));
+}
+
+int64_t spkl_find_onsets(const double* stim, int64_t n, int64_t* idx, int64_t max)
+{
+  return collect(1, n, [=](int64_t i) { return (uint8_t)(stim[i] > stim[i -1]); }, idx, max);
+}
+
+int64_t spkl_loop_length(const int64_t* onsets, int64_t nOnsets)
+{
+  return (nOnsets < 2) ? 0 : onsets[1] -onsets[0];
+}
+
+int64_t spkl_loop_average(const double* x, int64_t n, const int64_t* onsets, int64_t nOnsets,
+                          int64_t len, double* mean)
+{
+  int64_t loops = 0;
+
+  if(len <= 0) return 0;
+  memset(mean, 0, len *sizeof(double));
+  for(int64_t k=0; k<nOnsets; k++) {
+    const double* src = x +onsets[k];
+    if(onsets[k] +len > n) break;
+    for(int64_t j=0; j<len; j++) mean[j] += src[j];
+    loops++;
+  }
+  if(loops > 0) {
+    double scale = 1.0 /loops;
+    for(int64_t j=0; j<len; j++) mean[j] *= scale;
+  }
+  return loops;
+}
+
+int64_t spkl_aligned_spikes(const double* t, const int64_t* spikes, int64_t nSpikes,
+                            const int64_t* onsets, int64_t nOnsets, int64_t len,
+                            int32_t* loop, double* relTime, int64_t max)
+{
+  int64_t count = 0, s0 = 0;
+
+  // Both lists are sorted: walk through the spikes once (loops only overlap
+  // if len is longer than the distance of the onsets)
+  //
+  for(int64_t k=0; k<nOnsets; k++) {
+    int64_t on = onsets[k];
+    while((s0 < nSpikes) && (spikes[s0] <= on)) s0++;
+    for(int64_t s=s0; (s < nSpikes) && (spikes[s] < on +len); s++) {
+      if(count < max) {
+        loop[count]    = (int32_t)k;
+        relTime[count] = t[spikes[s]] -t[on];
+      }
+      count++;
+    }
+  }
+  return count;
+}
+
+// -----------------------------------------------------------------------------
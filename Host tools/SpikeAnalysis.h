@@ -0,0 +1,72 @@
+/* -----------------------------------------------------------------------------
+ * Analysis of Spikeling recordings: spike detection, instantaneous rate,
+ * stimulus onsets and loop averages, as in "Spikeling Analysis.ipynb"
+ *
+ * Built as shared library (spikeling_analysis) with a plain C interface, so
+ * that it can be called from Python (ctypes) and MATLAB (loadlibrary), and
+ * used by spikeling_analyze. Each function is one pass over the columns of a
+ * recording (as double arrays, which is what numpy.loadtxt and MATLAB load
+ * give); index arrays are 0-based.
+ *
+ * Functions that fill an index array of size `max` return the number of
+ * entries found, which may be larger than `max` (then call again with a
+ * larger array).
+ * -------------------------------------------------------------------------- */
+#ifndef  SpikeAnalysis_h
+#define  SpikeAnalysis_h
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(_WIN32)
+  #define SPKL_API __declspec(dllexport)
+#else
+  #define SPKL_API __attribute__((visibility("default")))
+#endif
+
+/* Spikes: samples i at which v rises above `thresh` (v[i-1] < thresh and
+ * v[i] > thresh; the notebook uses thresh = 10)
+ */
+SPKL_API int64_t spkl_find_spikes(const double* v, int64_t n, double thresh,
+                                  int64_t* idx, int64_t max);
+
+/* Instantaneous rate in Hz: between two spikes (from the sample of the first
+ * up to the one before the second), 1/ISI with the times `t` in s; 0 before
+ * the first and from the last spike on, and where the ISI is not positive
+ */
+SPKL_API void spkl_spike_rate(const double* t, int64_t n, const int64_t* spikes,
+                              int64_t nSpikes, double* rate);
+
+/* Stimulus onsets: samples i at which the stimulus state rises
+ * (stim[i] > stim[i-1])
+ */
+SPKL_API int64_t spkl_find_onsets(const double* stim, int64_t n, int64_t* idx,
+                                  int64_t max);
+
+/* Loop length in samples: the distance between the first two onsets, or 0
+ * if there are fewer than two
+ */
+SPKL_API int64_t spkl_loop_length(const int64_t* onsets, int64_t nOnsets);
+
+/* Mean of x over the loops: mean[j] is the average of x[onset +j] over all
+ * onsets with onset +len <= n (j = 0..len-1); returns the number of loops
+ */
+SPKL_API int64_t spkl_loop_average(const double* x, int64_t n, const int64_t* onsets,
+                                   int64_t nOnsets, int64_t len, double* mean);
+
+/* Spikes aligned to the onsets (raster): for every spike s with
+ * onset < s < onset +len, the loop number and t[s] -t[onset]
+ */
+SPKL_API int64_t spkl_aligned_spikes(const double* t, const int64_t* spikes, int64_t nSpikes,
+                                     const int64_t* onsets, int64_t nOnsets, int64_t len,
+                                     int32_t* loop, double* relTime, int64_t max);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+/* -------------------------------------------------------------------------- */
@@ -0,0 +1,225 @@
+// -----------------------------------------------------------------------------
+// Must be compiled with -ffp-contract=off (see CMakeLists.txt), so that the
+// compiler does not fuse multiplications and additions in the scalar version
+// -----------------------------------------------------------------------------
+#include <string.h>
+#include <algorithm>
+#include <thread>
+#include "Sweep.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+  #define SWEEP_X86
+  #include <immintrin.h>
+#endif
+
+#define  SWEEP_PAD  16   // parameter arrays are padded to the widest lanes
+
+// -----------------------------------------------------------------------------
+void SweepParams::add(float a_, float b_, float c_, float d_, float I_)
+{
+  a.push_back(a_);
+  b.push_back(b_);
+  c.push_back(c_);
+  d.push_back(d_);
+  I.push_back(I_);
+}
+
+// Padded copy of the parameters, so that the SIMD versions can always load
+// full vectors
+//
+struct Padded {
+  std::vector<float> a, b, c, d, I;
+
+  explicit Padded(const SweepParams& p)
+  {
+    size_t n = (p.size() +SWEEP_PAD -1) /SWEEP_PAD *SWEEP_PAD;
+    copy(a, p.a, n);
+    copy(b, p.b, n);
+    copy(c, p.c, n);
+    copy(d, p.d, n);
+    copy(I, p.I, n);
+  }
+
+private:
+  static void copy(std::vector<float>& dst, const std::vector<float>& src, size_t n)
+  {
+    dst.assign(n, 0.0f);
+    std::copy(src.begin(), src.end(), dst.begin());
+  }
+};
+
+// -----------------------------------------------------------------------------
+// Scalar version
+// -----------------------------------------------------------------------------
+static void runScalar(const Padded& p, size_t i0, size_t i1,
+                      const SweepOptions& opt, SweepSpikes* spikes)
+{
+  const float dt = opt.dt;
+
+  for(size_t i=i0; i<i1; i++) {
+    const float a = p.a[i], b = p.b[i], c = p.c[i], d = p.d[i], I = p.I[i];
+    float       v = opt.v0, u = b*opt.v0;
+
+    for(long step=0; step<opt.nSteps; step++) {
+      v = v + dt*(0.04f*v*v + 5.0f*v + 140.0f - u + I);
+      u = u + dt*(a*(b*v - u));
+      if(v >= 30.0f) {
+        v  = c;
+        u += d;
+        (*spikes)[i].push_back((int32_t)step);
+      }
+      if(v <= -90.0f) v = -90.0f;
+    }
+  }
+}
+
+#ifdef SWEEP_X86
+// -----------------------------------------------------------------------------
+// AVX2 version, 8 parameter sets per vector
+// -----------------------------------------------------------------------------
+__attribute__((target("avx2")))
+static void runAvx2(const Padded& p, size_t i0, size_t i1,
+                    const SweepOptions& opt, SweepSpikes* spikes)
+{
+  const __m256 k004 = _mm256_set1_ps(0.04f), k5  = _mm256_set1_ps(5.0f);
+  const __m256 k140 = _mm256_set1_ps(140.0f), k30 = _mm256_set1_ps(30.0f);
+  const __m256 km90 = _mm256_set1_ps(-90.0f), dt  = _mm256_set1_ps(opt.dt);
+
+  for(size_t i=i0; i<i1; i+=8) {
+    const __m256 a = _mm256_loadu_ps(&p.a[i]), b = _mm256_loadu_ps(&p.b[i]);
+    const __m256 c = _mm256_loadu_ps(&p.c[i]), d = _mm256_loadu_ps(&p.d[i]);
+    const __m256 I = _mm256_loadu_ps(&p.I[i]);
+    __m256       v = _mm256_set1_ps(opt.v0);
+    __m256       u = _mm256_mul_ps(b, v);
+
+    for(long step=0; step<opt.nSteps; step++) {
+      __m256 t;
+      t = _mm256_mul_ps(_mm256_mul_ps(k004, v), v);
+      t = _mm256_add_ps(t, _mm256_mul_ps(k5, v));
+      t = _mm256_sub_ps(_mm256_add_ps(t, k140), u);
+      t = _mm256_add_ps(t, I);
+      v = _mm256_add_ps(v, _mm256_mul_ps(dt, t));
+      t = _mm256_mul_ps(a, _mm256_sub_ps(_mm256_mul_ps(b, v), u));
+      u = _mm256_add_ps(u, _mm256_mul_ps(dt, t));
+
+      __m256 reset = _mm256_cmp_ps(v, k30, _CMP_GE_OQ);
+      int    mask  = _mm256_movemask_ps(reset);
+      if(mask != 0) {
+        v = _mm256_blendv_ps(v, c, reset);
+        u = _mm256_blendv_ps(u, _mm256_add_ps(u, d), reset);
+        for(int j=0; j<8; j++) {
+          if((mask & (1 << j)) && (i +j < spikes->size())) {
+            (*spikes)[i +j].push_back((int32_t)step);
+          }
+        }
+      }
+      v = _mm256_blendv_ps(v, km90, _mm256_cmp_ps(v, km90, _CMP_LE_OQ));
+    }
+  }
+}
+
+// -----------------------------------------------------------------------------
+// AVX-512 version, 16 parameter sets per vector
+// -----------------------------------------------------------------------------
+__attribute__((target("avx512f")))
+static void runAvx512(const Padded& p, size_t i0, size_t i1,
+                      const SweepOptions& opt, SweepSpikes* spikes)
+{
+  const __m512 k004 = _mm512_set1_ps(0.04f), k5  = _mm512_set1_ps(5.0f);
+  const __m512 k140 = _mm512_set1_ps(140.0f), k30 = _mm512_set1_ps(30.0f);
+  const __m512 km90 = _mm512_set1_ps(-90.0f), dt  = _mm512_set1_ps(opt.dt);
+
+  for(size_t i=i0; i<i1; i+=16) {
+    const __m512 a = _mm512_loadu_ps(&p.a[i]), b = _mm512_loadu_ps(&p.b[i]);
+    const __m512 c = _mm512_loadu_ps(&p.c[i]), d = _mm512_loadu_ps(&p.d[i]);
+    const __m512 I = _mm512_loadu_ps(&p.I[i]);
+    __m512       v = _mm512_set1_ps(opt.v0);
+    __m512       u = _mm512_mul_ps(b, v);
+
+    for(long step=0; step<opt.nSteps; step++) {
+      __m512 t;
+      t = _mm512_mul_ps(_mm512_mul_ps(k004, v), v);
+      t = _mm512_add_ps(t, _mm512_mul_ps(k5, v));
+      t = _mm512_sub_ps(_mm512_add_ps(t, k140), u);
+      t = _mm512_add_ps(t, I);
+      v = _mm512_add_ps(v, _mm512_mul_ps(dt, t));
+      t = _mm512_mul_ps(a, _mm512_sub_ps(_mm512_mul_ps(b, v), u));
+      u = _mm512_add_ps(u, _mm512_mul_ps(dt, t));
+
+      __mmask16 reset = _mm512_cmp_ps_mask(v, k30, _CMP_GE_OQ);
+      if(reset != 0) {
+        v = _mm512_mask_blend_ps(reset, v, c);
+        u = _mm512_mask_add_ps(u, reset, u, d);
+        for(int j=0; j<16; j++) {
+          if((reset & (1 << j)) && (i +j < spikes->size())) {
+            (*spikes)[i +j].push_back((int32_t)step);
+          }
+        }
+      }
+      v = _mm512_mask_blend_ps(_mm512_cmp_ps_mask(v, km90, _CMP_LE_OQ), v, km90);
+    }
+  }
+}
+#endif
+
+// -----------------------------------------------------------------------------
+int sweepBestIsa()
+{
+  #ifdef SWEEP_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx512f")) return SWEEP_ISA_AVX512;
+    if(__builtin_cpu_supports("avx2")) return SWEEP_ISA_AVX2;
+  #endif
+  return SWEEP_ISA_SCALAR;
+}
+
+const char* sweepIsaName(int isa)
+{
+  switch(isa) {
+    case SWEEP_ISA_AVX2:   return "avx2";
+    case SWEEP_ISA_AVX512: return "avx512";
+    case SWEEP_ISA_AUTO:   return "auto";
+    default:               return "scalar";
+  }
+}
+
+static void runRange(int isa, const Padded& p, size_t i0, size_t i1,
+                     const SweepOptions& opt, SweepSpikes* spikes)
+{
+  switch(isa) {
+    #ifdef SWEEP_X86
+    case SWEEP_ISA_AVX512: runAvx512(p, i0, i1, opt, spikes); break;
+    case SWEEP_ISA_AVX2:   runAvx2(p, i0, i1, opt, spikes); break;
+    #endif
+    default:               runScalar(p, i0, std::min(i1, spikes->size()), opt, spikes);
+  }
+}
+
+int sweepRun(const SweepParams& p, const SweepOptions& opt, SweepSpikes* spikes)
+{
+  Padded padded(p);
+  int    best = sweepBestIsa();
+  int    isa  = (opt.isa == SWEEP_ISA_AUTO) ? best : opt.isa;
+
+  if(isa > best) isa = SWEEP_ISA_SCALAR;
+  spikes->assign(p.size(), std::vector<int32_t>());
+
+  // Split the (padded) sets into one range per thread; each thread only
+  // writes to the spike lists of its own sets
+  //
+  size_t nBlocks  = padded.a.size() /SWEEP_PAD;
+  size_t nThreads = std::max(1, std::min(opt.threads, (int)nBlocks));
+  std::vector<std::thread> threads;
+
+  for(size_t t=0; t<nThreads; t++) {
+    size_t i0 = nBlocks *t /nThreads *SWEEP_PAD;
+    size_t i1 = nBlocks *(t+1) /nThreads *SWEEP_PAD;
+    threads.emplace_back(runRange, isa, std::cref(padded), i0, i1, std::cref(opt), spikes);
+  }
+  for(std::thread& th : threads) {
+    th.join();
+  }
+  return isa;
+}
+
+// -----------------------------------------------------------------------------
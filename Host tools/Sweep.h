@@ -0,0 +1,64 @@
+// -----------------------------------------------------------------------------
+// Batch simulation of many Izhikevich neurons with different parameters, for
+// sweeps over the parameter space (see spikeling_sweep)
+//
+// Each parameter set (a, b, c, d and a constant input current I) is simulated
+// independently with the update of modelIntegrate() in Model.h, in single
+// precision as on the Arduino (where double is float):
+//
+//   v = v + dt*(0.04*v*v + 5*v + 140 - u + I)
+//   u = u + dt*(a*(b*v - u))
+//   if v >= 30: v = c, u += d
+//   if v <= -90: v = -90
+//
+// The sets are processed in SIMD lanes (AVX2: 8, AVX-512: 16) if the CPU has
+// them, otherwise one at a time. All versions give bit-identical results:
+// they use the same order of operations and no fused multiply-add (Sweep.cpp
+// is compiled with -ffp-contract=off).
+// -----------------------------------------------------------------------------
+#ifndef  Sweep_h
+#define  Sweep_h
+
+#include <stdint.h>
+#include <vector>
+
+// Instruction sets for sweepRun()
+//
+#define  SWEEP_ISA_AUTO    0
+#define  SWEEP_ISA_SCALAR  1
+#define  SWEEP_ISA_AVX2    2
+#define  SWEEP_ISA_AVX512  3
+
+// Parameter sets, one entry per set in each array
+//
+struct SweepParams {
+  std::vector<float> a, b, c, d, I;
+
+  void   add(float a_, float b_, float c_, float d_, float I_);
+  size_t size() const { return a.size(); }
+};
+
+struct SweepOptions {
+  long   nSteps  = 10000;    // steps per parameter set
+  float  dt      = 0.1f;     // timestep_ms
+  float  v0      = -65.0f;   // initial v; u starts at b*v0
+  int    isa     = SWEEP_ISA_AUTO;
+  int    threads = 1;        // worker threads
+};
+
+// Spike times (step of each reset) per parameter set
+//
+typedef std::vector<std::vector<int32_t>> SweepSpikes;
+
+// Best instruction set supported by this CPU, and its name
+//
+int         sweepBestIsa();
+const char* sweepIsaName(int isa);
+
+// Simulate all parameter sets; returns the instruction set used (if `isa` is
+// not supported, the scalar version is used)
+//
+int sweepRun(const SweepParams& p, const SweepOptions& opt, SweepSpikes* spikes);
+
+#endif
+// -----------------------------------------------------------------------------
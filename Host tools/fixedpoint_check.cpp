@@ -0,0 +1,212 @@
+// -----------------------------------------------------------------------------
+// fixedpoint_check - compares the fixed-point model (FixedPoint.h,
+// USES_FIXED_POINT) against the float model (modelStep() in Model.h) for all
+// neuron modes
+//
+// Usage: fixedpoint_check [-n steps] [-d max. drift] [-v]
+//
+// Both versions are driven with the same input sequence (photodiode steps,
+// synaptic input pulses, Vm and noise dials), with the parameters and mode
+// tables of Spikeling.ino. For each mode, every spike is paired with the
+// nearest spike of the other version that is at most `max. drift` steps
+// away, and the drift (in steps) is reported. Returns 1 if for any mode more
+// than 2% of the spikes remain without partner or the mean drift exceeds
+// half a step.
+//
+// For comparison, the number of unpaired spikes between the float and a
+// double-precision version of the model is listed as well: the bursting
+// modes are sensitive enough that rounding alone eventually shifts spikes.
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+#include <vector>
+#include "Spikeling.ino"
+#include "FixedPoint.h"
+
+// -----------------------------------------------------------------------------
+// Double-precision copy of modelStep() (Model.h), only as a yardstick: it
+// shows how much the model diverges just from float rounding. This file is
+// compiled with single-precision constants (see CMakeLists.txt), as the float
+// model on AVR, so the constants here are the same float values
+// -----------------------------------------------------------------------------
+struct DoubleModel {
+  double v = 0, u = 0, I_Synapse = 0, I_Noise = 0, PD_gain = 1;
+
+  bool step(const model_input_t& in, const model_mode_t& m, const model_config_t& cfg)
+  {
+    double AnalogInAmpl, I_Vm, I_AnalogIn, I_PD, I_total;
+
+    I_Vm = -1 * (in.VmPotVal-512) / cfg.VmPotiScaling;
+    AnalogInAmpl = ((double)in.AnalogInPotVal - 512) / cfg.AnalogInScaling;
+    I_Noise+=in.Noise / (double)NOISE_SCALE;
+    I_Noise*=0.9;
+    I_AnalogIn = -1 * (in.AnalogInVal) * AnalogInAmpl;
+    if (cfg.AnalogInActive == 0) {I_AnalogIn = 0;}
+    I_PD = (((double)in.PDVal_smoothed) / cfg.PD_Scaling) * PD_gain;
+    if (PD_gain>cfg.PD_gain_min){
+      PD_gain-=m.PD_decay*I_PD;
+      if (PD_gain<cfg.PD_gain_min){
+        PD_gain=cfg.PD_gain_min;
+      }
+    }
+    if (PD_gain<1) {
+      PD_gain+=m.PD_recovery;
+    }
+    double Synapse1Ampl = -1* ((double)in.Syn1PotVal-512) / cfg.SynapseScaling;
+    double Synapse2Ampl = -1* ((double)in.Syn2PotVal-512) / cfg.SynapseScaling;
+    if (in.SpikeIn1State) {I_Synapse+=Synapse1Ampl*in.SpikeIn1State;}
+    if (in.SpikeIn2State) {I_Synapse+=Synapse2Ampl*in.SpikeIn2State;}
+    I_Synapse*=cfg.Synapse_decay;
+
+    bool reset = false;
+    I_total = I_PD*m.PD_polarity + I_Vm + I_Synapse + I_AnalogIn + I_Noise;
+    v = v + cfg.timestep_ms*(0.04 * v * v + 5*v + 140 - u + I_total);
+    u = u + cfg.timestep_ms*(m.a * ( m.b*v - u));
+    if (v>=30){v=m.c; u+=m.d; reset = true;}
+    if (v<=-90) {v=-90;}
+    return reset;
+  }
+};
+
+// -----------------------------------------------------------------------------
+// Input sequence
+// -----------------------------------------------------------------------------
+static uint32_t rngState = 12345;
+
+static long rngRange(long lo, long hi)
+{
+  rngState = rngState *1664525u +1013904223u;
+  return (hi <= lo) ? lo : lo +(long)((rngState >> 8) %(uint32_t)(hi -lo));
+}
+
+static void makeInput(long iStep, model_input_t* in, int* NoisePotVal)
+{
+  // Slow photodiode steps, a few synaptic input pulses, Vm and noise dials
+  // slightly off their centre
+  //
+  *NoisePotVal       = 400;
+  in->VmPotVal       = 470;
+  in->AnalogInPotVal = 512;
+  in->AnalogInVal    = 0;
+  in->PDVal_smoothed = ((iStep /5000) %2) ? 180 : 20;
+  in->Syn1PotVal     = 300;
+  in->Syn2PotVal     = 700;
+  in->SpikeIn1State  = ((iStep %1500) < 3) ? 1 : 0;
+  in->SpikeIn2State  = ((iStep %2300) < 3) ? 1 : 0;
+  long r = modelNoiseRange(*NoisePotVal, NoiseScaling);
+  in->Noise          = rngRange(-r, r) *NOISE_SCALE;
+}
+
+// -----------------------------------------------------------------------------
+// Pair each spike with the nearest spike of the other version (within
+// `maxDrift` steps) and count the spikes without partner
+// -----------------------------------------------------------------------------
+static void compareSpikes(const std::vector<long>& tRef, const std::vector<long>& t,
+                          long maxDrift, bool verbose, size_t* nUnpaired,
+                          long* driftMax, double* driftMean)
+{
+  size_t i = 0, j = 0, nPairs = 0;
+  long   drift;
+  double driftSum = 0;
+
+  *nUnpaired = 0;
+  *driftMax  = 0;
+  while((i < tRef.size()) || (j < t.size())) {
+    if(j >= t.size()) { (*nUnpaired)++; i++; continue; }
+    if(i >= tRef.size()) { (*nUnpaired)++; j++; continue; }
+    drift = labs(t[j] -tRef[i]);
+    if(drift <= maxDrift) {
+      driftSum += drift;
+      if(drift > *driftMax) *driftMax = drift;
+      nPairs++;
+      i++;
+      j++;
+    }
+    else {
+      if(verbose) {
+        printf("  unpaired spike at %ld\n", std::min(tRef[i], t[j]));
+      }
+      (*nUnpaired)++;
+      (tRef[i] < t[j]) ? i++ : j++;
+    }
+  }
+  *driftMean = (nPairs > 0) ? driftSum /nPairs : 0.0;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  long  nSteps   = 200000;
+  long  maxDrift = 10;
+  bool  verbose  = false;
+  bool  ok       = true;
+
+  for(int i=1; i<argc; i++) {
+    if((strcmp(argv[i], "-n") == 0) && (i+1 < argc)) {
+      nSteps = atol(argv[++i]);
+    }
+    else if((strcmp(argv[i], "-d") == 0) && (i+1 < argc)) {
+      maxDrift = atol(argv[++i]);
+    }
+    else if(strcmp(argv[i], "-v") == 0) {
+      verbose = true;
+    }
+    else {
+      fprintf(stderr, "Usage: fixedpoint_check [-n steps] [-d max. drift] [-v]\n");
+      return 1;
+    }
+  }
+
+  model_config_t cfg;
+  fx_config_t    fxCfg;
+  modelInitConfig(&cfg, timestep_ms, Synapse_decay, PD_gain_min, PD_Scaling,
+                  VmPotiScaling, AnalogInScaling, SynapseScaling, AnalogInActive);
+  fxInitConfig(&fxCfg, timestep_ms, Synapse_decay, PD_gain_min, PD_Scaling,
+               VmPotiScaling, AnalogInScaling, SynapseScaling, AnalogInActive);
+
+  printf("mode  spikes(float)  spikes(fixed)  unpaired  max. drift  mean drift"
+         "  unpaired(double)\n");
+  for(int mode=0; mode<nModes; mode++) {
+    model_mode_t  m;
+    model_state_t s;
+    fx_mode_t     fxM;
+    fx_state_t    fxS;
+    DoubleModel   refDbl;
+    std::vector<long> tFloat, tDouble, tFixed;
+
+    modelInitMode(&m, Array_a[mode], Array_b[mode], Array_c[mode], Array_d[mode],
+                  Array_PD_decay[mode], Array_PD_recovery[mode], Array_PD_polarity[mode]);
+    modelInitState(&s);
+    fxInitMode(&fxM, Array_a[mode], Array_b[mode], Array_c[mode], Array_d[mode],
+               Array_PD_decay[mode], Array_PD_recovery[mode],
+               Array_PD_polarity[mode], timestep_ms);
+    fxInitState(&fxS);
+    rngState = 12345;
+
+    for(long iStep=0; iStep<nSteps; iStep++) {
+      model_input_t in;
+      int        NoisePotVal;
+      makeInput(iStep, &in, &NoisePotVal);
+      if(modelStep(&s, &in, &m, &cfg)) tFloat.push_back(iStep);
+      if(refDbl.step(in, m, cfg)) tDouble.push_back(iStep);
+      if(fxModelStep(&fxS, &in, &fxM, &fxCfg)) tFixed.push_back(iStep);
+    }
+
+    size_t nUnpaired, nUnpairedDbl;
+    long   driftMax;
+    double driftMean;
+    compareSpikes(tFloat, tDouble, maxDrift, false, &nUnpairedDbl, &driftMax, &driftMean);
+    compareSpikes(tFloat, tFixed, maxDrift, verbose, &nUnpaired, &driftMax, &driftMean);
+    bool modeOk = (nUnpaired *100 <= 2*tFloat.size()) && (driftMean <= 0.5);
+    ok = ok && modeOk;
+
+    printf("%4d  %13zu  %13zu  %8zu  %10ld  %10.2f  %16zu  %s\n", mode,
+           tFloat.size(), tFixed.size(), nUnpaired, driftMax, driftMean,
+           nUnpairedDbl, modeOk ? "ok" : "FAILED");
+  }
+  return ok ? 0 : 1;
+}
+
+// -----------------------------------------------------------------------------
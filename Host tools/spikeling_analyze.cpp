@@ -0,0 +1,221 @@
+// -----------------------------------------------------------------------------
+// spikeling_analyze - spike detection, spike rate and stimulus-aligned loop
+// averages of a recording, as in "Spikeling Analysis.ipynb" (see
+// SpikeAnalysis.h)
+//
+// Usage: spikeling_analyze [-T threshold] [-l looplength] [-o prefix] input
+//
+//   -T  spike threshold in mV, default 10
+//   -l  loop length in samples, default: distance of the first two
+//       stimulus onsets
+//   -o  write the results into CSV files:
+//         <prefix>_spikes.csv  sample, time_s of each spike
+//         <prefix>_rate.csv    time_s, rate_hz per sample
+//         <prefix>_loops.csv   time_s, rate, v, I_total, stim (loop means)
+//         <prefix>_raster.csv  loop, time_s (spikes relative to the onset)
+//
+// The input is a CSV recording (ASCII output or spikeling_csv) or a .spkr
+// file (spikeling_rec). Times are in s from the first sample. A summary is
+// written to stdout.
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "SpikeAnalysis.h"
+#include "Recording.h"
+
+// Columns used by the analysis
+//
+struct Columns {
+  std::vector<double> t, v, I_total, stim;
+
+  void add(double t_us, const output_t& o)
+  {
+    t.push_back(t_us);
+    v.push_back(o.v);
+    I_total.push_back(o.I_total);
+    stim.push_back(o.Stim_State);
+  }
+};
+
+static bool loadCsv(const char* fName, Columns* c)
+{
+  FILE*         f = fopen(fName, "r");
+  char          line[256];
+  output_t      o;
+  unsigned long t;
+  uint64_t      wrap = 0, last = 0;
+
+  if(f == NULL) return false;
+  while(fgets(line, sizeof(line), f) != NULL) {
+    if(sscanf(line, "%f, %f, %d, %d, %d, %f, %f, %f, %lu", &o.v, &o.I_total,
+              &o.Stim_State, &o.SpikeIn1State, &o.SpikeIn2State, &o.I_PD,
+              &o.I_AnalogIn, &o.I_Synapse, &t) == 9) {
+      // Extend the 32-bit time of the firmware (as RecordingWriter::add)
+      uint64_t u = (uint32_t)t;
+      if(!c->t.empty() && (u +wrap < last) && (last -(u +wrap) > 0x80000000ULL)) {
+        wrap += 0x100000000ULL;
+      }
+      last = u +wrap;
+      c->add((double)last, o);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static bool loadRecording(const char* fName, Columns* c)
+{
+  RecordingReader rec;
+
+  if(!rec.open(fName)) return false;
+  for(uint64_t k=0; k<rec.nChunks(); k++) {
+    uint32_t        n = rec.chunk(k).nSamples;
+    const uint64_t* t = (const uint64_t*)rec.column(k, REC_COL_TIME);
+    const float*    v = (const float*)rec.column(k, REC_COL_V);
+    const float*    I = (const float*)rec.column(k, REC_COL_I_TOTAL);
+    const uint8_t*  s = (const uint8_t*)rec.column(k, REC_COL_STIM);
+    c->t.insert(c->t.end(), t, t +n);
+    c->v.insert(c->v.end(), v, v +n);
+    c->I_total.insert(c->I_total.end(), I, I +n);
+    c->stim.insert(c->stim.end(), s, s +n);
+  }
+  return true;
+}
+
+static std::vector<int64_t> findAll(int64_t (*find)(const double*, int64_t, double, int64_t*, int64_t),
+                                    const double* x, int64_t n, double thresh)
+{
+  std::vector<int64_t> idx(1024);
+  int64_t              count;
+
+  while((count = find(x, n, thresh, idx.data(), idx.size())) > (int64_t)idx.size()) {
+    idx.resize(count);
+  }
+  idx.resize(count);
+  return idx;
+}
+
+static int64_t findOnsets(const double* x, int64_t n, double, int64_t* idx, int64_t max)
+{
+  return spkl_find_onsets(x, n, idx, max);
+}
+
+static FILE* openOutput(const std::string& prefix, const char* name)
+{
+  std::string fName = prefix +name;
+  FILE*       f = fopen(fName.c_str(), "w");
+  if(f == NULL) {
+    perror(fName.c_str());
+    exit(1);
+  }
+  return f;
+}
+
+static void usage()
+{
+  fprintf(stderr, "Usage: spikeling_analyze [-T threshold] [-l looplength] [-o prefix] input\n");
+  exit(1);
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  const char* fName = NULL;
+  const char* prefix = NULL;
+  double      thresh = 10;
+  int64_t     loopLen = 0;
+  Columns     c;
+
+  for(int i=1; i<argc; i++) {
+    bool hasArg = (i+1 < argc);
+    if((strcmp(argv[i], "-T") == 0) && hasArg) thresh = atof(argv[++i]);
+    else if((strcmp(argv[i], "-l") == 0) && hasArg) loopLen = atol(argv[++i]);
+    else if((strcmp(argv[i], "-o") == 0) && hasArg) prefix = argv[++i];
+    else if((argv[i][0] == '-') || (fName != NULL)) usage();
+    else fName = argv[i];
+  }
+  if((fName == NULL) || (loopLen < 0)) usage();
+
+  auto t0 = std::chrono::steady_clock::now();
+  if(!loadRecording(fName, &c) && !loadCsv(fName, &c)) {
+    perror("spikeling_analyze");
+    return 1;
+  }
+  auto    t1 = std::chrono::steady_clock::now();
+  int64_t n  = c.t.size();
+  if(n == 0) {
+    fprintf(stderr, "spikeling_analyze: no samples in `%s`\n", fName);
+    return 1;
+  }
+  double t_first = c.t[0];
+  for(double& t : c.t) t = (t -t_first) *1e-6;
+
+  // Analysis
+  //
+  std::vector<int64_t> spikes = findAll(spkl_find_spikes, c.v.data(), n, thresh);
+  std::vector<double>  rate(n);
+  spkl_spike_rate(c.t.data(), n, spikes.data(), spikes.size(), rate.data());
+
+  std::vector<int64_t> onsets = findAll(findOnsets, c.stim.data(), n, 0);
+  if(loopLen == 0) loopLen = spkl_loop_length(onsets.data(), onsets.size());
+
+  std::vector<double> rateMean(loopLen), vMean(loopLen), IMean(loopLen), stimMean(loopLen);
+  int64_t             loops = 0;
+  std::vector<int32_t> rasterLoop;
+  std::vector<double>  rasterTime;
+  if(loopLen > 0) {
+    loops = spkl_loop_average(rate.data(), n, onsets.data(), onsets.size(), loopLen, rateMean.data());
+    spkl_loop_average(c.v.data(), n, onsets.data(), onsets.size(), loopLen, vMean.data());
+    spkl_loop_average(c.I_total.data(), n, onsets.data(), onsets.size(), loopLen, IMean.data());
+    spkl_loop_average(c.stim.data(), n, onsets.data(), onsets.size(), loopLen, stimMean.data());
+
+    // (raster of the same, complete loops as the averages)
+    int64_t nRaster = spkl_aligned_spikes(c.t.data(), spikes.data(), spikes.size(), onsets.data(),
+                                          loops, loopLen, NULL, NULL, 0);
+    rasterLoop.resize(nRaster);
+    rasterTime.resize(nRaster);
+    spkl_aligned_spikes(c.t.data(), spikes.data(), spikes.size(), onsets.data(), loops,
+                        loopLen, rasterLoop.data(), rasterTime.data(), nRaster);
+  }
+  auto t2 = std::chrono::steady_clock::now();
+
+  printf("%lld samples, %.3f s\n", (long long)n, c.t[n -1]);
+  printf("%zu spikes detected\n", spikes.size());
+  printf("%zu stimulus onsets, %lld points per loop, %lld loops\n", onsets.size(),
+         (long long)loopLen, (long long)loops);
+  printf("load %.3f s, analysis %.3f s\n", std::chrono::duration<double>(t1 -t0).count(),
+         std::chrono::duration<double>(t2 -t1).count());
+
+  // Results
+  //
+  if(prefix != NULL) {
+    FILE* f = openOutput(prefix, "_spikes.csv");
+    fprintf(f, "sample, time_s\n");
+    for(int64_t s : spikes) fprintf(f, "%lld, %.6f\n", (long long)s, c.t[s]);
+    fclose(f);
+
+    f = openOutput(prefix, "_rate.csv");
+    fprintf(f, "time_s, rate_hz\n");
+    for(int64_t i=0; i<n; i++) fprintf(f, "%.6f, %.4f\n", c.t[i], rate[i]);
+    fclose(f);
+
+    f = openOutput(prefix, "_loops.csv");
+    fprintf(f, "time_s, rate_hz, v, I_total, stim\n");
+    for(int64_t j=0; j<loopLen; j++) {
+      fprintf(f, "%.6f, %.4f, %.4f, %.4f, %.4f\n", c.t[j], rateMean[j], vMean[j], IMean[j], stimMean[j]);
+    }
+    fclose(f);
+
+    f = openOutput(prefix, "_raster.csv");
+    fprintf(f, "loop, time_s\n");
+    for(size_t i=0; i<rasterLoop.size(); i++) fprintf(f, "%d, %.6f\n", rasterLoop[i], rasterTime[i]);
+    fclose(f);
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
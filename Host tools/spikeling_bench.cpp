@@ -0,0 +1,399 @@
+// -----------------------------------------------------------------------------
+// spikeling_bench - times the stages of loop() in Spikeling.ino on the host
+//
+// Usage: spikeling_bench [--benchmark_filter=regex] [--benchmark_min_time=s]
+//                        [--benchmark_format=console|json]
+//                        [--benchmark_out=file.json]
+//
+// Works like a Google Benchmark binary (same options and JSON report), so
+// two reports can be compared with Google Benchmark's tools/compare.py:
+//   compare.py benchmarks before.json after.json
+// The stages run on the firmware's own globals via the host settings
+// (SettingsHost.h); the float and the fixed-point model are timed side by
+// side. For timing on the board itself, see USES_STAGE_PROFILING.
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Spikeling.ino"
+#include "FixedPoint.h"
+#include "Network.h"
+
+// -----------------------------------------------------------------------------
+// Harness
+// -----------------------------------------------------------------------------
+struct Benchmark {
+  std::string                      name;
+  std::function<void(uint64_t n)>  run;     // runs the body n times
+};
+
+struct Result {
+  std::string name;
+  uint64_t    iterations;
+  double      realTime_ns;
+  double      cpuTime_ns;
+};
+
+static volatile uint32_t Sink;              // keeps results alive
+
+// Stops the compiler from keeping globals in registers across iterations
+// (as benchmark::ClobberMemory() does)
+//
+static inline void clobberMemory()
+{
+  #if defined(__GNUC__)
+    asm volatile("" : : : "memory");
+  #endif
+}
+
+static double cpuSeconds()
+{
+  return (double)std::clock() /CLOCKS_PER_SEC;
+}
+
+static Result measure(const Benchmark& bm, double minTime)
+{
+  uint64_t n = 1;
+
+  for(;;) {
+    double cpu0 = cpuSeconds();
+    auto   t0   = std::chrono::steady_clock::now();
+    bm.run(n);
+    double real = std::chrono::duration<double>(std::chrono::steady_clock::now() -t0).count();
+    double cpu  = cpuSeconds() -cpu0;
+
+    if((real >= minTime) || (n >= 1000000000ULL)) {
+      return {bm.name, n, real *1E9 /n, cpu *1E9 /n};
+    }
+    // Aim at 1.4x the minimum time, as Google Benchmark does
+    //
+    double next = (real > 0) ? minTime *1.4 /(real /n) : (double)n *100;
+    n = (uint64_t)std::min(std::max(next, (double)n *2), (double)n *100);
+  }
+}
+
+// Repeat `body` n times
+//
+template <typename F>
+static std::function<void(uint64_t)> loopOf(F body)
+{
+  return [body](uint64_t n) {
+    for(uint64_t i=0; i<n; i++) {
+      body(i);
+      clobberMemory();
+    }
+  };
+}
+
+// -----------------------------------------------------------------------------
+// Benchmarks, one per stage of loop()
+// -----------------------------------------------------------------------------
+static model_config_t Cfg;
+static model_mode_t   Mode;
+static fx_config_t    FxCfg;
+static fx_mode_t      FxMode;
+
+static model_input_t makeInput(uint64_t i)
+{
+  model_input_t in;
+  in.VmPotVal       = 470;
+  in.AnalogInPotVal = 512;
+  in.AnalogInVal    = 0;
+  in.PDVal_smoothed = (i & 0x400) ? 180 : 20;
+  in.Syn1PotVal     = 300;
+  in.Syn2PotVal     = 700;
+  in.SpikeIn1State  = (i & 0x3FF) == 0;
+  in.SpikeIn2State  = (i & 0x7FF) == 0;
+  in.Noise          = ((long)(i % 11) -5) *NOISE_SCALE;
+  return in;
+}
+
+static std::vector<Benchmark> makeBenchmarks()
+{
+  std::vector<Benchmark> bms;
+
+  modelInitConfig(&Cfg, timestep_ms, Synapse_decay, PD_gain_min, PD_Scaling,
+                  VmPotiScaling, AnalogInScaling, SynapseScaling, AnalogInActive);
+  modelInitMode(&Mode, Array_a[0], Array_b[0], Array_c[0], Array_d[0],
+                Array_PD_decay[0], Array_PD_recovery[0], Array_PD_polarity[0]);
+  fxInitConfig(&FxCfg, timestep_ms, Synapse_decay, PD_gain_min, PD_Scaling,
+               VmPotiScaling, AnalogInScaling, SynapseScaling, AnalogInActive);
+  fxInitMode(&FxMode, Array_a[0], Array_b[0], Array_c[0], Array_d[0],
+             Array_PD_decay[0], Array_PD_recovery[0], Array_PD_polarity[0],
+             timestep_ms);
+
+  bms.push_back({"BM_ButtonPoll", loopOf([](uint64_t) { serviceButton(); })});
+
+  bms.push_back({"BM_ReadInputs", loopOf([](uint64_t) {
+    InputsDue = IN_ALL;
+    readInputs();
+  })});
+
+  const struct { const char* name; int type, window; } filters[] = {
+    {"boxcar:10", PD_FILTER_BOXCAR, 10}, {"ema:10", PD_FILTER_EMA, 10},
+    {"fir:5", PD_FILTER_FIR, 5}};
+  for(const auto& f : filters) {
+    int type = f.type, window = f.window;
+    bms.push_back({std::string("BM_PDFilter/") +f.name, [type, window](uint64_t n) {
+      pdfilter_t flt;
+      pdfInit(&flt, type, window, 0);
+      for(uint64_t i=0; i<n; i++) {
+        Sink = pdfUpdate(&flt, (uint16_t)(i & 0x3FF));
+      }
+    }});
+  }
+
+  bms.push_back({"BM_Currents/float", [](uint64_t n) {
+    model_state_t s;
+    modelInitState(&s);
+    for(uint64_t i=0; i<n; i++) {
+      model_input_t in = makeInput(i);
+      modelCurrents(&s, &in, &Mode, &Cfg);
+    }
+    Sink = (uint32_t)s.I_total;
+  }});
+  bms.push_back({"BM_Currents/fixed", [](uint64_t n) {
+    fx_state_t s;
+    fxInitState(&s);
+    for(uint64_t i=0; i<n; i++) {
+      model_input_t in = makeInput(i);
+      fxCurrents(&s, &in, &FxMode, &FxCfg);
+    }
+    Sink = (uint32_t)s.I_total;
+  }});
+
+  bms.push_back({"BM_Izhikevich/float", [](uint64_t n) {
+    model_state_t s;
+    modelInitState(&s);
+    s.I_total = 10;
+    for(uint64_t i=0; i<n; i++) {
+      Sink += modelIntegrate(&s, &Mode, &Cfg);
+    }
+  }});
+  bms.push_back({"BM_Izhikevich/fixed", [](uint64_t n) {
+    fx_state_t s;
+    fxInitState(&s);
+    s.I_total = Q16(10);
+    for(uint64_t i=0; i<n; i++) {
+      Sink += fxIntegrate(&s, &FxMode, &FxCfg);
+    }
+  }});
+
+  for(int n : {1, 8, 32}) {
+    bms.push_back({"BM_Network/" +std::to_string(n), [n](uint64_t iters) {
+      static network_t net;
+      netInit(&net, n, &Mode);
+      netConnect(&net, NET_CONN_RING, 10.0f);
+      for(uint64_t i=0; i<iters; i++) {
+        Sink += netStep(&net, 10.0f, &Cfg);
+      }
+    }});
+  }
+
+  bms.push_back({"BM_Outputs", loopOf([](uint64_t i) {
+    v = (i & 0x3F) -90.0f;
+    writeOutputs();
+  })});
+
+  // Noise current increment and stimulator bit: random() of Spikeling 1.x (the
+  // avr-libc generator, see SettingsHost.h) against Noise.h, with the range
+  // of the noise dial turned fully up
+  //
+  const long noiseRange = modelNoiseRange(0, NoiseScaling);
+  bms.push_back({"BM_Noise/random", [noiseRange](uint64_t n) {
+    for(uint64_t i=0; i<n; i++) {
+      Sink += random(-noiseRange, noiseRange);
+    }
+  }});
+  const struct { const char* name; uint8_t gaussian; } incs[] = {
+    {"uniform", 0}, {"gauss", 1}};
+  for(const auto& inc : incs) {
+    uint8_t gaussian = inc.gaussian;
+    bms.push_back({std::string("BM_Noise/") +inc.name, [noiseRange, gaussian](uint64_t n) {
+      noise_t nz;
+      noiseSeed(&nz, 1);
+      for(uint64_t i=0; i<n; i++) {
+        Sink += noiseIncrement(&nz, noiseRange, gaussian);
+      }
+    }});
+  }
+  bms.push_back({"BM_NoiseBit/random", [](uint64_t n) {
+    for(uint64_t i=0; i<n; i++) {
+      Sink += (random(100) >= 50);
+    }
+  }});
+  bms.push_back({"BM_NoiseBit/xorshift", [](uint64_t n) {
+    noise_t nz;
+    noiseSeed(&nz, 1);
+    for(uint64_t i=0; i<n; i++) {
+      Sink += noiseBit(&nz);
+    }
+  }});
+
+  const struct { const char* name; int mode; } stims[] = {
+    {"off", 0}, {"step", 1}, {"noise", 2}};
+  for(const auto& st : stims) {
+    int mode = st.mode;
+    bms.push_back({std::string("BM_Stimulator/") +st.name, [mode](uint64_t n) {
+      int prev = Array_DigiOutMode[NeuronBehaviour];
+      Array_DigiOutMode[NeuronBehaviour] = mode;
+      for(uint64_t i=0; i<n; i++) {
+        stimulator();
+        clobberMemory();
+      }
+      Array_DigiOutMode[NeuronBehaviour] = prev;
+    }});
+  }
+
+  for(int fm=0; fm<3; fm++) {
+    bms.push_back({"BM_Serial/ascii:" +std::to_string(fm), [fm](uint64_t n) {
+      SerialMode = 0;
+      FastMode   = fm;
+      for(uint64_t i=0; i<n; i++) sendSample((unsigned long)i *1000, 0);
+      FastMode   = 0;
+    }});
+  }
+  bms.push_back({"BM_Serial/binary", [](uint64_t n) {
+    SerialMode = 1;
+    for(uint64_t i=0; i<n; i++) sendSample((unsigned long)i *1000, 0);
+    SerialMode = 0;
+  }});
+
+  bms.push_back({"BM_Loop", loopOf([](uint64_t) {
+    loop();
+    HostMicros += 1000;
+  })});
+  return bms;
+}
+
+// -----------------------------------------------------------------------------
+// Reports
+// -----------------------------------------------------------------------------
+static void printConsoleHeader(FILE* f)
+{
+  fprintf(f, "%-28s %15s %15s %12s\n", "Benchmark", "Time", "CPU", "Iterations");
+  fprintf(f, "%s\n", std::string(73, '-').c_str());
+}
+
+static void printConsole(FILE* f, const std::vector<Result>& results)
+{
+  for(const Result& r : results) {
+    fprintf(f, "%-28s %12.1f ns %12.1f ns %12llu\n", r.name.c_str(),
+            r.realTime_ns, r.cpuTime_ns, (unsigned long long)r.iterations);
+  }
+}
+
+static void printJson(FILE* f, const std::vector<Result>& results, const char* exe)
+{
+  char        date[64], host[256] = "";
+  std::time_t now = std::time(NULL);
+
+  std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%S%z", std::localtime(&now));
+  gethostname(host, sizeof(host) -1);
+
+  fprintf(f, "{\n  \"context\": {\n");
+  fprintf(f, "    \"date\": \"%s\",\n", date);
+  fprintf(f, "    \"host_name\": \"%s\",\n", host);
+  fprintf(f, "    \"executable\": \"%s\",\n", exe);
+  fprintf(f, "    \"num_cpus\": %u,\n", std::thread::hardware_concurrency());
+  fprintf(f, "    \"mhz_per_cpu\": 0,\n");
+  fprintf(f, "    \"cpu_scaling_enabled\": false,\n");
+  fprintf(f, "    \"caches\": [],\n");
+  #ifdef USES_FIXED_POINT
+  fprintf(f, "    \"spikeling_model\": \"fixed\",\n");
+  #else
+  fprintf(f, "    \"spikeling_model\": \"float\",\n");
+  #endif
+  fprintf(f, "    \"library_build_type\": \"release\"\n  },\n");
+  fprintf(f, "  \"benchmarks\": [\n");
+  for(size_t i=0; i<results.size(); i++) {
+    const Result& r = results[i];
+    fprintf(f, "    {\n");
+    fprintf(f, "      \"name\": \"%s\",\n", r.name.c_str());
+    fprintf(f, "      \"family_index\": %zu,\n", i);
+    fprintf(f, "      \"per_family_instance_index\": 0,\n");
+    fprintf(f, "      \"run_name\": \"%s\",\n", r.name.c_str());
+    fprintf(f, "      \"run_type\": \"iteration\",\n");
+    fprintf(f, "      \"repetitions\": 1,\n");
+    fprintf(f, "      \"repetition_index\": 0,\n");
+    fprintf(f, "      \"threads\": 1,\n");
+    fprintf(f, "      \"iterations\": %llu,\n", (unsigned long long)r.iterations);
+    fprintf(f, "      \"real_time\": %.6e,\n", r.realTime_ns);
+    fprintf(f, "      \"cpu_time\": %.6e,\n", r.cpuTime_ns);
+    fprintf(f, "      \"time_unit\": \"ns\"\n");
+    fprintf(f, "    }%s\n", (i+1 < results.size()) ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+}
+
+// -----------------------------------------------------------------------------
+static bool getOption(const char* arg, const char* name, std::string* value)
+{
+  size_t len = strlen(name);
+  if((strncmp(arg, name, len) != 0) || (arg[len] != '=')) return false;
+  *value = arg +len +1;
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  std::string filter = ".", format = "console", outFName, value;
+  double      minTime = 0.5;
+
+  for(int i=1; i<argc; i++) {
+    if(getOption(argv[i], "--benchmark_filter", &value)) filter = value;
+    else if(getOption(argv[i], "--benchmark_min_time", &value)) minTime = atof(value.c_str());
+    else if(getOption(argv[i], "--benchmark_format", &value)) format = value;
+    else if(getOption(argv[i], "--benchmark_out", &value)) outFName = value;
+    else {
+      fprintf(stderr, "Usage: spikeling_bench [--benchmark_filter=regex] "
+              "[--benchmark_min_time=s] [--benchmark_format=console|json] "
+              "[--benchmark_out=file.json]\n");
+      return 1;
+    }
+  }
+
+  // Firmware set up as after reset, with dials off centre so that the model
+  // spikes; the serial output is discarded
+  //
+  for(int i=0; i<HOST_N_PINS; i++) HostPin[i] = 0;
+  HostPin[VmPotPin] = 470;
+  HostPin[Syn1PotPin] = HostPin[Syn2PotPin] = HostPin[NoisePotPin] = 512;
+  setup();
+
+  std::vector<Result> results;
+  std::regex          re(filter);
+
+  if(format == "console") printConsoleHeader(stdout);
+
+  for(const Benchmark& bm : makeBenchmarks()) {
+    if(std::regex_search(bm.name, re)) {
+      results.push_back(measure(bm, minTime));
+      if(format == "console") printConsole(stdout, {results.back()});
+    }
+  }
+  if(format == "json") {
+    printJson(stdout, results, argv[0]);
+  }
+  if(!outFName.empty()) {
+    FILE* f = fopen(outFName.c_str(), "w");
+    if(f == NULL) {
+      perror("spikeling_bench");
+      return 1;
+    }
+    printJson(f, results, argv[0]);
+    fclose(f);
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
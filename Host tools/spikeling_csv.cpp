@@ -0,0 +1,174 @@
+// -----------------------------------------------------------------------------
+// spikeling_csv - converts a binary Spikeling recording (SerialMode = 1, or
+// the compressed SerialMode = 3) into the CSV format of the ASCII output
+//
+// Usage: spikeling_csv [-p decimals] [-o output.csv] [-e events.csv]
+//                      [-k kernel.csv] [input]
+//
+// Without input file (or with "-"), the frames are read from stdin; without
+// output file, the CSV is written to stdout.
+//
+// Event recordings (SerialMode = 2) contain spikes, stimulator and mode
+// changes, synapse input pulses and a sample every EventSummaryEvery steps.
+// The samples go to the CSV as above, the events to the file given with -e,
+// one line per event:
+//
+//   event, step, time_us, value
+//
+// with event "spike", "stim", "mode", "syn1" or "syn2", the step with its
+// fraction for spikes (the time of the 30 mV crossing), the new state for
+// stim and mode, and the number of pulses in the step for the synapse inputs
+// (time_us is then the time of the latest pulse, see USES_SYNAPSE_EDGES).
+//
+// The spike-triggered average computed on the board (USES_STA, sent in any
+// binary SerialMode; only this with SerialMode = 4) goes to the file given
+// with -k, one line per point of each complete report:
+//
+//   time_s, spikes, point, stim, I_PD
+//
+// with the means over `spikes` spikes; point 0 is the earliest step of the
+// window, the last point the step before the spike.
+//
+// To record directly from a board
+// on Linux, configure the port first, e.g.:
+//   stty -F /dev/ttyUSB0 234000 raw && spikeling_csv -o run.csv /dev/ttyUSB0
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "FrameDecoder.h"
+#include "CsvWriter.h"
+
+// -----------------------------------------------------------------------------
+static void usage()
+{
+  fprintf(stderr, "Usage: spikeling_csv [-p decimals] [-o output.csv] [-e events.csv] "
+                  "[-k kernel.csv] [input]\n");
+  exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+  const char* inFName  = "-";
+  const char* outFName = NULL;
+  const char* evFName  = NULL;
+  const char* staFName = NULL;
+  int         precision = CSV_DEFAULT_PRECISION;
+
+  for(int i=1; i<argc; i++) {
+    if((strcmp(argv[i], "-o") == 0) && (i+1 < argc)) {
+      outFName = argv[++i];
+    }
+    else if((strcmp(argv[i], "-e") == 0) && (i+1 < argc)) {
+      evFName = argv[++i];
+    }
+    else if((strcmp(argv[i], "-k") == 0) && (i+1 < argc)) {
+      staFName = argv[++i];
+    }
+    else if((strcmp(argv[i], "-p") == 0) && (i+1 < argc)) {
+      precision = atoi(argv[++i]);
+    }
+    else if((argv[i][0] == '-') && (argv[i][1] != 0)) {
+      usage();
+    }
+    else {
+      inFName = argv[i];
+    }
+  }
+
+  FILE* fIn  = (strcmp(inFName, "-") == 0) ? stdin : fopen(inFName, "rb");
+  FILE* fOut = (outFName == NULL) ? stdout : fopen(outFName, "w");
+  FILE* fEv  = (evFName == NULL) ? NULL : fopen(evFName, "w");
+  FILE* fSta = (staFName == NULL) ? NULL : fopen(staFName, "w");
+  if((fIn == NULL) || (fOut == NULL) || ((evFName != NULL) && (fEv == NULL)) ||
+     ((staFName != NULL) && (fSta == NULL))) {
+    perror("spikeling_csv");
+    return 1;
+  }
+
+  // Decode frames and write one line per sample
+  //
+  FrameDecoder       decoder;
+  DeltaStreamDecoder deltaDecoder;
+  uint64_t     nSamples = 0, nTickMissed = 0, nEvents = 0, nKernels = 0;
+  Event        ev;
+  StaPart      part;
+  std::vector<stapoint_t> kernel;   // parts of the current STA report so far
+  uint32_t     kernelSpikes = 0;
+
+  if(fEv != NULL) fprintf(fEv, "event, step, time_us, value\n");
+  if(fSta != NULL) fprintf(fSta, "time_s, spikes, point, stim, I_PD\n");
+  uint8_t      buf[4096];
+  size_t       n;
+
+  while((n = fread(buf, 1, sizeof(buf), fIn)) > 0) {
+    decoder.feed(buf, n, [&](const Frame& frame) {
+      output_t o;
+      auto onSample = [&](const output_t& s) {
+        writeCsvLine(fOut, s, precision);
+        nSamples++;
+        nTickMissed += s.TickMissed;
+      };
+      if(decodeSample(frame, &o)) {
+        onSample(o);
+      }
+      else if(decodeEvent(frame, &ev)) {
+        if(fEv != NULL) {
+          const char* name = (ev.type == FRAME_TYPE_SPIKE) ? "spike" :
+                             (ev.type == FRAME_TYPE_STIM) ? "stim" :
+                             (ev.type == FRAME_TYPE_MODE) ? "mode" :
+                             (ev.type == FRAME_TYPE_SYN1) ? "syn1" : "syn2";
+          fprintf(fEv, "%s, %.4f, %lu, %d\n", name, ev.step, (unsigned long)ev.t_us, ev.value);
+        }
+        nEvents++;
+      }
+      else if(!deltaDecoder.frame(frame, onSample) && decodeSta(frame, &part)) {
+        // collect the parts of one report, in order
+        if(part.first == 0) kernel.clear();
+        if((part.first != kernel.size()) || (!kernel.empty() && (part.spikes != kernelSpikes))) {
+          kernel.clear();
+          return;
+        }
+        kernelSpikes = part.spikes;
+        kernel.insert(kernel.end(), part.sums.begin(), part.sums.end());
+        if(kernel.size() == part.points) {
+          double scale = (kernelSpikes > 0) ? 1.0 /kernelSpikes : 0;
+          for(size_t j=0; (fSta != NULL) && (j < kernel.size()); j++) {
+            fprintf(fSta, "%.6f, %lu, %zu, %.4f, %.4f\n", part.t_us *1e-6, (unsigned long)kernelSpikes,
+                    j, kernel[j].stim *scale, kernel[j].pd *scale /STA_PD_SCALE);
+          }
+          kernel.clear();
+          nKernels++;
+        }
+      }
+    });
+  }
+
+  const FrameStats& st = decoder.stats();
+  if(nEvents > 0) {
+    fprintf(stderr, "%llu events%s\n", (unsigned long long)nEvents,
+            (fEv == NULL) ? " (not written, use -e)" : "");
+  }
+  if(nKernels > 0) {
+    fprintf(stderr, "%llu STA reports%s\n", (unsigned long long)nKernels,
+            (fSta == NULL) ? " (not written, use -k)" : "");
+  }
+  if(deltaDecoder.framesSkipped() > 0) {
+    fprintf(stderr, "%llu delta frames skipped (waiting for a key frame after a loss)\n",
+            (unsigned long long)deltaDecoder.framesSkipped());
+  }
+  fprintf(stderr, "%llu samples (%llu after missed ticks), %llu frames, "
+          "%llu lost (%llu gaps), %llu CRC errors, %llu bytes skipped\n",
+          (unsigned long long)nSamples, (unsigned long long)nTickMissed,
+          (unsigned long long)st.frames,
+          (unsigned long long)st.framesLost, (unsigned long long)st.seqGaps,
+          (unsigned long long)st.crcErrors, (unsigned long long)st.bytesSkipped);
+
+  if(fIn != stdin) fclose(fIn);
+  if(fOut != stdout) fclose(fOut);
+  if(fEv != NULL) fclose(fEv);
+  if(fSta != NULL) fclose(fSta);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,155 @@
+// -----------------------------------------------------------------------------
+// spikeling_ingest - writes the samples from the board as a clean stream in
+// the order of their sequence numbers, and reports lost, repeated and
+// reordered samples while it runs (see SequenceBuffer.h)
+//
+// Usage: spikeling_ingest [-b] [-w window] [-u seconds] [-p decimals]
+//                         [-o output.csv] [input]
+//
+//   -b  input is binary frames (SerialMode = 1), numbered by the frame
+//       counter; otherwise ASCII lines with the record number as 10th column
+//       (SerialMode = 0, FastMode = 0, SerialSeq = 1). Other lines (e.g.
+//       "Model rate:") and frames (e.g. the on-board STA) are skipped
+//   -w  records held back to put late ones into order, default 64
+//   -u  report the counts on stderr every n seconds (wall clock), default 2
+//   -p  decimals of the float columns, default 2
+//   -o  output file, default stdout
+//
+// The output has the 9 columns of the ASCII output plus the sequence number
+// as 10th column; "spikelingFunctions.m" takes such files as they are,
+// without sorting or thinning. At the end, the counts are written to stderr:
+// records received and written, numbers lost, duplicates, records that
+// arrived out of order (and were put back) and late ones (that arrived after
+// they were counted as lost, and were dropped).
+//
+// Without input file (or with "-"), the data is read from stdin, e.g. from a
+// board on Linux:
+//   stty -F /dev/ttyUSB0 234000 raw && spikeling_ingest -o run.csv /dev/ttyUSB0
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include "SequenceBuffer.h"
+#include "FrameDecoder.h"
+#include "CsvWriter.h"
+
+// -----------------------------------------------------------------------------
+static void report(const SequenceBuffer& seq, uint64_t skipped, const char* end)
+{
+  const SequenceStats& st = seq.stats();
+
+  fprintf(stderr, "\r%llu received, %llu written, %llu lost, %llu duplicates, "
+          "%llu reordered, %llu late, %llu restarts, %llu lines skipped%s",
+          (unsigned long long)st.received, (unsigned long long)st.written,
+          (unsigned long long)st.lost, (unsigned long long)st.duplicates,
+          (unsigned long long)st.reordered, (unsigned long long)st.late,
+          (unsigned long long)st.restarts, (unsigned long long)skipped, end);
+}
+
+static void usage()
+{
+  fprintf(stderr, "Usage: spikeling_ingest [-b] [-w window] [-u seconds] [-p decimals] "
+          "[-o output.csv] [input]\n");
+  exit(1);
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  const char* inFName  = "-";
+  const char* outFName = NULL;
+  bool        frames = false;
+  long        window = 64;
+  double      every = 2;
+  int         precision = CSV_DEFAULT_PRECISION;
+
+  for(int i=1; i<argc; i++) {
+    bool hasArg = (i+1 < argc);
+    if(strcmp(argv[i], "-b") == 0) frames = true;
+    else if((strcmp(argv[i], "-w") == 0) && hasArg) window = atol(argv[++i]);
+    else if((strcmp(argv[i], "-u") == 0) && hasArg) every = atof(argv[++i]);
+    else if((strcmp(argv[i], "-p") == 0) && hasArg) precision = atoi(argv[++i]);
+    else if((strcmp(argv[i], "-o") == 0) && hasArg) outFName = argv[++i];
+    else if((argv[i][0] == '-') && (argv[i][1] != 0)) usage();
+    else inFName = argv[i];
+  }
+  if(window < 1) usage();
+
+  FILE* fIn  = (strcmp(inFName, "-") == 0) ? stdin : fopen(inFName, frames ? "rb" : "r");
+  FILE* fOut = (outFName == NULL) ? stdout : fopen(outFName, "w");
+  if((fIn == NULL) || (fOut == NULL)) {
+    perror("spikeling_ingest");
+    return 1;
+  }
+
+  SequenceBuffer seq((size_t)window);
+  FrameDecoder   decoder;
+  uint64_t       skipped = 0;
+  auto           write = [&](const output_t& o) {
+    fprintf(fOut, "%.*f, %.*f, %d, %d, %d, %.*f, %.*f, %.*f, %lu, %lu\n",
+            precision, o.v, precision, o.I_total,
+            o.Stim_State, o.SpikeIn1State, o.SpikeIn2State,
+            precision, o.I_PD, precision, o.I_AnalogIn, precision, o.I_Synapse,
+            (unsigned long)o.currentMicros, (unsigned long)o.Seq);
+  };
+  auto           tLast = std::chrono::steady_clock::now();
+  char           line[256];
+  uint8_t        buf[256];
+  size_t         n;
+
+  for(;;) {
+    if(frames) {
+      // (small reads, so that a slow serial port is processed as it comes)
+      if((n = fread(buf, 1, sizeof(buf), fIn)) == 0) break;
+      decoder.feed(buf, n, [&](const Frame& frame) {
+        output_t o;
+        uint64_t s = unwrapSeq(seq.last(), frame.seq, 16);
+        memset(&o, 0, sizeof(o));
+        if(decodeSample(frame, &o)) {
+          o.Seq = (unsigned long)s;
+          seq.add(s, &o, write);
+        }
+        else {
+          seq.add(s, NULL, write);
+        }
+      });
+    }
+    else {
+      output_t      o;
+      unsigned long t, s;
+      if(fgets(line, sizeof(line), fIn) == NULL) break;
+      memset(&o, 0, sizeof(o));
+      if(sscanf(line, "%f, %f, %d, %d, %d, %f, %f, %f, %lu, %lu", &o.v, &o.I_total,
+                &o.Stim_State, &o.SpikeIn1State, &o.SpikeIn2State, &o.I_PD,
+                &o.I_AnalogIn, &o.I_Synapse, &t, &s) != 10) {
+        if(strspn(line, "\r\n") != strlen(line)) skipped++;
+        continue;
+      }
+      uint64_t u = unwrapSeq(seq.last(), (uint32_t)s, 32);
+      o.currentMicros = t;
+      o.Seq           = (unsigned long)u;
+      seq.add(u, &o, write);
+    }
+    auto now = std::chrono::steady_clock::now();
+    if(std::chrono::duration<double>(now -tLast).count() >= every) {
+      report(seq, skipped, "   ");
+      fflush(fOut);
+      tLast = now;
+    }
+  }
+  seq.flush(write);
+  report(seq, skipped, "\n");
+  if(frames) {
+    const FrameStats& st = decoder.stats();
+    fprintf(stderr, "%llu frames, %llu CRC errors, %llu bytes skipped\n",
+            (unsigned long long)st.frames, (unsigned long long)st.crcErrors,
+            (unsigned long long)st.bytesSkipped);
+  }
+
+  if(fIn != stdin) fclose(fIn);
+  if(fOut != stdout) fclose(fOut);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,150 @@
+// -----------------------------------------------------------------------------
+// spikeling_online - spike-triggered average, loop averages and PSTH of a
+// running experiment, updated with every sample from the board (see
+// OnlineAnalysis.h)
+//
+// Usage: spikeling_online [-b] [-T threshold] [-w stapoints] [-l looplength]
+//                         [-p psthbin] [-u seconds] -o prefix [input]
+//
+//   -b  input is binary frames (SerialMode = 1 or 3), otherwise CSV lines
+//   -T  spike threshold in mV, default 10
+//   -w  STA window in samples before each spike, default 200
+//   -l  loop length in samples, default: distance of the first two onsets
+//   -p  samples per PSTH bin, default 10
+//   -u  write the results every n seconds (wall clock), default 2
+//   -o  results, replaced on every update:
+//         <prefix>_sta.csv    time_s (before the spike), Stim_State, I_total
+//         <prefix>_loops.csv  time_s (after the onset), v, I_total, Stim_State
+//         <prefix>_psth.csv   time_s (bin start), rate_hz
+//
+// Without input file (or with "-"), the data is read from stdin, e.g. from a
+// board on Linux:
+//   stty -F /dev/ttyUSB0 234000 raw && spikeling_online -o live /dev/ttyUSB0
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include "OnlineAnalysis.h"
+#include "FrameDecoder.h"
+
+// -----------------------------------------------------------------------------
+// Write a file under a temporary name and rename it, so that a reader (e.g. a
+// plot that reloads the file) never sees a partial result
+//
+static bool writeResult(const std::string& fName, const char* header,
+                        const std::vector<const std::vector<double>*>& cols, double dt, double t0)
+{
+  std::string tmp = fName +".tmp";
+  FILE*       f = fopen(tmp.c_str(), "w");
+
+  if(f == NULL) return false;
+  fprintf(f, "%s\n", header);
+  for(size_t i=0; i<cols[0]->size(); i++) {
+    fprintf(f, "%.6f", t0 +i *dt);
+    for(const std::vector<double>* c : cols) fprintf(f, ", %.4f", (*c)[i]);
+    fprintf(f, "\n");
+  }
+  fclose(f);
+  return rename(tmp.c_str(), fName.c_str()) == 0;
+}
+
+static void writeResults(const OnlineAnalysis& an, const std::string& prefix, int psthBin)
+{
+  std::vector<double> a, b, c;
+  double              dt = an.sampleInterval();
+
+  an.sta(&a, &b);
+  writeResult(prefix +"_sta.csv", "time_s, Stim_State, I_total", {&a, &b}, dt, -(double)a.size() *dt);
+  an.loopMeans(&a, &b, &c);
+  writeResult(prefix +"_loops.csv", "time_s, v, I_total, Stim_State", {&a, &b, &c}, dt, 0);
+  an.psth(&a);
+  writeResult(prefix +"_psth.csv", "time_s, rate_hz", {&a}, dt *psthBin, 0);
+
+  fprintf(stderr, "\r%llu samples, %llu spikes (%llu in STA), %llu onsets, loop %lld samples   ",
+          (unsigned long long)an.samples(), (unsigned long long)an.spikes(),
+          (unsigned long long)an.staSpikes(), (unsigned long long)an.onsets(),
+          (long long)an.loopLength());
+}
+
+static void usage()
+{
+  fprintf(stderr, "Usage: spikeling_online [-b] [-T threshold] [-w stapoints] [-l looplength] "
+          "[-p psthbin] [-u seconds] -o prefix [input]\n");
+  exit(1);
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  OnlineOptions opt;
+  const char*   inFName = "-";
+  const char*   prefix = NULL;
+  bool          frames = false;
+  double        every = 2;
+
+  for(int i=1; i<argc; i++) {
+    bool hasArg = (i+1 < argc);
+    if(strcmp(argv[i], "-b") == 0) frames = true;
+    else if((strcmp(argv[i], "-T") == 0) && hasArg) opt.thresh = atof(argv[++i]);
+    else if((strcmp(argv[i], "-w") == 0) && hasArg) opt.staPoints = atoi(argv[++i]);
+    else if((strcmp(argv[i], "-l") == 0) && hasArg) opt.loopLen = atol(argv[++i]);
+    else if((strcmp(argv[i], "-p") == 0) && hasArg) opt.psthBin = atoi(argv[++i]);
+    else if((strcmp(argv[i], "-u") == 0) && hasArg) every = atof(argv[++i]);
+    else if((strcmp(argv[i], "-o") == 0) && hasArg) prefix = argv[++i];
+    else if((argv[i][0] == '-') && (argv[i][1] != 0)) usage();
+    else inFName = argv[i];
+  }
+  if((prefix == NULL) || (opt.staPoints < 1) || (opt.psthBin < 1) || (opt.loopLen < 0)) usage();
+
+  FILE* fIn = (strcmp(inFName, "-") == 0) ? stdin : fopen(inFName, frames ? "rb" : "r");
+  if(fIn == NULL) {
+    perror("spikeling_online");
+    return 1;
+  }
+
+  OnlineAnalysis     an(opt);
+  FrameDecoder       decoder;
+  DeltaStreamDecoder deltaDecoder;
+  auto               add = [&](const output_t& o) { an.add(o); };
+  auto               tLast = std::chrono::steady_clock::now();
+  char               line[256];
+  uint8_t            buf[256];
+  size_t             n;
+
+  for(;;) {
+    if(frames) {
+      // (small reads, so that a slow serial port is processed as it comes)
+      if((n = fread(buf, 1, sizeof(buf), fIn)) == 0) break;
+      decoder.feed(buf, n, [&](const Frame& frame) {
+        output_t o;
+        if(decodeSample(frame, &o)) add(o);
+        else deltaDecoder.frame(frame, add);
+      });
+    }
+    else {
+      output_t      o;
+      unsigned long t;
+      if(fgets(line, sizeof(line), fIn) == NULL) break;
+      memset(&o, 0, sizeof(o));
+      if(sscanf(line, "%f, %f, %d, %d, %d, %f, %f, %f, %lu", &o.v, &o.I_total,
+                &o.Stim_State, &o.SpikeIn1State, &o.SpikeIn2State, &o.I_PD,
+                &o.I_AnalogIn, &o.I_Synapse, &t) != 9) continue;
+      o.currentMicros = t;
+      add(o);
+    }
+    auto now = std::chrono::steady_clock::now();
+    if(std::chrono::duration<double>(now -tLast).count() >= every) {
+      writeResults(an, prefix, opt.psthBin);
+      tLast = now;
+    }
+  }
+  writeResults(an, prefix, opt.psthBin);
+  fprintf(stderr, "\n");
+
+  if(fIn != stdin) fclose(fIn);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
@@ -0,0 +1,247 @@
+// -----------------------------------------------------------------------------
+// spikeling_rec - converts recordings into the chunked, columnar format of
+// Recording.h (.spkr) and reads overviews and windows from them
+//
+// Usage: spikeling_rec convert [-b] [-k chunksamples] input output.spkr
+//        spikeling_rec info rec.spkr
+//        spikeling_rec overview [-c column] [-n bins] [-t from:to] rec.spkr
+//        spikeling_rec export [-t from:to] [-p decimals] rec.spkr
+//
+// convert   reads a CSV recording (ASCII output, or the output of
+//           spikeling_csv) or, with -b, binary frames (SerialMode = 1 or 3)
+//           from a file, a serial port or stdin ("-"). Chunks have 65536
+//           samples by default (-k, a power of two of at least 4096). A live
+//           capture is stopped with Ctrl-C; the file is then closed as at
+//           the end of the input.
+// info      lists the chunks with their time range and the range of v.
+// overview  writes the min/max/mean of a column (default v) in at most -n
+//           bins (default 1000) as CSV lines "t0_s, t1_s, min, max, mean";
+//           only the summaries are read, not the samples.
+// export    writes the samples of a time window in the CSV format of the
+//           ASCII output.
+//
+// Times for -t are in seconds since the start of the firmware (currentMicros),
+// e.g. -t 3600:3660; either end can be left out (-t 3600:).
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <signal.h>
+#include "Recording.h"
+#include "FrameDecoder.h"
+#include "CsvWriter.h"
+
+// -----------------------------------------------------------------------------
+static void usage()
+{
+  fprintf(stderr, "Usage: spikeling_rec convert [-b] [-k chunksamples] input output.spkr\n"
+                  "       spikeling_rec info rec.spkr\n"
+                  "       spikeling_rec overview [-c column] [-n bins] [-t from:to] rec.spkr\n"
+                  "       spikeling_rec export [-t from:to] [-p decimals] rec.spkr\n");
+  exit(1);
+}
+
+static bool parseWindow(const char* arg, uint64_t* t0, uint64_t* t1)
+{
+  const char* colon = strchr(arg, ':');
+
+  if(colon == NULL) return false;
+  *t0 = (colon == arg) ? 0 : (uint64_t)(atof(arg) *1e6);
+  *t1 = (colon[1] == 0) ? UINT64_MAX : (uint64_t)(atof(colon +1) *1e6);
+  return *t0 <= *t1;
+}
+
+static bool openRecording(RecordingReader* rec, const char* fName)
+{
+  if(!rec->open(fName)) {
+    fprintf(stderr, "spikeling_rec: `%s` is not a recording\n", fName);
+    return false;
+  }
+  return true;
+}
+
+// -----------------------------------------------------------------------------
+// Ctrl-C (or SIGTERM) ends the input; installed without SA_RESTART so that a
+// blocking read from a serial port returns
+//
+static volatile sig_atomic_t Stop = 0;
+
+static void onStop(int)
+{
+  Stop = 1;
+}
+
+static void catchStop()
+{
+  struct sigaction sa;
+
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = onStop;
+  sigemptyset(&sa.sa_mask);
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+}
+
+// -----------------------------------------------------------------------------
+static int convert(int argc, char* argv[])
+{
+  const char* in = NULL, *out = NULL;
+  bool        frames = false;
+  long        chunkSamples = REC_CHUNK_SAMPLES;
+
+  for(int i=0; i<argc; i++) {
+    if(strcmp(argv[i], "-b") == 0) frames = true;
+    else if((strcmp(argv[i], "-k") == 0) && (i+1 < argc)) chunkSamples = atol(argv[++i]);
+    else if(in == NULL) in = argv[i];
+    else if(out == NULL) out = argv[i];
+    else usage();
+  }
+  if((out == NULL) || (chunkSamples < 4096) || (chunkSamples > (1L << 24)) ||
+     (chunkSamples & (chunkSamples -1))) {
+    usage();
+  }
+
+  FILE*           fIn = (strcmp(in, "-") == 0) ? stdin : fopen(in, frames ? "rb" : "r");
+  RecordingWriter writer;
+  if((fIn == NULL) || !writer.open(out, (uint32_t)chunkSamples)) {
+    perror("spikeling_rec");
+    return 1;
+  }
+  catchStop();
+
+  uint64_t nSamples = 0;
+  if(frames) {
+    FrameDecoder       decoder;
+    DeltaStreamDecoder deltaDecoder;
+    uint8_t            buf[4096];
+    size_t             n;
+    auto               add = [&](const output_t& o) { writer.add(o); nSamples++; };
+
+    while(!Stop && ((n = fread(buf, 1, sizeof(buf), fIn)) > 0)) {
+      decoder.feed(buf, n, [&](const Frame& frame) {
+        output_t o;
+        if(decodeSample(frame, &o)) add(o);
+        else deltaDecoder.frame(frame, add);
+      });
+    }
+  }
+  else {
+    char     line[256];
+    output_t o;
+    unsigned long t;
+
+    memset(&o, 0, sizeof(o));
+    while(!Stop && (fgets(line, sizeof(line), fIn) != NULL)) {
+      if(sscanf(line, "%f, %f, %d, %d, %d, %f, %f, %f, %lu", &o.v, &o.I_total,
+                &o.Stim_State, &o.SpikeIn1State, &o.SpikeIn2State, &o.I_PD,
+                &o.I_AnalogIn, &o.I_Synapse, &t) == 9) {
+        o.currentMicros = t;
+        writer.add(o);
+        nSamples++;
+      }
+    }
+  }
+  if(fIn != stdin) fclose(fIn);
+  if(!writer.close()) {
+    perror("spikeling_rec");
+    return 1;
+  }
+  fprintf(stderr, "%llu samples%s\n", (unsigned long long)nSamples, Stop ? " (stopped)" : "");
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+static int info(int argc, char* argv[])
+{
+  RecordingReader rec;
+
+  if(argc != 1) usage();
+  if(!openRecording(&rec, argv[0])) return 1;
+
+  printf("%llu samples in %llu chunks of %u\n", (unsigned long long)rec.nSamples(),
+         (unsigned long long)rec.nChunks(), rec.chunkSamples());
+  printf("chunk, samples, t0_s, t1_s, v_min, v_max, v_mean\n");
+  for(uint64_t k=0; k<rec.nChunks(); k++) {
+    const rec_chunk_t&   ch = rec.chunk(k);
+    const rec_summary_t& v  = ch.total[REC_COL_V -1];
+    printf("%llu, %u, %.6f, %.6f, %.2f, %.2f, %.2f\n", (unsigned long long)k, ch.nSamples,
+           ch.t0 *1e-6, ch.t1 *1e-6, v.min, v.max, v.mean);
+  }
+  return 0;
+}
+
+static int overview(int argc, char* argv[])
+{
+  RecordingReader           rec;
+  std::vector<RecordingBin> bins;
+  const char*               fName = NULL;
+  int                       col = REC_COL_V;
+  long                      nBins = 1000;
+  uint64_t                  t0 = 0, t1 = UINT64_MAX;
+
+  for(int i=0; i<argc; i++) {
+    bool hasArg = (i+1 < argc);
+    if((strcmp(argv[i], "-c") == 0) && hasArg) col = recColumnFind(argv[++i]);
+    else if((strcmp(argv[i], "-n") == 0) && hasArg) nBins = atol(argv[++i]);
+    else if((strcmp(argv[i], "-t") == 0) && hasArg) {
+      if(!parseWindow(argv[++i], &t0, &t1)) usage();
+    }
+    else if(fName == NULL) fName = argv[i];
+    else usage();
+  }
+  if((fName == NULL) || (col < 1) || (nBins < 1)) usage();
+  if(!openRecording(&rec, fName)) return 1;
+
+  rec.overview(col, t0, t1, (size_t)nBins, &bins);
+  printf("t0_s, t1_s, min, max, mean\n");
+  for(const RecordingBin& b : bins) {
+    printf("%.6f, %.6f, %.2f, %.2f, %.3f\n", b.t0 *1e-6, b.t1 *1e-6, b.s.min, b.s.max, b.s.mean);
+  }
+  return 0;
+}
+
+static int exportCsv(int argc, char* argv[])
+{
+  RecordingReader       rec;
+  std::vector<output_t> samples;
+  const char*           fName = NULL;
+  int                   precision = CSV_DEFAULT_PRECISION;
+  uint64_t              t0 = 0, t1 = UINT64_MAX;
+
+  for(int i=0; i<argc; i++) {
+    bool hasArg = (i+1 < argc);
+    if((strcmp(argv[i], "-p") == 0) && hasArg) precision = atoi(argv[++i]);
+    else if((strcmp(argv[i], "-t") == 0) && hasArg) {
+      if(!parseWindow(argv[++i], &t0, &t1)) usage();
+    }
+    else if(fName == NULL) fName = argv[i];
+    else usage();
+  }
+  if(fName == NULL) usage();
+  if(!openRecording(&rec, fName)) return 1;
+
+  // Only the chunks in the window are touched
+  //
+  uint64_t i0 = rec.findTime(t0);
+  uint64_t i1 = (t1 == UINT64_MAX) ? rec.nSamples() : rec.findTime(t1 +1);
+  for(uint64_t i=i0; i<i1; i+=rec.chunkSamples()) {
+    rec.read(i, std::min<uint64_t>(i +rec.chunkSamples(), i1), &samples);
+    for(const output_t& o : samples) writeCsvLine(stdout, o, precision);
+  }
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  if(argc < 2) usage();
+  if(strcmp(argv[1], "convert") == 0) return convert(argc -2, argv +2);
+  if(strcmp(argv[1], "info") == 0) return info(argc -2, argv +2);
+  if(strcmp(argv[1], "overview") == 0) return overview(argc -2, argv +2);
+  if(strcmp(argv[1], "export") == 0) return exportCsv(argc -2, argv +2);
+  usage();
+  return 1;
+}
+
+// -----------------------------------------------------------------------------
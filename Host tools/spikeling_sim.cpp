@@ -0,0 +1,240 @@
+// -----------------------------------------------------------------------------
+// spikeling_sim - runs the firmware (Spikeling.ino) on the host, driven by
+// scripted input traces instead of the dials, photodiode and inputs
+//
+// Usage: spikeling_sim [-n steps] [-m mode] [-t trace.csv] [-s input=value]
+//                      [-b | -E | -z | -k] [-S] [-N] [-c step:chars] [-R seed] [-U]
+//                      [-f fastmode] [-r rate] [-o output | -q]
+//
+//   -n  number of model steps (= calls of loop()), default 100000
+//   -m  neuron mode (NeuronBehaviour) to start with
+//   -t  input trace, see below
+//   -s  set an input to a constant value, e.g. -s Vm=450 (can be repeated)
+//   -b  binary framed output (SerialMode = 1) instead of ASCII lines
+//   -E  event frames only (SerialMode = 2), see spikeling_csv -e
+//   -z  compressed continuous values (SerialMode = 3, see DeltaStream.h)
+//   -k  only the on-board STA (SerialMode = 4, see StaKernel.h); needs the
+//       build with USES_STA (spikeling_sim_sta)
+//   -S  record number as last column of the ASCII lines (SerialSeq = 1)
+//   -N  Synapse 1 port generates binary noise in all modes (Syn1Mode = 2);
+//       the pin is read back as synapse 1 input, as on the board
+//   -c  send characters to the serial input before the given step, e.g.
+//       -c 50000:K to request the STA (can be repeated)
+//   -R  seed of the noise current and noise stimulus (NoiseSeed, see
+//       Noise.h), default 1 as on the board; the same seed replays a run
+//   -U  uniform noise current increments (NoiseGaussian = 0)
+//   -f  FastMode (0..3)
+//   -r  simulated model rate in Hz (advances micros()), default 1000
+//   -o  write the serial output to a file instead of stdout; -q discards it
+//
+// Inputs: PD, Vm, Syn1, Syn2, Noise, AnalogIn (0..1023), SpikeIn1, SpikeIn2,
+// Button (0/1). Dials start centred (512), all other inputs at 0.
+//
+// Trace file: a CSV file with a header line "step,<input>,<input>,..." and
+// one line per change; the values apply from that step on. Lines starting
+// with "#" are ignored. Example:
+//
+//   step,PD,SpikeIn2
+//   0,20,0
+//   5000,180,0
+//   6000,180,1
+//   6003,180,0
+//
+// A summary (steps, spikes, steps per second) is written to stderr.
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <vector>
+#include "Spikeling.ino"
+
+// -----------------------------------------------------------------------------
+struct InputName {
+  const char* name;
+  int         pin;
+};
+
+static const InputName Inputs[] = {
+  {"PD", PhotoDiodePin}, {"Vm", VmPotPin}, {"Syn1", Syn1PotPin},
+  {"Syn2", Syn2PotPin}, {"Noise", NoisePotPin}, {"AnalogIn", AnalogInPin},
+  {"SpikeIn1", DigitalIn1Pin}, {"SpikeIn2", DigitalIn2Pin},
+  {"Button", ButtonPin}
+};
+
+struct TraceRow {
+  long             step;
+  std::vector<int> values;
+};
+
+struct SerialInput {
+  long             step;
+  std::string      chars;
+};
+
+struct Trace {
+  std::vector<int>      pins;
+  std::vector<TraceRow> rows;
+};
+
+static int findInput(const std::string& name)
+{
+  for(const InputName& in : Inputs) {
+    if(name == in.name) return in.pin;
+  }
+  fprintf(stderr, "spikeling_sim: unknown input `%s`\n", name.c_str());
+  exit(1);
+}
+
+static std::vector<std::string> splitCsv(const char* line)
+{
+  std::vector<std::string> cols;
+  std::string              col;
+
+  for(const char* p=line; *p; p++) {
+    if(*p == ',') { cols.push_back(col); col.clear(); }
+    else if((*p != ' ') && (*p != '\r') && (*p != '\n')) col += *p;
+  }
+  cols.push_back(col);
+  return cols;
+}
+
+static bool loadTrace(const char* fName, Trace* trace)
+{
+  FILE* f = fopen(fName, "r");
+  char  line[1024];
+  bool  haveHeader = false;
+
+  if(f == NULL) return false;
+  while(fgets(line, sizeof(line), f) != NULL) {
+    if((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r')) continue;
+    std::vector<std::string> cols = splitCsv(line);
+    if(!haveHeader) {
+      for(size_t i=1; i<cols.size(); i++) {
+        trace->pins.push_back(findInput(cols[i]));
+      }
+      haveHeader = true;
+      continue;
+    }
+    TraceRow row;
+    row.step = atol(cols[0].c_str());
+    for(size_t i=1; (i < cols.size()) && (i <= trace->pins.size()); i++) {
+      row.values.push_back(atoi(cols[i].c_str()));
+    }
+    trace->rows.push_back(row);
+  }
+  fclose(f);
+  return haveHeader;
+}
+
+static void usage()
+{
+  fprintf(stderr, "Usage: spikeling_sim [-n steps] [-m mode] [-t trace.csv] "
+          "[-s input=value] [-b | -E | -z | -k] [-S] [-N] [-c step:chars] [-R seed] [-U] "
+          "[-f fastmode] [-r rate] [-o output | -q]\n");
+  exit(1);
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  long        nSteps   = 100000;
+  long        rateHz   = 1000;
+  int         mode     = 0;
+  const char* outFName = NULL;
+  bool        quiet    = false;
+  Trace       trace;
+  std::vector<SerialInput> input;
+
+  // Dials centred, everything else off
+  //
+  for(int i=0; i<HOST_N_PINS; i++) HostPin[i] = 0;
+  HostPin[VmPotPin] = HostPin[Syn1PotPin] = HostPin[Syn2PotPin] = 512;
+  HostPin[NoisePotPin] = 512;
+
+  for(int i=1; i<argc; i++) {
+    bool hasArg = (i+1 < argc);
+    if((strcmp(argv[i], "-n") == 0) && hasArg) nSteps = atol(argv[++i]);
+    else if((strcmp(argv[i], "-m") == 0) && hasArg) mode = atoi(argv[++i]);
+    else if((strcmp(argv[i], "-f") == 0) && hasArg) FastMode = atoi(argv[++i]);
+    else if((strcmp(argv[i], "-r") == 0) && hasArg) rateHz = atol(argv[++i]);
+    else if((strcmp(argv[i], "-o") == 0) && hasArg) outFName = argv[++i];
+    else if(strcmp(argv[i], "-q") == 0) quiet = true;
+    else if(strcmp(argv[i], "-b") == 0) SerialMode = 1;
+    else if(strcmp(argv[i], "-E") == 0) SerialMode = 2;
+    else if(strcmp(argv[i], "-z") == 0) SerialMode = 3;
+    else if(strcmp(argv[i], "-k") == 0) {
+      #ifndef USES_STA
+        fprintf(stderr, "spikeling_sim: -k needs USES_STA, use spikeling_sim_sta\n");
+        return 1;
+      #endif
+      SerialMode = 4;
+    }
+    else if(strcmp(argv[i], "-S") == 0) SerialSeq = 1;
+    else if((strcmp(argv[i], "-R") == 0) && hasArg) NoiseSeed = strtoul(argv[++i], NULL, 0);
+    else if(strcmp(argv[i], "-U") == 0) NoiseGaussian = 0;
+    else if(strcmp(argv[i], "-N") == 0) {
+      for(int j=0; j<nModes; j++) Array_DigiOutMode[j] = 2;
+    }
+    else if((strcmp(argv[i], "-c") == 0) && hasArg) {
+      const char* colon = strchr(argv[++i], ':');
+      if(colon == NULL) usage();
+      input.push_back({atol(argv[i]), colon +1});
+    }
+    else if((strcmp(argv[i], "-t") == 0) && hasArg) {
+      if(!loadTrace(argv[++i], &trace)) {
+        fprintf(stderr, "spikeling_sim: cannot read trace `%s`\n", argv[i]);
+        return 1;
+      }
+    }
+    else if((strcmp(argv[i], "-s") == 0) && hasArg) {
+      std::string arg = argv[++i];
+      size_t      eq  = arg.find('=');
+      if(eq == std::string::npos) usage();
+      HostPin[findInput(arg.substr(0, eq))] = atoi(arg.c_str() +eq +1);
+    }
+    else usage();
+  }
+  if((rateHz < 1) || (mode < 0) || (mode >= nModes)) usage();
+
+  if(!quiet) {
+    Serial.out = (outFName == NULL) ? stdout : fopen(outFName, "wb");
+    if(Serial.out == NULL) {
+      perror("spikeling_sim");
+      return 1;
+    }
+  }
+
+  // Run the firmware
+  //
+  NeuronBehaviour = mode;
+  setup();
+
+  unsigned long step_us = 1000000UL /rateHz;
+  size_t        iRow    = 0;
+  auto          t0      = std::chrono::steady_clock::now();
+
+  for(long iStep=0; iStep<nSteps; iStep++) {
+    while((iRow < trace.rows.size()) && (trace.rows[iRow].step <= iStep)) {
+      const TraceRow& row = trace.rows[iRow++];
+      for(size_t j=0; j<row.values.size(); j++) {
+        HostPin[trace.pins[j]] = row.values[j];
+      }
+    }
+    for(const SerialInput& in : input) {
+      if(in.step == iStep) Serial.in += in.chars;
+    }
+    loop();
+    HostMicros += step_us;
+  }
+
+  double dt = std::chrono::duration<double>(std::chrono::steady_clock::now() -t0).count();
+  fprintf(stderr, "%ld steps, %lu spikes, %zu bytes sent, %.0f steps/s\n",
+          nSteps, HostSpikeCount, Serial.nBytes, nSteps /dt);
+
+  if((Serial.out != NULL) && (Serial.out != stdout)) fclose(Serial.out);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
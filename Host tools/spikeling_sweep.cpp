@@ -0,0 +1,284 @@
+// -----------------------------------------------------------------------------
+// spikeling_sweep - simulates the Izhikevich model for many parameter sets at
+// once and lists the spike times of each set (see Sweep.h)
+//
+// Usage: spikeling_sweep [-n steps] [-t dt] [-v v0] [-j threads]
+//                        [-i auto|scalar|avx2|avx512] [-c] [-o output]
+//                        (-T | -p params.csv | -g name=from:to:count ...)
+//
+//   -n  steps per parameter set, default 10000 (1 s at dt = 0.1 ms)
+//   -t  timestep in ms (timestep_ms in Spikeling.ino), default 0.1
+//   -v  initial v in mV, default -65 (u starts at b*v; the firmware starts
+//       at v = u = 0)
+//   -j  number of threads, default: all cores
+//   -i  instruction set, default: the best the CPU supports
+//   -c  also run the scalar version and check that the spike times match
+//   -o  write the results to a file instead of stdout
+//
+// Parameter sets:
+//   -T  the 20 behaviours from the table at the end of Spikeling.ino
+//   -p  CSV file with a header line naming the columns (a, b, c, d, I) and
+//       one parameter set per line; missing columns take the defaults below
+//   -g  grid over one parameter, `from:to:count` (count values, inclusive)
+//       or a single value; several -g give all combinations, e.g.
+//         -g a=0.01:0.1:10 -g d=0:8:9 -g I=10
+//   Defaults (tonic spiking): a = 0.02, b = 0.2, c = -65, d = 6, I = 14
+//
+// Output: one CSV line per set with the parameters, the number of spikes,
+// the time of the first spike and the mean interspike interval (in ms, -1 if
+// not defined), followed by all spike times in ms, separated by spaces:
+//
+//   set, a, b, c, d, I, spikes, first_ms, mean_isi_ms, times_ms
+//
+// A summary (sets, instruction set, run time) is written to stderr.
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Sweep.h"
+
+// -----------------------------------------------------------------------------
+// Behaviours from Izhikevich (2004), as listed at the end of Spikeling.ino
+// -----------------------------------------------------------------------------
+struct Behaviour {
+  const char* name;
+  float       a, b, c, d, I;
+};
+
+static const Behaviour Behaviours[] = {
+  {"tonic spiking",                 0.02f,   0.2f,  -65,     6,    14},
+  {"phasic spiking",                0.02f,  0.25f,  -65,     6,  0.5f},
+  {"tonic bursting",                0.02f,   0.2f,  -50,     2,    15},
+  {"phasic bursting",               0.02f,  0.25f,  -55, 0.05f,  0.6f},
+  {"mixed mode",                    0.02f,   0.2f,  -55,     4,    10},
+  {"spike frequency adaptation",    0.01f,   0.2f,  -65,     8,    30},
+  {"Class 1",                       0.02f,  -0.1f,  -55,     6,     0},
+  {"Class 2",                        0.2f,  0.26f,  -65,     0,     0},
+  {"spike latency",                 0.02f,   0.2f,  -65,     6,     7},
+  {"subthreshold oscillations",     0.05f,  0.26f,  -60,     0,     0},
+  {"resonator",                      0.1f,  0.26f,  -60,    -1,     0},
+  {"integrator",                    0.02f,  -0.1f,  -55,     6,     0},
+  {"rebound spike",                 0.03f,  0.25f,  -60,     4,     0},
+  {"rebound burst",                 0.03f,  0.25f,  -52,     0,     0},
+  {"threshold variability",         0.03f,  0.25f,  -60,     4,     0},
+  {"bistability",                       1,   1.5f,  -60,     0,   -65},
+  {"DAP",                               1,   0.2f,  -60,   -21,     0},
+  {"accomodation",                  0.02f,      1,  -55,     4,     0},
+  {"inhibition-induced spiking",   -0.02f,     -1,  -60,     8,    80},
+  {"inhibition-induced bursting", -0.026f,     -1,  -45,     0,    80},
+};
+
+static const char* ParamNames[] = {"a", "b", "c", "d", "I"};
+static const float ParamDefaults[] = {0.02f, 0.2f, -65, 6, 14};
+
+struct GridAxis {
+  int                param;
+  std::vector<float> values;
+};
+
+static int findParam(const std::string& name)
+{
+  for(int i=0; i<5; i++) {
+    if(name == ParamNames[i]) return i;
+  }
+  fprintf(stderr, "spikeling_sweep: unknown parameter `%s`\n", name.c_str());
+  exit(1);
+}
+
+static void addSet(SweepParams* p, const float* x)
+{
+  p->add(x[0], x[1], x[2], x[3], x[4]);
+}
+
+// -----------------------------------------------------------------------------
+static bool parseAxis(const char* arg, GridAxis* axis)
+{
+  const char* eq = strchr(arg, '=');
+  float       from, to;
+  int         count;
+
+  if(eq == NULL) return false;
+  axis->param = findParam(std::string(arg, eq -arg));
+  if(sscanf(eq +1, "%f:%f:%d", &from, &to, &count) == 3) {
+    if(count < 1) return false;
+    for(int i=0; i<count; i++) {
+      axis->values.push_back((count == 1) ? from : from +(to -from) *i /(count -1));
+    }
+    return true;
+  }
+  if(sscanf(eq +1, "%f", &from) == 1) {
+    axis->values.push_back(from);
+    return true;
+  }
+  return false;
+}
+
+static void makeGrid(const std::vector<GridAxis>& axes, SweepParams* p)
+{
+  float  x[5];
+  size_t n = 1;
+
+  for(const GridAxis& axis : axes) n *= axis.values.size();
+  for(size_t k=0; k<n; k++) {
+    size_t r = k;
+    memcpy(x, ParamDefaults, sizeof(x));
+    for(size_t j=axes.size(); j-- > 0; ) {
+      x[axes[j].param] = axes[j].values[r %axes[j].values.size()];
+      r /= axes[j].values.size();
+    }
+    addSet(p, x);
+  }
+}
+
+static std::vector<std::string> splitCsv(const char* line)
+{
+  std::vector<std::string> cols;
+  std::string              col;
+
+  for(const char* p=line; *p; p++) {
+    if(*p == ',') { cols.push_back(col); col.clear(); }
+    else if((*p != ' ') && (*p != '\r') && (*p != '\n')) col += *p;
+  }
+  cols.push_back(col);
+  return cols;
+}
+
+static bool loadParams(const char* fName, SweepParams* p)
+{
+  FILE*            f = fopen(fName, "r");
+  char             line[1024];
+  std::vector<int> params;
+
+  if(f == NULL) return false;
+  while(fgets(line, sizeof(line), f) != NULL) {
+    if((line[0] == '#') || (line[0] == '\n') || (line[0] == '\r')) continue;
+    std::vector<std::string> cols = splitCsv(line);
+    if(params.empty()) {
+      for(const std::string& col : cols) params.push_back(findParam(col));
+      continue;
+    }
+    float x[5];
+    memcpy(x, ParamDefaults, sizeof(x));
+    for(size_t i=0; (i < cols.size()) && (i < params.size()); i++) {
+      x[params[i]] = (float)atof(cols[i].c_str());
+    }
+    addSet(p, x);
+  }
+  fclose(f);
+  return !params.empty();
+}
+
+static int parseIsa(const char* name)
+{
+  for(int isa : {SWEEP_ISA_AUTO, SWEEP_ISA_SCALAR, SWEEP_ISA_AVX2, SWEEP_ISA_AVX512}) {
+    if(strcmp(name, sweepIsaName(isa)) == 0) return isa;
+  }
+  return -1;
+}
+
+static void usage()
+{
+  fprintf(stderr, "Usage: spikeling_sweep [-n steps] [-t dt] [-v v0] [-j threads] "
+          "[-i auto|scalar|avx2|avx512] [-c] [-o output] "
+          "(-T | -p params.csv | -g name=from:to:count ...)\n");
+  exit(1);
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  SweepOptions          opt;
+  SweepParams           params;
+  std::vector<GridAxis> axes;
+  const char*           outFName = NULL;
+  bool                  table = false, check = false;
+  FILE*                 out = stdout;
+
+  opt.threads = std::max(1u, std::thread::hardware_concurrency());
+
+  for(int i=1; i<argc; i++) {
+    bool hasArg = (i+1 < argc);
+    if((strcmp(argv[i], "-n") == 0) && hasArg) opt.nSteps = atol(argv[++i]);
+    else if((strcmp(argv[i], "-t") == 0) && hasArg) opt.dt = (float)atof(argv[++i]);
+    else if((strcmp(argv[i], "-v") == 0) && hasArg) opt.v0 = (float)atof(argv[++i]);
+    else if((strcmp(argv[i], "-j") == 0) && hasArg) opt.threads = atoi(argv[++i]);
+    else if((strcmp(argv[i], "-i") == 0) && hasArg) {
+      if((opt.isa = parseIsa(argv[++i])) < 0) usage();
+    }
+    else if((strcmp(argv[i], "-o") == 0) && hasArg) outFName = argv[++i];
+    else if(strcmp(argv[i], "-c") == 0) check = true;
+    else if(strcmp(argv[i], "-T") == 0) table = true;
+    else if((strcmp(argv[i], "-p") == 0) && hasArg) {
+      if(!loadParams(argv[++i], &params)) {
+        fprintf(stderr, "spikeling_sweep: cannot read parameters `%s`\n", argv[i]);
+        return 1;
+      }
+    }
+    else if((strcmp(argv[i], "-g") == 0) && hasArg) {
+      GridAxis axis;
+      if(!parseAxis(argv[++i], &axis)) usage();
+      axes.push_back(axis);
+    }
+    else usage();
+  }
+  if(table) {
+    for(const Behaviour& bh : Behaviours) params.add(bh.a, bh.b, bh.c, bh.d, bh.I);
+  }
+  if(!axes.empty()) makeGrid(axes, &params);
+  if((params.size() == 0) || (opt.nSteps < 1) || (opt.dt <= 0)) usage();
+
+  // Run the sweep
+  //
+  SweepSpikes spikes;
+  auto        t0  = std::chrono::steady_clock::now();
+  int         isa = sweepRun(params, opt, &spikes);
+  double      dt  = std::chrono::duration<double>(std::chrono::steady_clock::now() -t0).count();
+
+  fprintf(stderr, "%zu sets x %ld steps, %s, %d threads, %.2f s, %.3g set-steps/s\n",
+          params.size(), opt.nSteps, sweepIsaName(isa), opt.threads, dt,
+          params.size() *(double)opt.nSteps /dt);
+
+  if(check && (isa != SWEEP_ISA_SCALAR)) {
+    SweepOptions scalarOpt = opt;
+    SweepSpikes  ref;
+    size_t       nDiffer = 0;
+
+    scalarOpt.isa = SWEEP_ISA_SCALAR;
+    sweepRun(params, scalarOpt, &ref);
+    for(size_t i=0; i<params.size(); i++) {
+      if(ref[i] != spikes[i]) nDiffer++;
+    }
+    fprintf(stderr, "check against scalar: %zu of %zu sets differ\n", nDiffer, params.size());
+    if(nDiffer > 0) return 1;
+  }
+
+  // Results
+  //
+  if(outFName != NULL) {
+    if((out = fopen(outFName, "w")) == NULL) {
+      perror("spikeling_sweep");
+      return 1;
+    }
+  }
+  fprintf(out, "set, a, b, c, d, I, spikes, first_ms, mean_isi_ms, times_ms\n");
+  for(size_t i=0; i<params.size(); i++) {
+    const std::vector<int32_t>& s = spikes[i];
+    double first = s.empty() ? -1 : s[0] *(double)opt.dt;
+    double isi   = (s.size() < 2) ? -1 : (s.back() -s[0]) *(double)opt.dt /(s.size() -1);
+
+    fprintf(out, "%zu, %g, %g, %g, %g, %g, %zu, %.1f, %.2f, ", i, params.a[i],
+            params.b[i], params.c[i], params.d[i], params.I[i], s.size(), first, isi);
+    for(size_t j=0; j<s.size(); j++) {
+      fprintf(out, (j > 0) ? " %.1f" : "%.1f", s[j] *(double)opt.dt);
+    }
+    fprintf(out, "\n");
+  }
+  if(out != stdout) fclose(out);
+  return 0;
+}
+
+// -----------------------------------------------------------------------------
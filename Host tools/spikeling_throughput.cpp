@@ -0,0 +1,207 @@
+// -----------------------------------------------------------------------------
+// spikeling_throughput - compares the serial output formats (SerialMode and
+// FastMode in Spikeling.ino): bytes per model step, time to format and to
+// decode them, and the highest model rate that fits through the serial port
+// at common baud rates
+//
+// Usage: spikeling_throughput [-n steps] [-k keyevery] [-d blocksamples]
+//
+//   -n  model steps per scenario, default 20000
+//   -k  KeyFrameEvery for the compressed format, default as in Spikeling.ino
+//   -d  DeltaBlockSamples for the compressed format, default as in Spikeling.ino
+//
+// The firmware is run on the host (as in spikeling_sim) for a few scenarios;
+// the recorded output records are then formatted in every format. The
+// compressed format is decoded again and compared with the records (values
+// must agree to the 0.01 of the rounding). Samples/s assume 10 bits per byte
+// (8N1) and a link without other traffic; the time columns are for the host
+// CPU and only show the relative cost of the formats.
+// -----------------------------------------------------------------------------
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+#include <vector>
+#include "Spikeling.ino"
+#include "FrameDecoder.h"
+
+// -----------------------------------------------------------------------------
+struct Scenario {
+  const char* name;
+  int         mode;      // NeuronBehaviour
+  int         pd;        // photodiode
+  int         noise;     // noise dial
+};
+
+static const Scenario Scenarios[] = {
+  {"rest",           0,    0,  512},
+  {"tonic spiking",  0,  150,  512},
+  {"bursting",       2,  150,  512},
+  {"noisy",          0,  150,    0},
+};
+
+struct Format {
+  const char* name;
+  int         serialMode;
+  int         fastMode;
+};
+
+static const Format Formats[] = {
+  {"ASCII (FastMode 0)", 0, 0},
+  {"ASCII (FastMode 2)", 0, 2},
+  {"binary frames",      1, 0},
+  {"compressed",         3, 0},
+};
+
+static const long Bauds[] = {115200, 234000, 921600, 2000000};
+
+static std::vector<uint8_t> Captured;
+
+static void capture(const uint8_t* buf, uint16_t len)
+{
+  Captured.insert(Captured.end(), buf, buf +len);
+}
+
+static double seconds(std::chrono::steady_clock::time_point t0)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() -t0).count();
+}
+
+// -----------------------------------------------------------------------------
+// Run the firmware and keep its output records
+//
+static std::vector<output_t> record(const Scenario& sc, long nSteps)
+{
+  std::vector<output_t> records;
+
+  for(int i=0; i<HOST_N_PINS; i++) HostPin[i] = 0;
+  HostPin[VmPotPin] = HostPin[Syn1PotPin] = HostPin[Syn2PotPin] = 512;
+  HostPin[NoisePotPin]   = sc.noise;
+  HostPin[PhotoDiodePin] = sc.pd;
+  HostMicros      = 0;
+  Serial.out      = NULL;
+  SerialMode      = 1;
+  FastMode        = 0;
+  NeuronBehaviour = sc.mode;
+  setup();
+
+  for(long i=0; i<nSteps; i++) {
+    loop();
+    records.push_back(Output);
+    HostMicros += 1000;
+  }
+  return records;
+}
+
+// Compare the decoded compressed stream with the records; returns the number
+// of samples that differ by more than the rounding
+//
+static long check(const std::vector<output_t>& records, const std::vector<output_t>& decoded)
+{
+  const float tol = 0.5f /DELTA_SCALE +1e-4f;
+  long        nBad = 0;
+
+  if(decoded.size() != records.size()) {
+    return (long)records.size();
+  }
+  for(size_t i=0; i<records.size(); i++) {
+    const output_t& a = records[i];
+    const output_t& b = decoded[i];
+    if((fabsf(a.v -b.v) > tol) || (fabsf(a.I_total -b.I_total) > tol) ||
+       (fabsf(a.I_PD -b.I_PD) > tol) || (fabsf(a.I_AnalogIn -b.I_AnalogIn) > tol) ||
+       (fabsf(a.I_Synapse -b.I_Synapse) > tol) || (a.Stim_State != b.Stim_State) ||
+       (a.SpikeIn1State != b.SpikeIn1State) || (a.SpikeIn2State != b.SpikeIn2State) ||
+       ((uint32_t)a.currentMicros != (uint32_t)b.currentMicros) ||
+       (a.NeuronBehaviour != b.NeuronBehaviour)) {
+      nBad++;
+    }
+  }
+  return nBad;
+}
+
+static void usage()
+{
+  fprintf(stderr, "Usage: spikeling_throughput [-n steps] [-k keyevery] [-d blocksamples]\n");
+  exit(1);
+}
+
+// -----------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+  long nSteps = 20000;
+  int  keyEvery = KeyFrameEvery, blockSamples = DeltaBlockSamples;
+  bool failed = false;
+
+  for(int i=1; i<argc; i++) {
+    bool hasArg = (i+1 < argc);
+    if((strcmp(argv[i], "-n") == 0) && hasArg) nSteps = atol(argv[++i]);
+    else if((strcmp(argv[i], "-k") == 0) && hasArg) keyEvery = atoi(argv[++i]);
+    else if((strcmp(argv[i], "-d") == 0) && hasArg) blockSamples = atoi(argv[++i]);
+    else usage();
+  }
+  if((nSteps < 1) || (keyEvery < 1) || (blockSamples < 1)) usage();
+
+  printf("%-14s %-19s %7s %9s %9s", "scenario", "format", "B/step", "enc ns", "dec ns");
+  for(long baud : Bauds) printf(" %9ld", baud);
+  printf("   (max. steps/s at baud)\n");
+
+  for(const Scenario& sc : Scenarios) {
+    std::vector<output_t> records = record(sc, nSteps);
+
+    for(const Format& fm : Formats) {
+      // Format all records
+      //
+      Captured.clear();
+      SerialMode        = fm.serialMode;
+      FastMode          = fm.fastMode;
+      KeyFrameEvery     = keyEvery;
+      DeltaBlockSamples = blockSamples;
+      FrameSeq          = 0;
+      deltaInit(&DeltaEnc);
+
+      auto t0 = std::chrono::steady_clock::now();
+      for(const output_t& o : records) {
+        formatSample(&o, capture);
+      }
+      if(fm.serialMode == 3) flushDelta(capture);
+      double encNs = seconds(t0) *1e9 /records.size();
+
+      // Decode (binary formats only)
+      //
+      double decNs = 0;
+      if(fm.serialMode > 0) {
+        FrameDecoder          decoder;
+        DeltaStreamDecoder    deltaDecoder;
+        std::vector<output_t> decoded;
+
+        decoded.reserve(records.size());
+        t0 = std::chrono::steady_clock::now();
+        decoder.feed(Captured.data(), Captured.size(), [&](const Frame& frame) {
+          output_t o;
+          if(decodeSample(frame, &o)) decoded.push_back(o);
+          else deltaDecoder.frame(frame, [&](const output_t& s) { decoded.push_back(s); });
+        });
+        decNs = seconds(t0) *1e9 /records.size();
+
+        if(fm.serialMode == 3) {
+          long nBad = check(records, decoded);
+          if(nBad > 0) {
+            fprintf(stderr, "%s: %ld of %zu samples decoded wrongly\n", sc.name, nBad, records.size());
+            failed = true;
+          }
+        }
+      }
+
+      double bytesPerStep = (double)Captured.size() /records.size();
+      printf("%-14s %-19s %7.2f %9.0f", sc.name, fm.name, bytesPerStep, encNs);
+      if(fm.serialMode > 0) printf(" %9.0f", decNs);
+      else printf(" %9s", "-");
+      for(long baud : Bauds) printf(" %9.0f", baud /10.0 /bytesPerStep);
+      printf("\n");
+    }
+  }
+  return failed ? 1 : 0;
+}
+
+// -----------------------------------------------------------------------------
@@ -165,18 +165,45 @@ function dat = loadSpikelingData(filename)
     %% Load data from csv file saved as filename
 
     datM = load(filename); % how matlab loads
-    datMat = sortrows(datM,9); % sort (sometimes the data isn't sorted in time)
+    if size(datM,2) >= 10
+        % record numbers in column 10 (SerialSeq = 1, or a file written by
+        % spikeling_ingest): in their order, each record once. The numbers
+        % start over (or the time goes back, not across the 32-bit wrap)
+        % when the board restarts, so each run is ordered on its own and its
+        % times continue after the end of the run before
+        seqStep = diff(datM(:,10));
+        tStep = diff(datM(:,9));
+        runStart = [1; find(seqStep < 0 | (tStep < 0 & tStep > -2^31)) + 1; size(datM,1) + 1];
+        datMat = [];
+        for r = 1:length(runStart)-1
+            run = datM(runStart(r):runStart(r+1)-1,:);
+            [~, idx] = unique(run(:,10));
+            run = run(idx,:);
+            if ~isempty(datMat)
+                dt = 0;
+                if size(datMat,1) > 1, dt = median(diff(datMat(:,9))); end
+                run(:,9) = run(:,9) - run(1,9) + datMat(end,9) + dt;
+            end
+            datMat = [datMat; run];
+        end
+        if length(runStart) > 2
+            fprintf('%s: %d restarts of the board\n', filename, length(runStart)-2);
+        end
+        n = 1;
+    else
+        datMat = sortrows(datM,9); % sort (sometimes the data isn't sorted in time)
+        n = 2; % every other point (spikeling is sending duplicaate values)
+    end
     % convert data from a matrix to a struct - makes things easier
-    dat.v = datMat(1:2:end,1);
-    dat.totC = datMat(1:2:end,2);
-    dat.stimState = datMat(1:2:end,3);
-    dat.syn1State = datMat(1:2:end,4);
-    dat.syn2State = datMat(1:2:end,5);
-    dat.pdCurrent = datMat(1:2:end,6);
-    dat.totAnIn = datMat(1:2:end,7);
-    dat.totSynC = datMat(1:2:end,8);
-    dat.time = datMat(1:2:end,9)./1000./1000; %converted to seconds
-    % every other point (spikeling is sending duplicaate values)
+    dat.v = datMat(1:n:end,1);
+    dat.totC = datMat(1:n:end,2);
+    dat.stimState = datMat(1:n:end,3);
+    dat.syn1State = datMat(1:n:end,4);
+    dat.syn2State = datMat(1:n:end,5);
+    dat.pdCurrent = datMat(1:n:end,6);
+    dat.totAnIn = datMat(1:n:end,7);
+    dat.totSynC = datMat(1:n:end,8);
+    dat.time = datMat(1:n:end,9)./1000./1000; %converted to seconds
     dat.time = dat.time - dat.time(1); % set first time to zero
     newT = 0:.004:dat.time(end);
 